@@ -1643,6 +1643,55 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_filter_profile(int is_last_report, int64_t cur_time)
+{
+    static int64_t last_time = -1;
+    int i, j;
+
+    if (filter_profile_period <= 0)
+        return;
+
+    if (!is_last_report) {
+        if (last_time == -1) {
+            last_time = cur_time;
+            return;
+        }
+        if (cur_time - last_time < filter_profile_period * 1000000)
+            return;
+        last_time = cur_time;
+    }
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        AVFilterGraph *graph = filtergraphs[i]->graph;
+        int64_t total_time = 0;
+
+        if (!graph)
+            continue;
+
+        for (j = 0; j < graph->nb_filters; j++) {
+            AVFilterProfile p;
+            avfilter_get_profile(graph->filters[j], &p);
+            total_time += p.wall_time;
+        }
+
+        av_log(NULL, AV_LOG_INFO, "Filtergraph #%d profile:\n", filtergraphs[i]->index);
+        for (j = 0; j < graph->nb_filters; j++) {
+            AVFilterContext *filter = graph->filters[j];
+            AVFilterProfile p;
+
+            avfilter_get_profile(filter, &p);
+            av_log(NULL, AV_LOG_INFO,
+                   "  %-24s %-12s act:%8"PRId64" wall:%9.3fs (%5.1f%%) cpu:%9.3fs "
+                   "in:%7"PRId64" out:%7"PRId64" queued:%4"PRId64" alloc:%9"PRId64"kB\n",
+                   filter->name, filter->filter->name, p.nb_activations,
+                   p.wall_time / 1000000.0,
+                   total_time ? 100.0 * p.wall_time / total_time : 0.0,
+                   p.cpu_time / 1000000.0, p.frames_in, p.frames_out,
+                   p.queued_frames, p.bytes_allocated >> 10);
+        }
+    }
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -2872,6 +2921,42 @@ static enum AVPixelFormat get_format(AVCodecContext *s, const enum AVPixelFormat
     return *p;
 }
 
+/* Allocate a frame with the border the filters want reserved around it, so
+ * that they can extend it in place. */
+static int get_buffer_with_border(AVCodecContext *s, AVFrame *frame, int flags,
+                                  const int border[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int w = frame->width, h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS], max_step[4];
+    /* keep the planes aligned for the decoder */
+    int left = FFALIGN(border[0], 256), top = border[1];
+    int i, ret;
+
+    if (!desc || desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                                AV_PIX_FMT_FLAG_HWACCEL))
+        return avcodec_default_get_buffer2(s, frame, flags);
+
+    /* the decoder may write up to its aligned dimensions */
+    avcodec_align_dimensions2(s, &frame->width, &frame->height, linesize_align);
+    frame->width  += left + border[2];
+    frame->height += top  + border[3];
+    ret = avcodec_default_get_buffer2(s, frame, flags);
+    frame->width  = w;
+    frame->height = h;
+    if (ret < 0)
+        return ret;
+
+    av_image_fill_max_pixsteps(max_step, NULL, desc);
+    for (i = 0; i < av_pix_fmt_count_planes(frame->format); i++) {
+        int hsub = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+        int vsub = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+        frame->data[i] += (left >> hsub) * max_step[i] +
+                          (top  >> vsub) * frame->linesize[i];
+    }
+    return 0;
+}
+
 static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
 {
     InputStream *ist = s->opaque;
@@ -2879,6 +2964,21 @@ static int get_buffer(AVCodecContext *s, AVFrame *frame, int flags)
     if (ist->hwaccel_get_buffer && frame->format == ist->hwaccel_pix_fmt)
         return ist->hwaccel_get_buffer(s, frame, flags);
 
+    /* Only for intra only codecs: the others may require the same strides for
+     * all the frames, while the border is unknown until the filters are
+     * configured with the first frame. Frames kept as references by the
+     * decoder or shared by several filter graphs can not be extended in
+     * place anyway. */
+    if (s->codec_type == AVMEDIA_TYPE_VIDEO && !(flags & AV_GET_BUFFER_FLAG_REF) &&
+        s->codec_descriptor && (s->codec_descriptor->props & AV_CODEC_PROP_INTRA_ONLY) &&
+        ist->nb_filters == 1) {
+        int border[4], i;
+        for (i = 0; i < 4; i++)
+            border[i] = atomic_load(&ist->border[i]);
+        if (border[0] || border[1] || border[2] || border[3])
+            return get_buffer_with_border(s, frame, flags, border);
+    }
+
     return avcodec_default_get_buffer2(s, frame, flags);
 }
 
@@ -4687,6 +4787,7 @@ static int transcode(void)
 
         /* dump report by using the output first video and audio streams */
         print_report(0, timer_start, cur_time);
+        print_filter_profile(0, cur_time);
     }
 #if HAVE_THREADS
     free_input_threads();
@@ -4722,6 +4823,7 @@ static int transcode(void)
 
     /* dump report by using the first video and audio streams */
     print_report(1, timer_start, av_gettime_relative());
+    print_filter_profile(1, av_gettime_relative());
 
     /* close each encoder */
     for (i = 0; i < nb_output_streams; i++) {
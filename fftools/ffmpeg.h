@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -358,6 +359,11 @@ typedef struct InputStream {
     InputFilter **filters;
     int        nb_filters;
 
+    /* room wanted around the frames by the filters, see
+     * av_buffersrc_get_border(); set when the filtergraph is configured
+     * and read by the decoder threads */
+    atomic_int border[4];
+
     int reinit_filters;
 
     /* hwaccel options */
@@ -609,6 +615,9 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_thread_type;
+extern float filter_profile_period;
+extern int frame_pool_flags;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
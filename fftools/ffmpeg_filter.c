@@ -1011,6 +1011,9 @@ int configure_filtergraph(FilterGraph *fg)
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->profile = filter_profile_period > 0;
+    fg->graph->frame_pool_flags = frame_pool_flags;
+    fg->graph->thread_type = filter_thread_type;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1108,6 +1111,16 @@ int configure_filtergraph(FilterGraph *fg)
     if ((ret = avfilter_graph_config(fg->graph, NULL)) < 0)
         goto fail;
 
+    for (i = 0; i < fg->nb_inputs; i++) {
+        InputStream *ist = fg->inputs[i]->ist;
+        int border[4], j;
+
+        av_buffersrc_get_border(fg->inputs[i]->filter, border);
+        if (ist->nb_filters == 1)
+            for (j = 0; j < 4; j++)
+                atomic_store(&ist->border[j], border[j]);
+    }
+
     /* limit the lists of allowed formats to the ones selected, to
      * make sure they stay the same if the filtergraph is reconfigured later */
     for (i = 0; i < fg->nb_outputs; i++) {
@@ -32,6 +32,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/avutil.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/intreadwrite.h"
@@ -110,6 +111,9 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int filter_thread_type = AVFILTER_THREAD_SLICE;
+float filter_profile_period = 0;
+int frame_pool_flags = 0;
 int vstats_version = 2;
 
 
@@ -220,6 +224,44 @@ static int opt_abort_on(void *optctx, const char *opt, const char *arg)
     return av_opt_eval_flags(&pclass, &opts[0], arg, &abort_on_flags);
 }
 
+static int opt_frame_pool_flags(void *optctx, const char *opt, const char *arg)
+{
+    static const AVOption opts[] = {
+        { "frame_pool_flags", NULL, 0, AV_OPT_TYPE_FLAGS, { .i64 = 0 }, INT64_MIN, INT64_MAX, .unit = "flags" },
+        { "hugepages"       , NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AV_BUFFER_POOL_FLAG_HUGE_PAGES },  .unit = "flags" },
+        { "numa"            , NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL },  .unit = "flags" },
+        { NULL },
+    };
+    static const AVClass class = {
+        .class_name = "",
+        .item_name  = av_default_item_name,
+        .option     = opts,
+        .version    = LIBAVUTIL_VERSION_INT,
+    };
+    const AVClass *pclass = &class;
+
+    return av_opt_eval_flags(&pclass, &opts[0], arg, &frame_pool_flags);
+}
+
+static int opt_filter_thread_type(void *optctx, const char *opt, const char *arg)
+{
+    static const AVOption opts[] = {
+        { "filter_thread_type", NULL, 0, AV_OPT_TYPE_FLAGS, { .i64 = 0 }, INT64_MIN, INT64_MAX, .unit = "flags" },
+        { "slice"             , NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .unit = "flags" },
+        { "graph"             , NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .unit = "flags" },
+        { NULL },
+    };
+    static const AVClass class = {
+        .class_name = "",
+        .item_name  = av_default_item_name,
+        .option     = opts,
+        .version    = LIBAVUTIL_VERSION_INT,
+    };
+    const AVClass *pclass = &class;
+
+    return av_opt_eval_flags(&pclass, &opts[0], arg, &filter_thread_type);
+}
+
 static int opt_sameq(void *optctx, const char *opt, const char *arg)
 {
     av_log(NULL, AV_LOG_ERROR, "Option '%s' was removed. "
@@ -781,6 +823,7 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
             av_log(NULL, AV_LOG_ERROR, "Error allocating the decoder context.\n");
             exit_program(1);
         }
+        ist->dec_ctx->frame_pool_flags = frame_pool_flags;
 
         ret = avcodec_parameters_to_context(ist->dec_ctx, par);
         if (ret < 0) {
@@ -3493,6 +3536,8 @@ const OptionDef options[] = {
         "exit on error", "error" },
     { "abort_on",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_abort_on },
         "abort on the specified condition flags", "flags" },
+    { "frame_pool_flags", HAS_ARG | OPT_EXPERT,                      { .func_arg = opt_frame_pool_flags },
+        "allocate decoded and filtered frames with huge pages or on the local NUMA node", "flags" },
     { "copyinkf",       OPT_BOOL | OPT_EXPERT | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(copy_initial_nonkeyframes) },
         "copy initial non-keyframes" },
@@ -3523,6 +3568,10 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_thread_type", HAS_ARG | OPT_EXPERT,                    { .func_arg = opt_filter_thread_type },
+        "set how the filter threads are used", "type" },
+    { "filter_profile", HAS_ARG | OPT_FLOAT | OPT_EXPERT,            { &filter_profile_period },
+        "print the time spent in each filter every given number of seconds", "period" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
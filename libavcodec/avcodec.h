@@ -3384,6 +3384,15 @@ typedef struct AVCodecContext {
      * - encoding: set by user
      */
     int64_t max_samples;
+
+    /**
+     * Flags for the buffer pools the default get_buffer2() allocates the
+     * frames from, a combination of AV_BUFFER_POOL_FLAG_*.
+     *
+     * - decoding: set by user
+     * - encoding: unused
+     */
+    int frame_pool_flags;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
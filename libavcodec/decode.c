@@ -1559,6 +1559,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
                     ret = AVERROR(ENOMEM);
                     goto fail;
                 }
+                av_buffer_pool_set_flags(pool->pools[i], avctx->frame_pool_flags);
             }
         }
         pool->format = frame->format;
@@ -1587,6 +1588,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        av_buffer_pool_set_flags(pool->pools[0], avctx->frame_pool_flags);
 
         pool->format     = frame->format;
         pool->planes     = planes;
@@ -483,6 +483,9 @@ static const AVOption avcodec_options[] = {
 {"allow_profile_mismatch", "attempt to decode anyway if HW accelerated decoder's supported profiles do not exactly match the stream", 0, AV_OPT_TYPE_CONST, {.i64 = AV_HWACCEL_FLAG_ALLOW_PROFILE_MISMATCH }, INT_MIN, INT_MAX, V | D, "hwaccel_flags"},
 {"extra_hw_frames", "Number of extra hardware frames to allocate for the user", OFFSET(extra_hw_frames), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, V|D },
 {"discard_damaged_percentage", "Percentage of damaged samples to discard a frame", OFFSET(discard_damaged_percentage), AV_OPT_TYPE_INT, {.i64 = 95 }, 0, 100, V|D },
+{"frame_pool_flags", "allocate the frames with huge pages or on the local NUMA node", OFFSET(frame_pool_flags), AV_OPT_TYPE_FLAGS, {.i64 = 0 }, 0, INT_MAX, V|A|D, "frame_pool_flags"},
+{"hugepages", "back large frames with huge pages", 0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_HUGE_PAGES }, INT_MIN, INT_MAX, V|A|D, "frame_pool_flags"},
+{"numa", "allocate the frames on the NUMA node of the decoding thread", 0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL }, INT_MIN, INT_MAX, V|A|D, "frame_pool_flags"},
 {NULL},
 };
 
@@ -30,11 +30,6 @@
 #define BUFFER_ALIGN 0
 
 
-AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
-{
-    return ff_get_audio_buffer(link->dst->outputs[0], nb_samples);
-}
-
 AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *frame = NULL;
@@ -44,7 +39,8 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
     if (!link->frame_pool) {
         link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                    nb_samples, link->format, BUFFER_ALIGN);
+                                                    nb_samples, link->format, BUFFER_ALIGN,
+                                                    link->dst->graph->frame_pool_flags);
         if (!link->frame_pool)
             return NULL;
     } else {
@@ -64,7 +60,8 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
             link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                        nb_samples, link->format, BUFFER_ALIGN);
+                                                        nb_samples, link->format, BUFFER_ALIGN,
+                                                        link->dst->graph->frame_pool_flags);
             if (!link->frame_pool)
                 return NULL;
         }
@@ -83,7 +80,7 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
     return frame;
 }
 
-AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
+static AVFrame *get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *ret = NULL;
 
@@ -95,3 +92,18 @@ AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
     return ret;
 }
+
+AVFrame *ff_null_get_audio_buffer(AVFilterLink *link, int nb_samples)
+{
+    /* accounted to the filter asking for the frame, not to this one */
+    return get_audio_buffer(link->dst->outputs[0], nb_samples);
+}
+
+AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
+{
+    AVFrame *ret = get_audio_buffer(link, nb_samples);
+
+    ff_filter_profile_alloc(link->src, ret);
+
+    return ret;
+}
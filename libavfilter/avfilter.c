@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <time.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/buffer.h"
@@ -33,6 +35,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -42,6 +45,7 @@
 #include "filters.h"
 #include "formats.h"
 #include "internal.h"
+#include "thread.h"
 
 #include "libavutil/ffversion.h"
 const char av_filter_ffversion[] = "FFmpeg version " FFMPEG_VERSION;
@@ -192,7 +196,9 @@ int avfilter_link_get_channels(AVFilterLink *link)
 
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
+    ff_graph_lock(filter->graph);
     filter->ready = FFMAX(filter->ready, priority);
+    ff_graph_unlock(filter->graph);
 }
 
 /**
@@ -203,8 +209,10 @@ static void filter_unblock(AVFilterContext *filter)
 {
     unsigned i;
 
+    ff_graph_lock(filter->graph);
     for (i = 0; i < filter->nb_outputs; i++)
         filter->outputs[i]->frame_blocked_in = 0;
+    ff_graph_unlock(filter->graph);
 }
 
 
@@ -529,11 +537,14 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
 {
     if (pts == AV_NOPTS_VALUE)
         return;
+    /* the sink links heap and graphmonitor read it from other filters */
+    ff_graph_lock(link->graph);
     link->current_pts = pts;
     link->current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
     if (link->graph && link->age_index >= 0)
         ff_avfilter_graph_update_heap(link->graph, link);
+    ff_graph_unlock(link->graph);
 }
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
@@ -1064,7 +1075,9 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
         filter_frame = default_filter_frame;
     ret = filter_frame(link, frame);
+    ff_graph_lock(link->graph);
     link->frame_count_out++;
+    ff_graph_unlock(link->graph);
     return ret;
 
 fail:
@@ -1108,7 +1121,9 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
     }
 
     link->frame_blocked_in = link->frame_wanted_out = 0;
+    ff_graph_lock(link->graph);
     link->frame_count_in++;
+    ff_graph_unlock(link->graph);
     filter_unblock(link->dst);
     ret = ff_framequeue_add(&link->fifo, frame);
     if (ret < 0) {
@@ -1210,7 +1225,9 @@ static int ff_filter_frame_to_filter(AVFilterLink *link)
     filter_unblock(dst);
     /* AVFilterPad.filter_frame() expect frame_count_out to have the value
        before the frame; ff_filter_frame_framed() will re-increment it. */
+    ff_graph_lock(link->graph);
     link->frame_count_out--;
+    ff_graph_unlock(link->graph);
     ret = ff_filter_frame_framed(link, frame);
     if (ret < 0 && ret != link->status_out) {
         ff_avfilter_link_set_out_status(link, ret, AV_NOPTS_VALUE);
@@ -1413,21 +1430,86 @@ static int ff_filter_activate_default(AVFilterContext *filter)
 
  */
 
+static int64_t thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
 int ff_filter_activate(AVFilterContext *filter)
 {
+    int profile = filter->graph->profile;
+    int64_t wall_time = 0, cpu_time = 0;
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
+    if (profile) {
+        wall_time = av_gettime_relative();
+        cpu_time  = thread_cpu_time();
+    }
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    if (profile) {
+        wall_time = av_gettime_relative() - wall_time;
+        cpu_time  = thread_cpu_time()     - cpu_time;
+        ff_graph_lock(filter->graph);
+        filter->internal->nb_activations++;
+        filter->internal->wall_time += wall_time;
+        filter->internal->cpu_time  += cpu_time;
+        ff_graph_unlock(filter->graph);
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
 }
 
+void ff_filter_profile_alloc(AVFilterContext *filter, const AVFrame *frame)
+{
+    int64_t size = 0;
+    int i;
+
+    if (!frame || !filter->graph->profile)
+        return;
+    for (i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    for (i = 0; i < frame->nb_extended_buf; i++)
+        size += frame->extended_buf[i]->size;
+    ff_graph_lock(filter->graph);
+    filter->internal->bytes_allocated += size;
+    ff_graph_unlock(filter->graph);
+}
+
+void avfilter_get_profile(AVFilterContext *filter, AVFilterProfile *profile)
+{
+    unsigned i;
+
+    memset(profile, 0, sizeof(*profile));
+    ff_graph_lock(filter->graph);
+    profile->nb_activations  = filter->internal->nb_activations;
+    profile->wall_time       = filter->internal->wall_time;
+    profile->cpu_time        = filter->internal->cpu_time;
+    profile->bytes_allocated = filter->internal->bytes_allocated;
+    for (i = 0; i < filter->nb_inputs; i++) {
+        AVFilterLink *link = filter->inputs[i];
+        if (!link)
+            continue;
+        profile->frames_in     += link->frame_count_out;
+        profile->queued_frames += ff_framequeue_queued_frames(&link->fifo);
+    }
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i])
+            profile->frames_out += filter->outputs[i]->frame_count_in;
+    ff_graph_unlock(filter->graph);
+}
+
 int ff_inlink_acknowledge_status(AVFilterLink *link, int *rstatus, int64_t *rpts)
 {
     *rpts = link->current_pts;
@@ -1470,7 +1552,9 @@ static void consume_update(AVFilterLink *link, const AVFrame *frame)
     ff_update_link_current_pts(link, frame->pts);
     ff_inlink_process_commands(link, frame);
     link->dst->is_disabled = !ff_inlink_evaluate_timeline_at_frame(link, frame);
+    ff_graph_lock(link->graph);
     link->frame_count_out++;
+    ff_graph_unlock(link->graph);
 }
 
 int ff_inlink_consume_frame(AVFilterLink *link, AVFrame **rframe)
@@ -1612,7 +1696,9 @@ void ff_inlink_set_status(AVFilterLink *link, int status)
     if (link->status_out)
         return;
     link->frame_wanted_out = 0;
+    ff_graph_lock(link->graph);
     link->frame_blocked_in = 0;
+    ff_graph_unlock(link->graph);
     ff_avfilter_link_set_out_status(link, status, AV_NOPTS_VALUE);
     while (ff_framequeue_queued_frames(&link->fifo)) {
            AVFrame *frame = ff_framequeue_take(&link->fifo);
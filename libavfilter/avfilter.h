@@ -332,6 +332,12 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate filters which do not share a link concurrently, e.g. the branches
+ * after a split. Only meaningful for AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -600,6 +606,14 @@ struct AVFilterLink {
      */
     AVBufferRef *hw_frames_ctx;
 
+    /**
+     * Room, in pixels left, above, right and below the picture, that the
+     * destination filter would like reserved in the buffers of the video
+     * frames allocated for this link, to extend them in place.
+     * Set by the destination filter when configuring its input.
+     */
+    int border[4];
+
 #ifndef FF_INTERNAL_FIELDS
 
     /**
@@ -697,6 +711,32 @@ int avfilter_config_links(AVFilterContext *filter);
  */
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags);
 
+/**
+ * Counters of the work done by a filter, see avfilter_get_profile().
+ */
+typedef struct AVFilterProfile {
+    int64_t nb_activations;  ///< number of times the filter was activated
+    int64_t wall_time;       ///< wall clock time spent in the filter, in microseconds
+    /**
+     * CPU time spent in the filter, in microseconds. Only the time of the
+     * thread activating the filter is counted, not the time of the slice
+     * threads working for it. 0 if the platform cannot measure it.
+     */
+    int64_t cpu_time;
+    int64_t frames_in;       ///< frames taken from all inputs
+    int64_t frames_out;      ///< frames sent on all outputs
+    int64_t queued_frames;   ///< frames currently queued on all inputs
+    int64_t bytes_allocated; ///< total size of the frames obtained for the outputs
+} AVFilterProfile;
+
+/**
+ * Get the profiling counters of a filter. The time, activation and
+ * allocation counters only advance while AVFilterGraph.profile is set.
+ *
+ * This may be called at any time, including from a filter of the same graph.
+ */
+void avfilter_get_profile(AVFilterContext *filter, AVFilterProfile *profile);
+
 /**
  * Iterate over all registered filters.
  *
@@ -899,14 +939,28 @@ typedef struct AVFilterGraph {
     /**
      * Private fields
      *
-     * The following fields are for internal use only.
-     * Their type, offset, number and semantic can change without notice.
+     * The following fields, up to disable_auto_convert, are for internal use
+     * only. Their type, offset, number and semantic can change without notice.
      */
 
     AVFilterLink **sink_links;
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    /**
+     * Flags for the buffer pools the filters allocate their frames from by
+     * default, a combination of AV_BUFFER_POOL_FLAG_*. Only affects the
+     * pools created afterwards.
+     */
+    int frame_pool_flags;
+
+    /**
+     * Measure the time spent in each filter and the size of the frames
+     * they allocate, see avfilter_get_profile(). Disabled by default, as it
+     * reads the clocks around every filter activation.
+     */
+    int profile;
 } AVFilterGraph;
 
 /**
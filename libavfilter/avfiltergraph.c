@@ -50,12 +50,19 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "profile",     "Collect per filter profiling counters", OFFSET(profile),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
+    { "frame_pool_flags", "Allocate the frames with huge pages or on the local NUMA node", OFFSET(frame_pool_flags),
+        AV_OPT_TYPE_FLAGS, { .i64 = 0 }, 0, INT_MAX, F|V|A, "frame_pool_flags" },
+        { "hugepages", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AV_BUFFER_POOL_FLAG_HUGE_PAGES }, .flags = F|V|A, .unit = "frame_pool_flags" },
+        { "numa",      NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL }, .flags = F|V|A, .unit = "frame_pool_flags" },
     { NULL },
 };
 
@@ -78,6 +85,29 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+void ff_graph_executor_free(AVFilterGraph *graph)
+{
+}
+
+int ff_graph_executor_init(AVFilterGraph *graph)
+{
+    graph->thread_type &= ~AVFILTER_THREAD_GRAPH;
+    return 0;
+}
+
+int ff_graph_executor_run_once(AVFilterGraph *graph)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -125,6 +155,7 @@ void avfilter_graph_free(AVFilterGraph **graph)
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
+    ff_graph_executor_free(*graph);
     ff_graph_thread_free(*graph);
 
     av_freep(&(*graph)->sink_links);
@@ -184,6 +215,13 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
             }
         }
     }
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH && !graph->internal->executor) {
+        int ret = ff_graph_executor_init(graph);
+        if (ret < 0) {
+            av_log(graph, AV_LOG_ERROR, "Error initializing the graph executor: %s.\n", av_err2str(ret));
+            return NULL;
+        }
+    }
 
     s = ff_filter_alloc(filter, name);
     if (!s)
@@ -1447,6 +1485,8 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
     unsigned i;
 
     av_assert0(graph->nb_filters);
+    if (graph->internal->executor)
+        return ff_graph_executor_run_once(graph);
     filter = graph->filters[0];
     for (i = 1; i < graph->nb_filters; i++)
         if (graph->filters[i]->ready > filter->ready)
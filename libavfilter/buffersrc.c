@@ -289,6 +289,21 @@ unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
     return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
 }
 
+void av_buffersrc_get_border(AVFilterContext *ctx, int border[4])
+{
+    AVFilterLink *link = ctx->outputs[0];
+
+    memset(border, 0, 4 * sizeof(*border));
+    if (!link || link->type != AVMEDIA_TYPE_VIDEO)
+        return;
+    /* the frames go unchanged through the filters allocating their input
+     * frames on their output */
+    while (link->dstpad->get_video_buffer == ff_null_get_video_buffer &&
+           link->dst->nb_outputs == 1 && link->dst->outputs[0])
+        link = link->dst->outputs[0];
+    memcpy(border, link->border, sizeof(link->border));
+}
+
 #define OFFSET(x) offsetof(BufferSourceContext, x)
 #define A AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_AUDIO_PARAM
 #define V AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
@@ -202,6 +202,20 @@ int av_buffersrc_add_frame_flags(AVFilterContext *buffer_src,
  */
 int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags);
 
+/**
+ * Get the room, in pixels left, above, right and below the picture, that
+ * the filters fed by a video buffer source would like around the frames, to
+ * extend them in place (e.g. pad) instead of copying them. Frames sent to
+ * the source with that much room within their buffers, as seen from
+ * AVFrame.data, avoid the copy when they are writable.
+ *
+ * The border is only known once the graph is configured, it is 0 before
+ * that, for audio and when no filter needs one.
+ *
+ * @param border the left, top, right and bottom border
+ */
+void av_buffersrc_get_border(AVFilterContext *ctx, int border[4]);
+
 /**
  * @}
  */
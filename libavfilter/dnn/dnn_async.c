@@ -0,0 +1,370 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Queue of inference requests executed in batches on a worker thread.
+ */
+
+#include "config.h"
+#include "dnn_async.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+struct DNNAsyncQueue {
+    void *model;
+    DNNExecuteBatchFunc execute_batch;
+    void (*done_callback)(void *opaque);
+    void *done_opaque;
+    DNNAsyncRequest *requests;
+    DNNAsyncRequest **batch;
+    int nb_requests;
+    int batch_size;
+    uint32_t nb_output;
+
+    /**
+     * number of requests which went through each step, request n uses
+     * requests[n % nb_requests], and
+     * freed <= collected <= done <= sent <= submitted <= started <= freed + nb_requests
+     */
+    uint64_t freed;         ///< released by the caller
+    uint64_t collected;     ///< returned by ff_dnn_async_get_result()
+    uint64_t done;          ///< executed
+    uint64_t sent;          ///< taken by the worker
+    uint64_t submitted;     ///< given to ff_dnn_async_execute()
+    uint64_t started;       ///< given by ff_dnn_async_start_request()
+    /**
+     * requests below are sent without waiting for a full batch
+     */
+    uint64_t flush_until;
+
+#if HAVE_THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int thread_started;
+    int exit;
+#endif
+};
+
+static size_t get_data_size(const DNNData *data)
+{
+    return (size_t)data->width * data->height * data->channels *
+           (data->dt == DNN_FLOAT ? sizeof(float) : sizeof(uint8_t));
+}
+
+static int batch_ready(const DNNAsyncQueue *queue)
+{
+    return queue->submitted - queue->sent >= queue->batch_size ||
+           (queue->submitted > queue->sent && queue->flush_until > queue->sent);
+}
+
+/**
+ * Execute the batch of nb_requests requests starting with request number first.
+ */
+static void run_batch(DNNAsyncQueue *queue, uint64_t first, int nb_requests)
+{
+    DNNReturnType ret;
+
+    for (int i = 0; i < nb_requests; i++)
+        queue->batch[i] = &queue->requests[(first + i) % queue->nb_requests];
+    ret = queue->execute_batch(queue->model, queue->batch, nb_requests);
+    for (int i = 0; i < nb_requests; i++)
+        queue->batch[i]->result = ret;
+}
+
+#if HAVE_THREADS
+static void *worker_thread(void *arg)
+{
+    DNNAsyncQueue *queue = arg;
+
+    pthread_mutex_lock(&queue->lock);
+    while (1) {
+        uint64_t first;
+        int nb_requests;
+
+        while (!queue->exit && !batch_ready(queue))
+            pthread_cond_wait(&queue->cond, &queue->lock);
+        if (queue->exit)
+            break;
+
+        first = queue->sent;
+        nb_requests = FFMIN(queue->batch_size, queue->submitted - queue->sent);
+        queue->sent += nb_requests;
+        pthread_mutex_unlock(&queue->lock);
+
+        run_batch(queue, first, nb_requests);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->done += nb_requests;
+        pthread_cond_broadcast(&queue->cond);
+
+        if (queue->done_callback) {
+            pthread_mutex_unlock(&queue->lock);
+            queue->done_callback(queue->done_opaque);
+            pthread_mutex_lock(&queue->lock);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return NULL;
+}
+
+static void queue_lock(DNNAsyncQueue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+}
+
+static void queue_unlock(DNNAsyncQueue *queue)
+{
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void queue_signal(DNNAsyncQueue *queue)
+{
+    pthread_cond_broadcast(&queue->cond);
+}
+
+static void queue_wait(DNNAsyncQueue *queue)
+{
+    pthread_cond_wait(&queue->cond, &queue->lock);
+}
+#else
+static void queue_lock(DNNAsyncQueue *queue)
+{
+}
+
+static void queue_unlock(DNNAsyncQueue *queue)
+{
+}
+
+// without threads, the batches are executed as soon as they are ready
+static void queue_signal(DNNAsyncQueue *queue)
+{
+    while (batch_ready(queue)) {
+        int nb_requests = FFMIN(queue->batch_size, queue->submitted - queue->sent);
+        run_batch(queue, queue->sent, nb_requests);
+        queue->sent += nb_requests;
+        queue->done += nb_requests;
+        if (queue->done_callback)
+            queue->done_callback(queue->done_opaque);
+    }
+}
+
+static void queue_wait(DNNAsyncQueue *queue)
+{
+}
+#endif
+
+DNNAsyncQueue *ff_dnn_async_queue_alloc(void *model, DNNExecuteBatchFunc execute_batch,
+                                        const DNNData *input, uint32_t nb_output,
+                                        int nb_requests, int batch_size,
+                                        void (*done)(void *opaque), void *opaque)
+{
+    DNNAsyncQueue *queue = av_mallocz(sizeof(*queue));
+    size_t input_size = get_data_size(input);
+
+    if (!queue)
+        return NULL;
+
+    queue->model = model;
+    queue->execute_batch = execute_batch;
+    queue->done_callback = done;
+    queue->done_opaque = opaque;
+    queue->batch_size = FFMAX(batch_size, 1);
+    queue->nb_requests = FFMAX(nb_requests, queue->batch_size);
+    queue->nb_output = nb_output;
+    queue->requests = av_mallocz_array(queue->nb_requests, sizeof(*queue->requests));
+    queue->batch = av_malloc_array(queue->batch_size, sizeof(*queue->batch));
+    if (!queue->requests || !queue->batch)
+        goto fail;
+
+    for (int i = 0; i < queue->nb_requests; i++) {
+        DNNAsyncRequest *request = &queue->requests[i];
+        request->input = *input;
+        request->input.data = av_malloc(input_size);
+        request->outputs = av_mallocz_array(nb_output, sizeof(*request->outputs));
+        request->outputs_size = av_mallocz_array(nb_output, sizeof(*request->outputs_size));
+        if (!request->input.data || !request->outputs || !request->outputs_size)
+            goto fail;
+    }
+
+#if HAVE_THREADS
+    if (pthread_mutex_init(&queue->lock, NULL))
+        goto fail;
+    if (pthread_cond_init(&queue->cond, NULL)) {
+        pthread_mutex_destroy(&queue->lock);
+        goto fail;
+    }
+    if (pthread_create(&queue->thread, NULL, worker_thread, queue)) {
+        pthread_cond_destroy(&queue->cond);
+        pthread_mutex_destroy(&queue->lock);
+        goto fail;
+    }
+    queue->thread_started = 1;
+#endif
+
+    return queue;
+
+fail:
+    ff_dnn_async_queue_free(&queue);
+    return NULL;
+}
+
+void ff_dnn_async_queue_free(DNNAsyncQueue **queue)
+{
+    DNNAsyncQueue *q = *queue;
+
+    if (!q)
+        return;
+
+#if HAVE_THREADS
+    if (q->thread_started) {
+        pthread_mutex_lock(&q->lock);
+        q->exit = 1;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+        pthread_join(q->thread, NULL);
+        pthread_cond_destroy(&q->cond);
+        pthread_mutex_destroy(&q->lock);
+    }
+#endif
+
+    if (q->requests) {
+        for (int i = 0; i < q->nb_requests; i++) {
+            DNNAsyncRequest *request = &q->requests[i];
+            av_freep(&request->input.data);
+            if (request->outputs) {
+                for (uint32_t j = 0; j < q->nb_output; j++)
+                    av_freep(&request->outputs[j].data);
+            }
+            av_freep(&request->outputs);
+            av_freep(&request->outputs_size);
+        }
+    }
+    av_freep(&q->requests);
+    av_freep(&q->batch);
+    av_freep(queue);
+}
+
+DNNReturnType ff_dnn_async_start_request(DNNAsyncQueue *queue, DNNData *input)
+{
+    queue_lock(queue);
+    // the outputs of the request collected last are not used anymore
+    queue->freed = queue->collected;
+    if (queue->started == queue->submitted) {
+        if (queue->started - queue->freed == queue->nb_requests) {
+            queue_unlock(queue);
+            return DNN_ERROR;
+        }
+        queue->started++;
+    }
+    *input = queue->requests[(queue->started - 1) % queue->nb_requests].input;
+    queue_unlock(queue);
+
+    return DNN_SUCCESS;
+}
+
+DNNReturnType ff_dnn_async_execute(DNNAsyncQueue *queue, void *user_data)
+{
+    queue_lock(queue);
+    if (queue->started == queue->submitted) {
+        queue_unlock(queue);
+        return DNN_ERROR;
+    }
+    queue->requests[queue->submitted % queue->nb_requests].user_data = user_data;
+    queue->submitted++;
+    if (batch_ready(queue))
+        queue_signal(queue);
+    queue_unlock(queue);
+
+    return DNN_SUCCESS;
+}
+
+DNNAsyncStatusType ff_dnn_async_get_result(DNNAsyncQueue *queue, DNNData *outputs, uint32_t nb_output,
+                                           void **user_data, int wait)
+{
+    const DNNAsyncRequest *request;
+
+    queue_lock(queue);
+    queue->freed = queue->collected;
+    if (queue->collected == queue->submitted) {
+        queue_unlock(queue);
+        return DAST_EMPTY_QUEUE;
+    }
+    if (queue->collected == queue->done) {
+        if (!wait) {
+            queue_unlock(queue);
+            return DAST_NOT_READY;
+        }
+        // do not wait for the batch of the request to be full
+        queue->flush_until = FFMAX(queue->flush_until, queue->collected + 1);
+        queue_signal(queue);
+        while (queue->collected == queue->done)
+            queue_wait(queue);
+    }
+    request = &queue->requests[queue->collected % queue->nb_requests];
+    queue->collected++;
+    queue_unlock(queue);
+
+    *user_data = request->user_data;
+    if (request->result != DNN_SUCCESS)
+        return DAST_FAIL;
+    for (uint32_t i = 0; i < FFMIN(nb_output, queue->nb_output); i++)
+        outputs[i] = request->outputs[i];
+
+    return DAST_SUCCESS;
+}
+
+void ff_dnn_async_flush(DNNAsyncQueue *queue)
+{
+    queue_lock(queue);
+    queue->flush_until = queue->submitted;
+    if (batch_ready(queue))
+        queue_signal(queue);
+    queue_unlock(queue);
+}
+
+int ff_dnn_async_is_busy(DNNAsyncQueue *queue)
+{
+    int busy;
+
+    queue_lock(queue);
+    busy = queue->submitted > queue->done;
+    queue_unlock(queue);
+
+    return busy;
+}
+
+DNNReturnType ff_dnn_async_set_output(DNNAsyncRequest *request, uint32_t index, const DNNData *output)
+{
+    DNNData *dst = &request->outputs[index];
+    size_t size = get_data_size(output);
+
+    av_fast_malloc(&dst->data, &request->outputs_size[index], size);
+    if (!dst->data)
+        return DNN_ERROR;
+    memcpy(dst->data, output->data, size);
+    dst->width    = output->width;
+    dst->height   = output->height;
+    dst->channels = output->channels;
+    dst->dt       = output->dt;
+
+    return DNN_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Queue of inference requests executed in batches on a worker thread,
+ * used by the backends to implement the asynchronous DNNModule calls.
+ */
+
+#ifndef AVFILTER_DNN_DNN_ASYNC_H
+#define AVFILTER_DNN_DNN_ASYNC_H
+
+#include "../dnn_interface.h"
+
+typedef struct DNNAsyncRequest {
+    /**
+     * input of the request, with the size given to ff_dnn_async_queue_alloc(),
+     * data is owned by the queue
+     */
+    DNNData input;
+    /**
+     * outputs of the request, set by the backend with ff_dnn_async_set_output()
+     */
+    DNNData *outputs;
+    unsigned int *outputs_size;
+    void *user_data;
+    DNNReturnType result;
+} DNNAsyncRequest;
+
+/**
+ * Execute the requests of a batch, called on the worker thread. The input
+ * data of the requests must not be written, and the outputs must be copied
+ * into the requests before returning.
+ */
+typedef DNNReturnType (*DNNExecuteBatchFunc)(void *model, DNNAsyncRequest **requests, int nb_requests);
+
+typedef struct DNNAsyncQueue DNNAsyncQueue;
+
+/**
+ * Allocate a queue of nb_requests requests whose inputs have the size and
+ * type of input, and start its worker thread.
+ *
+ * @param model   passed to execute_batch
+ * @param done    if not NULL, called with opaque after each batch is executed,
+ *                on the worker thread, without the queue lock held
+ */
+DNNAsyncQueue *ff_dnn_async_queue_alloc(void *model, DNNExecuteBatchFunc execute_batch,
+                                        const DNNData *input, uint32_t nb_output,
+                                        int nb_requests, int batch_size,
+                                        void (*done)(void *opaque), void *opaque);
+
+/**
+ * Stop the worker thread once the batch it executes is done, and free the
+ * queue, the user data of the requests which were not collected is lost.
+ */
+void ff_dnn_async_queue_free(DNNAsyncQueue **queue);
+
+DNNReturnType ff_dnn_async_start_request(DNNAsyncQueue *queue, DNNData *input);
+
+DNNReturnType ff_dnn_async_execute(DNNAsyncQueue *queue, void *user_data);
+
+DNNAsyncStatusType ff_dnn_async_get_result(DNNAsyncQueue *queue, DNNData *outputs, uint32_t nb_output,
+                                           void **user_data, int wait);
+
+void ff_dnn_async_flush(DNNAsyncQueue *queue);
+
+/**
+ * @return 1 if requests given to ff_dnn_async_execute() are waiting for their
+ * batch or being executed, the worker thread may then use the model
+ */
+int ff_dnn_async_is_busy(DNNAsyncQueue *queue);
+
+/**
+ * Copy output into the output number index of request.
+ */
+DNNReturnType ff_dnn_async_set_output(DNNAsyncRequest *request, uint32_t index, const DNNData *output);
+
+#endif
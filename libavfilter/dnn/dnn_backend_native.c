@@ -25,9 +25,310 @@
 
 #include "dnn_backend_native.h"
 #include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/file.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
 #include "dnn_backend_native_layer_conv2d.h"
+#include "dnn_backend_native_layer_depth2space.h"
+#include "dnn_backend_native_layer_maximum.h"
 #include "dnn_backend_native_layers.h"
 
+#define OFFSET(x) offsetof(NativeContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM
+static const AVOption dnn_native_options[] = {
+    { "threads", "number of threads for layer execution, 0 for automatic", OFFSET(options.threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "fuse",    "merge pad, maximum and depth to space layers into the adjacent conv2d layers", OFFSET(options.fuse), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { "nireq",   "number of requests for the asynchronous execution", OFFSET(options.nireq), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, INT_MAX, FLAGS },
+    { "profile", "report the time and operations of each layer when the model is freed", OFFSET(options.profile), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { NULL }
+};
+
+static const AVClass dnn_native_class = {
+    .class_name = "dnn_native",
+    .item_name  = av_default_item_name,
+    .option     = dnn_native_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+    .category   = AV_CLASS_CATEGORY_FILTER,
+};
+
+static void native_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    NativeContext *ctx = priv;
+    ctx->job_func(ctx->job_arg, jobnr, nb_jobs);
+}
+
+static int init_native_context(NativeContext *ctx, const char *options)
+{
+    int ret;
+
+    ctx->class = &dnn_native_class;
+    av_opt_set_defaults(ctx);
+    if (options && av_opt_set_from_string(ctx, options, NULL, "=", "&") < 0) {
+        av_log(ctx, AV_LOG_ERROR, "could not parse backend options '%s'\n", options);
+        return -1;
+    }
+
+    ctx->nb_threads = 1;
+    ret = avpriv_slicethread_create(&ctx->slicethread, ctx, native_worker_func, NULL, ctx->options.threads);
+    if (ret > 1) {
+        ctx->nb_threads = ret;
+    } else {
+        // no thread support or a single thread, run the layers inline
+        avpriv_slicethread_free(&ctx->slicethread);
+    }
+    av_log(ctx, AV_LOG_VERBOSE, "using %d thread(s) for layer execution\n", ctx->nb_threads);
+
+    return 0;
+}
+
+#define ARENA_ALIGN 64
+
+typedef struct OperandLifetime {
+    int32_t operand;
+    // first and last layer during which the operand data must be kept
+    int first, last;
+    size_t size, offset;
+} OperandLifetime;
+
+static int cmp_lifetime_size(const void *a, const void *b)
+{
+    const OperandLifetime *la = a, *lb = b;
+    if (la->size != lb->size)
+        return la->size < lb->size ? 1 : -1;
+    return la->operand - lb->operand;
+}
+
+/**
+ * Infer the dims of all the operands produced by the layers, then place
+ * them in one arena, largest first, at the lowest offset not used by an
+ * operand alive at the same time.
+ */
+static int plan_operand_memory(ConvolutionalNetwork *network)
+{
+    NativeContext *ctx = &network->ctx;
+    OperandLifetime *lifetimes;
+    int *operand_lifetime;
+    int nb_lifetimes = 0;
+    size_t arena_size = 0, unshared_size = 0, input_size = 0;
+
+    for (int i = 0; i < network->operands_num; ++i) {
+        DnnOperand *oprd = &network->operands[i];
+        if (oprd->in_arena) {
+            oprd->data = NULL;
+            oprd->in_arena = 0;
+        }
+        if (oprd->type == DOT_INPUT)
+            input_size += oprd->length;
+    }
+    av_freep(&network->arena);
+    network->arena_size = 0;
+
+    lifetimes = av_malloc_array(network->layers_num, sizeof(*lifetimes));
+    operand_lifetime = av_malloc_array(network->operands_num, sizeof(*operand_lifetime));
+    if (!lifetimes || !operand_lifetime)
+        goto fail;
+    for (int i = 0; i < network->operands_num; ++i)
+        operand_lifetime[i] = -1;
+
+    for (int layer = 0; layer < network->layers_num; ++layer) {
+        const Layer *l = &network->layers[layer];
+        DnnOperand *oprd = &network->operands[l->output_operand_index];
+        OperandLifetime *lt;
+
+        for (int i = 0; i < FF_ARRAY_ELEMS(l->input_operand_indexes); ++i) {
+            int idx = operand_lifetime[l->input_operand_indexes[i]];
+            if (idx >= 0)
+                lifetimes[idx].last = layer;
+        }
+
+        if (oprd->type == DOT_INPUT || operand_lifetime[l->output_operand_index] >= 0) {
+            av_log(ctx, AV_LOG_ERROR, "operand %s is written by more than one layer\n", oprd->name);
+            goto fail;
+        }
+        if (layer_funcs[l->type].pf_infer_shape(network->operands, l->input_operand_indexes,
+                                                l->output_operand_index, l->params) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "unsupported input shape for the layer producing %s\n", oprd->name);
+            goto fail;
+        }
+        av_freep(&oprd->data);
+        oprd->length = calculate_operand_data_length(oprd);
+
+        lt = &lifetimes[nb_lifetimes];
+        lt->operand = l->output_operand_index;
+        lt->first = lt->last = layer;
+        lt->size = FFALIGN(oprd->length, ARENA_ALIGN);
+        unshared_size += lt->size;
+        operand_lifetime[l->output_operand_index] = nb_lifetimes++;
+    }
+
+    // the outputs are read after the last layer
+    for (uint32_t i = 0; i < network->nb_output; ++i) {
+        const DnnOperand *oprd = &network->operands[network->output_indexes[i]];
+        int idx = operand_lifetime[network->output_indexes[i]];
+        if (idx >= 0) {
+            lifetimes[idx].last = network->layers_num;
+        } else if (oprd->type != DOT_INPUT) {
+            av_log(ctx, AV_LOG_ERROR, "output %s is not computed by any layer, "
+                   "it may have been fused, see the fuse option\n", oprd->name);
+            goto fail;
+        }
+    }
+
+    qsort(lifetimes, nb_lifetimes, sizeof(*lifetimes), cmp_lifetime_size);
+    for (int i = 0; i < nb_lifetimes; ++i) {
+        OperandLifetime *lt = &lifetimes[i];
+        size_t offset = 0;
+        int moved;
+
+        do {
+            moved = 0;
+            for (int j = 0; j < i; ++j) {
+                const OperandLifetime *placed = &lifetimes[j];
+                if (placed->last < lt->first || lt->last < placed->first)
+                    continue;
+                if (placed->offset < offset + lt->size && offset < placed->offset + placed->size) {
+                    offset = placed->offset + placed->size;
+                    moved = 1;
+                }
+            }
+        } while (moved);
+
+        lt->offset = offset;
+        arena_size = FFMAX(arena_size, offset + lt->size);
+    }
+
+    if (arena_size) {
+        network->arena = av_malloc(arena_size);
+        if (!network->arena)
+            goto fail;
+        network->arena_size = arena_size;
+    }
+    for (int i = 0; i < nb_lifetimes; ++i) {
+        DnnOperand *oprd = &network->operands[lifetimes[i].operand];
+        oprd->data = network->arena + lifetimes[i].offset;
+        oprd->in_arena = 1;
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "peak activation memory: %"SIZE_SPECIFIER" bytes "
+           "(%"SIZE_SPECIFIER" bytes of input, %"SIZE_SPECIFIER" bytes shared by %d operands "
+           "instead of %"SIZE_SPECIFIER")\n", input_size + arena_size, input_size,
+           arena_size, nb_lifetimes, unshared_size);
+
+    av_freep(&lifetimes);
+    av_freep(&operand_lifetime);
+    return 0;
+
+fail:
+    av_freep(&lifetimes);
+    av_freep(&operand_lifetime);
+    return -1;
+}
+
+/**
+ * @return the index of the layer writing operand, -1 if there is none
+ */
+static int find_producer(const ConvolutionalNetwork *network, const uint8_t *removed, int32_t operand)
+{
+    for (int layer = 0; layer < network->layers_num; ++layer) {
+        if (!removed[layer] && network->layers[layer].output_operand_index == operand)
+            return layer;
+    }
+    return -1;
+}
+
+/**
+ * @return the index of the only layer reading operand, -1 if it is read by
+ *         no or several layers, or if it is not an intermediate operand
+ */
+static int find_single_consumer(const ConvolutionalNetwork *network, const uint8_t *removed, int32_t operand)
+{
+    int consumer = -1;
+
+    if (network->operands[operand].type != DOT_INTERMEDIATE)
+        return -1;
+    for (int layer = 0; layer < network->layers_num; ++layer) {
+        if (removed[layer] || network->layers[layer].input_operand_indexes[0] != operand)
+            continue;
+        if (consumer >= 0)
+            return -1;
+        consumer = layer;
+    }
+    return consumer;
+}
+
+/**
+ * Merge the pad layer before a conv2d layer into its border handling, and the
+ * maximum and depth to space layers after it into its epilogue, so that their
+ * intermediate operands are never written.
+ * Fusion is only an optimization, the network is left as is on failure.
+ */
+static void fuse_layers(ConvolutionalNetwork *network)
+{
+    uint8_t *removed = av_mallocz(network->layers_num);
+    int nb_layers = 0;
+
+    if (!removed)
+        return;
+
+    for (int layer = 0; layer < network->layers_num; ++layer) {
+        Layer *conv = &network->layers[layer];
+        ConvolutionalParams *conv_params;
+        int other;
+
+        if (conv->type != DLT_CONV2D)
+            continue;
+        conv_params = conv->params;
+
+        // pad -> conv2d, the pad must not touch the number and channel dims
+        other = find_producer(network, removed, conv->input_operand_indexes[0]);
+        if (other >= 0 && network->layers[other].type == DLT_MIRROR_PAD &&
+            conv_params->padding_method == VALID &&
+            find_single_consumer(network, removed, conv->input_operand_indexes[0]) == layer) {
+            const LayerPadParams *pad_params = network->layers[other].params;
+            if (!pad_params->paddings[0][0] && !pad_params->paddings[0][1] &&
+                !pad_params->paddings[3][0] && !pad_params->paddings[3][1]) {
+                conv_params->fused_pad = 1;
+                conv_params->pad_params = *pad_params;
+                conv->input_operand_indexes[0] = network->layers[other].input_operand_indexes[0];
+                removed[other] = 1;
+            }
+        }
+
+        // conv2d -> maximum and/or depth to space
+        while ((other = find_single_consumer(network, removed, conv->output_operand_index)) >= 0) {
+            Layer *next = &network->layers[other];
+            if (next->type == DLT_MAXIMUM && !conv_params->fused_maximum) {
+                conv_params->fused_maximum = 1;
+                conv_params->maximum_value = ((const DnnLayerMaximumParams *)next->params)->val.y;
+            } else if (next->type == DLT_DEPTH_TO_SPACE && !conv_params->fused_block_size) {
+                int block_size = ((const DepthToSpaceParams *)next->params)->block_size;
+                if (block_size <= 0 || conv_params->output_num % (block_size * block_size))
+                    break;
+                conv_params->fused_block_size = block_size;
+            } else {
+                break;
+            }
+            conv->output_operand_index = next->output_operand_index;
+            removed[other] = 1;
+        }
+    }
+
+    for (int layer = 0; layer < network->layers_num; ++layer) {
+        if (removed[layer])
+            av_freep(&network->layers[layer].params);
+        else
+            network->layers[nb_layers++] = network->layers[layer];
+    }
+    if (nb_layers != network->layers_num)
+        av_log(&network->ctx, AV_LOG_VERBOSE, "%d layers fused into conv2d layers\n",
+               network->layers_num - nb_layers);
+    network->layers_num = nb_layers;
+    av_freep(&removed);
+}
+
 static DNNReturnType get_input_native(void *model, DNNData *input, const char *input_name)
 {
     ConvolutionalNetwork *network = (ConvolutionalNetwork *)model;
@@ -50,6 +351,57 @@ static DNNReturnType get_input_native(void *model, DNNData *input, const char *i
     return DNN_ERROR;
 }
 
+/**
+ * Walk the layers from the inputs, keeping for every operand the radius of
+ * its receptive field in input pixels and its scale relative to the input.
+ */
+static DNNReturnType get_receptive_field_native(void *model, int *radius)
+{
+    ConvolutionalNetwork *network = (ConvolutionalNetwork *)model;
+    int *operand_radius, *operand_scale;
+
+    operand_radius = av_mallocz_array(network->operands_num, sizeof(*operand_radius));
+    operand_scale = av_malloc_array(network->operands_num, sizeof(*operand_scale));
+    if (!operand_radius || !operand_scale) {
+        av_freep(&operand_radius);
+        av_freep(&operand_scale);
+        return DNN_ERROR;
+    }
+    for (int i = 0; i < network->operands_num; ++i)
+        operand_scale[i] = 1;
+
+    *radius = 0;
+    for (int layer = 0; layer < network->layers_num; ++layer) {
+        const Layer *l = &network->layers[layer];
+        int r = operand_radius[l->input_operand_indexes[0]];
+        int scale = operand_scale[l->input_operand_indexes[0]];
+
+        switch (l->type) {
+        case DLT_CONV2D: {
+            const ConvolutionalParams *params = l->params;
+            int conv_radius = (params->dilation * (params->kernel_size - 1) + 1) / 2;
+            r += (conv_radius + scale - 1) / scale;
+            if (params->fused_block_size)
+                scale *= params->fused_block_size;
+            break;
+        }
+        case DLT_DEPTH_TO_SPACE:
+            scale *= ((const DepthToSpaceParams *)l->params)->block_size;
+            break;
+        default:
+            break;
+        }
+
+        operand_radius[l->output_operand_index] = r;
+        operand_scale[l->output_operand_index] = scale;
+        *radius = FFMAX(*radius, r);
+    }
+
+    av_freep(&operand_radius);
+    av_freep(&operand_scale);
+    return DNN_SUCCESS;
+}
+
 static DNNReturnType set_input_output_native(void *model, DNNData *input, const char *input_name, const char **output_names, uint32_t nb_output)
 {
     ConvolutionalNetwork *network = (ConvolutionalNetwork *)model;
@@ -72,6 +424,10 @@ static DNNReturnType set_input_output_native(void *model, DNNData *input, const
     if (!oprd)
         return DNN_ERROR;
 
+    // the requests have the size of the previous input
+    ff_dnn_async_queue_free(&network->async_queue);
+
+    network->input_index = oprd - network->operands;
     oprd->dims[0] = 1;
     oprd->dims[1] = input->height;
     oprd->dims[2] = input->width;
@@ -106,6 +462,9 @@ static DNNReturnType set_input_output_native(void *model, DNNData *input, const
     if (network->nb_output != nb_output)
         return DNN_ERROR;
 
+    if (plan_operand_memory(network) < 0)
+        return DNN_ERROR;
+
     return DNN_SUCCESS;
 }
 
@@ -113,20 +472,22 @@ static DNNReturnType set_input_output_native(void *model, DNNData *input, const
 // layers_num,layer_type,layer_parameterss,layer_type,layer_parameters...
 // For CONV layer: activation_function, input_num, output_num, kernel_size, kernel, biases
 // For DEPTH_TO_SPACE layer: block_size
-DNNModel *ff_dnn_load_model_native(const char *model_filename)
+DNNModel *ff_dnn_load_model_native(const char *model_filename, const char *options)
 {
     DNNModel *model = NULL;
     char header_expected[] = "FFMPEGDNNNATIVE";
     char *buf;
     size_t size;
-    int version, header_size, major_version_expected = 1;
+    int header_size, major_version;
     ConvolutionalNetwork *network = NULL;
     AVIOContext *model_file_context;
+    NativeModelFile model_file = { 0 };
+    const char *protocol;
     int file_size, dnn_size, parsed_size;
     int32_t layer;
     DNNLayerType layer_type;
 
-    model = av_malloc(sizeof(DNNModel));
+    model = av_mallocz(sizeof(DNNModel));
     if (!model){
         return NULL;
     }
@@ -159,16 +520,18 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
     }
     av_freep(&buf);
 
-    version = (int32_t)avio_rl32(model_file_context);
+    // version 1 files store the weights unaligned and in model order,
+    // version 2 files store them aligned and prepacked so they can be mapped
+    major_version = (int32_t)avio_rl32(model_file_context);
     dnn_size += 4;
-    if (version != major_version_expected) {
+    if (major_version != 1 && major_version != 2) {
         avio_closep(&model_file_context);
         av_freep(&model);
         return NULL;
     }
 
     // currently no need to check minor version
-    version = (int32_t)avio_rl32(model_file_context);
+    avio_rl32(model_file_context);
     dnn_size += 4;
     header_size = dnn_size;
 
@@ -180,6 +543,35 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
     }
     model->model = (void *)network;
 
+    if (init_native_context(&network->ctx, options) < 0) {
+        avio_closep(&model_file_context);
+        ff_dnn_free_model_native(&model);
+        return NULL;
+    }
+
+    // only local files can be mapped, the weights of other ones are copied
+    protocol = avio_find_protocol_name(model_filename);
+    if (major_version == 2 && protocol && !strcmp(protocol, "file")) {
+        const char *path = model_filename;
+        av_strstart(path, "file:", &path);
+        if (av_file_map(path, &network->file_map, &network->file_map_size, 0, &network->ctx) < 0) {
+            network->file_map = NULL;
+            network->file_map_size = 0;
+        } else {
+            av_log(&network->ctx, AV_LOG_VERBOSE, "model file mapped, weights are used in place\n");
+        }
+    }
+    if (network->file_map && network->file_map_size != file_size) {
+        avio_closep(&model_file_context);
+        ff_dnn_free_model_native(&model);
+        return NULL;
+    }
+    model_file.pb = model_file_context;
+    model_file.file_size = file_size;
+    model_file.major_version = major_version;
+    model_file.map = network->file_map;
+    model_file.map_size = network->file_map_size;
+
     avio_seek(model_file_context, file_size - 8, SEEK_SET);
     network->layers_num = (int32_t)avio_rl32(model_file_context);
     network->operands_num = (int32_t)avio_rl32(model_file_context);
@@ -211,7 +603,7 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         }
 
         network->layers[layer].type = layer_type;
-        parsed_size = layer_funcs[layer_type].pf_load(&network->layers[layer], model_file_context, file_size);
+        parsed_size = layer_funcs[layer_type].pf_load(&network->layers[layer], &model_file);
         if (!parsed_size) {
             avio_closep(&model_file_context);
             ff_dnn_free_model_native(&model);
@@ -254,43 +646,240 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         return NULL;
     }
 
+    if (network->ctx.options.fuse)
+        fuse_layers(network);
+
+    if (network->ctx.options.profile) {
+        network->profile = av_mallocz_array(network->layers_num, sizeof(*network->profile));
+        if (!network->profile) {
+            ff_dnn_free_model_native(&model);
+            return NULL;
+        }
+    }
+
     model->set_input_output = &set_input_output_native;
     model->get_input = &get_input_native;
+    model->get_receptive_field = &get_receptive_field_native;
 
     return model;
 }
 
+static void execute_layers(ConvolutionalNetwork *network)
+{
+    for (int32_t layer = 0; layer < network->layers_num; ++layer){
+        const Layer *l = &network->layers[layer];
+        int64_t start = network->profile ? av_gettime_relative() : 0;
+
+        layer_funcs[l->type].pf_exec(network->operands,
+                                     l->input_operand_indexes,
+                                     l->output_operand_index,
+                                     l->params,
+                                     &network->ctx);
+
+        if (network->profile) {
+            LayerProfile *profile = &network->profile[layer];
+            profile->time += av_gettime_relative() - start;
+            profile->nb_calls++;
+            if (layer_funcs[l->type].pf_flops)
+                profile->flops += layer_funcs[l->type].pf_flops(network->operands, l->input_operand_indexes,
+                                                                l->output_operand_index, l->params);
+        }
+    }
+}
+
+static void report_profile(ConvolutionalNetwork *network)
+{
+    static const char *const layer_names[DLT_COUNT] = {
+        [DLT_INPUT]          = "input",
+        [DLT_CONV2D]         = "conv2d",
+        [DLT_DEPTH_TO_SPACE] = "depth2space",
+        [DLT_MIRROR_PAD]     = "mirror_pad",
+        [DLT_MAXIMUM]        = "maximum",
+    };
+    NativeContext *ctx = &network->ctx;
+    int64_t total_time = 0, total_flops = 0;
+
+    for (int32_t layer = 0; layer < network->layers_num; layer++) {
+        total_time += network->profile[layer].time;
+        total_flops += network->profile[layer].flops;
+    }
+
+    av_log(ctx, AV_LOG_INFO, "%-5s %-12s %-24s %8s %12s %6s %10s %9s\n",
+           "layer", "type", "output", "calls", "avg time(us)", "time%", "avg MFLOP", "GFLOP/s");
+    for (int32_t layer = 0; layer < network->layers_num; layer++) {
+        const LayerProfile *profile = &network->profile[layer];
+        const Layer *l = &network->layers[layer];
+        int64_t calls = FFMAX(profile->nb_calls, 1);
+
+        av_log(ctx, AV_LOG_INFO, "%-5d %-12s %-24.24s %8"PRId64" %12.1f %6.2f %10.3f %9.3f\n",
+               layer, layer_names[l->type], network->operands[l->output_operand_index].name,
+               profile->nb_calls, (double)profile->time / calls,
+               total_time ? 100.0 * profile->time / total_time : 0.0,
+               profile->flops / 1e6 / calls,
+               profile->time ? profile->flops / 1e3 / profile->time : 0.0);
+    }
+    av_log(ctx, AV_LOG_INFO, "total: %.3f ms, %.3f GFLOP, %.3f GFLOP/s\n",
+           total_time / 1e3, total_flops / 1e9, total_time ? total_flops / 1e3 / total_time : 0.0);
+}
+
+static void get_output(const ConvolutionalNetwork *network, uint32_t index, DNNData *output)
+{
+    const DnnOperand *oprd = &network->operands[network->output_indexes[index]];
+    output->data = oprd->data;
+    output->height = oprd->dims[1];
+    output->width = oprd->dims[2];
+    output->channels = oprd->dims[3];
+    output->dt = oprd->data_type;
+}
+
 DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *outputs, uint32_t nb_output)
 {
     ConvolutionalNetwork *network = (ConvolutionalNetwork *)model->model;
-    int32_t layer;
     uint32_t nb = FFMIN(nb_output, network->nb_output);
 
     if (network->layers_num <= 0 || network->operands_num <= 0)
         return DNN_ERROR;
     if (!network->operands[0].data)
         return DNN_ERROR;
+    // the requests are executed on the operands of the network
+    if (network->async_queue && ff_dnn_async_is_busy(network->async_queue)) {
+        av_log(&network->ctx, AV_LOG_ERROR, "cannot execute the model while asynchronous requests are in flight\n");
+        return DNN_ERROR;
+    }
 
-    for (layer = 0; layer < network->layers_num; ++layer){
-        DNNLayerType layer_type = network->layers[layer].type;
-        layer_funcs[layer_type].pf_exec(network->operands,
-                                  network->layers[layer].input_operand_indexes,
-                                  network->layers[layer].output_operand_index,
-                                  network->layers[layer].params);
+    execute_layers(network);
+
+    for (uint32_t i = 0; i < nb; ++i)
+        get_output(network, i, &outputs[i]);
+
+    return DNN_SUCCESS;
+}
+
+/**
+ * Run the requests one after the other, each with its input in place of
+ * the input operand, the outputs are copied before the arena is reused.
+ * ff_dnn_execute_model_native() fails while requests are in flight.
+ */
+static DNNReturnType execute_batch_native(void *model, DNNAsyncRequest **requests, int nb_requests)
+{
+    ConvolutionalNetwork *network = model;
+    DnnOperand *input = &network->operands[network->input_index];
+    void *input_data = input->data;
+    DNNReturnType ret = DNN_SUCCESS;
+
+    for (int i = 0; i < nb_requests && ret == DNN_SUCCESS; i++) {
+        input->data = requests[i]->input.data;
+        execute_layers(network);
+        for (uint32_t j = 0; j < network->nb_output && ret == DNN_SUCCESS; j++) {
+            DNNData output;
+            get_output(network, j, &output);
+            ret = ff_dnn_async_set_output(requests[i], j, &output);
+        }
     }
+    input->data = input_data;
+
+    return ret;
+}
+
+DNNReturnType ff_dnn_start_request_native(const DNNModel *model, DNNData *input)
+{
+    ConvolutionalNetwork *network = (ConvolutionalNetwork *)model->model;
+
+    if (network->nb_output == 0)
+        return DNN_ERROR;
 
-    for (uint32_t i = 0; i < nb; ++i) {
-        DnnOperand *oprd = &network->operands[network->output_indexes[i]];
-        outputs[i].data = oprd->data;
-        outputs[i].height = oprd->dims[1];
-        outputs[i].width = oprd->dims[2];
-        outputs[i].channels = oprd->dims[3];
-        outputs[i].dt = oprd->data_type;
+    if (!network->async_queue) {
+        const DnnOperand *oprd = &network->operands[network->input_index];
+        DNNData input_template = {
+            .dt       = oprd->data_type,
+            .height   = oprd->dims[1],
+            .width    = oprd->dims[2],
+            .channels = oprd->dims[3],
+        };
+        network->async_queue = ff_dnn_async_queue_alloc(network, execute_batch_native, &input_template,
+                                                        network->nb_output, network->ctx.options.nireq, 1,
+                                                        model->async_done, model->async_done_opaque);
+        if (!network->async_queue)
+            return DNN_ERROR;
     }
 
+    return ff_dnn_async_start_request(network->async_queue, input);
+}
+
+DNNReturnType ff_dnn_execute_model_async_native(const DNNModel *model, void *user_data)
+{
+    ConvolutionalNetwork *network = (ConvolutionalNetwork *)model->model;
+
+    if (!network->async_queue)
+        return DNN_ERROR;
+    return ff_dnn_async_execute(network->async_queue, user_data);
+}
+
+DNNAsyncStatusType ff_dnn_get_async_result_native(const DNNModel *model, DNNData *outputs, uint32_t nb_output,
+                                                  void **user_data, int wait)
+{
+    ConvolutionalNetwork *network = (ConvolutionalNetwork *)model->model;
+
+    if (!network->async_queue)
+        return DAST_EMPTY_QUEUE;
+    return ff_dnn_async_get_result(network->async_queue, outputs, nb_output, user_data, wait);
+}
+
+DNNReturnType ff_dnn_flush_native(const DNNModel *model)
+{
+    ConvolutionalNetwork *network = (ConvolutionalNetwork *)model->model;
+
+    if (network->async_queue)
+        ff_dnn_async_flush(network->async_queue);
     return DNN_SUCCESS;
 }
 
+int ff_dnn_native_get_nb_jobs(const NativeContext *ctx, int nb_rows)
+{
+    if (!ctx)
+        return 1;
+    return av_clip(nb_rows, 1, ctx->nb_threads);
+}
+
+int ff_dnn_native_alloc_operand_data(DnnOperand *oprd)
+{
+    int32_t length = calculate_operand_data_length(oprd);
+
+    if (oprd->in_arena) {
+        // the memory planner reserved oprd->length bytes
+        if (length > oprd->length)
+            return -1;
+        oprd->length = length;
+        return 0;
+    }
+
+    oprd->length = length;
+    oprd->data = av_realloc(oprd->data, oprd->length);
+    return oprd->data ? 0 : -1;
+}
+
+void *ff_dnn_native_get_scratch(NativeContext *ctx, size_t size)
+{
+    if (size > UINT_MAX)
+        return NULL;
+    av_fast_malloc(&ctx->scratch, &ctx->scratch_size, size);
+    return ctx->scratch;
+}
+
+void ff_dnn_native_execute_jobs(NativeContext *ctx, void (*func)(void *arg, int jobnr, int nb_jobs),
+                                void *arg, int nb_jobs)
+{
+    if (!ctx || !ctx->slicethread || nb_jobs == 1) {
+        for (int i = 0; i < nb_jobs; i++)
+            func(arg, i, nb_jobs);
+        return;
+    }
+
+    ctx->job_func = func;
+    ctx->job_arg = arg;
+    avpriv_slicethread_execute(ctx->slicethread, nb_jobs, 0);
+}
+
 int32_t calculate_operand_dims_count(const DnnOperand *oprd)
 {
     int32_t result = 1;
@@ -300,6 +889,47 @@ int32_t calculate_operand_dims_count(const DnnOperand *oprd)
     return result;
 }
 
+int ff_dnn_native_blob_is_mapped(const NativeModelFile *model_file)
+{
+    return model_file->map && !HAVE_BIGENDIAN;
+}
+
+void *ff_dnn_native_read_blob(NativeModelFile *model_file, int nb_elements, int elem_size)
+{
+    int64_t pos = avio_tell(model_file->pb);
+    int64_t start = FFALIGN(pos, DNN_NATIVE_BLOB_ALIGN);
+    int size;
+    uint8_t *blob;
+
+    if (nb_elements <= 0 || start > model_file->file_size ||
+        nb_elements > (model_file->file_size - start) / elem_size)
+        return NULL;
+    size = nb_elements * elem_size;
+    if (avio_skip(model_file->pb, start - pos) < 0)
+        return NULL;
+
+    if (ff_dnn_native_blob_is_mapped(model_file)) {
+        if (avio_skip(model_file->pb, size) < 0)
+            return NULL;
+        return model_file->map + start;
+    }
+
+    blob = av_malloc(size);
+    if (!blob)
+        return NULL;
+    if (avio_read(model_file->pb, blob, size) != size) {
+        av_freep(&blob);
+        return NULL;
+    }
+#if HAVE_BIGENDIAN
+    if (elem_size == 4) {
+        for (int i = 0; i < nb_elements; ++i)
+            AV_WN32A(blob + i * 4, AV_RL32(blob + i * 4));
+    }
+#endif
+    return blob;
+}
+
 int32_t calculate_operand_data_length(const DnnOperand* oprd)
 {
     // currently, we just support DNN_FLOAT
@@ -315,21 +945,33 @@ void ff_dnn_free_model_native(DNNModel **model)
     if (*model)
     {
         network = (ConvolutionalNetwork *)(*model)->model;
+        // the worker thread may still be executing the layers
+        ff_dnn_async_queue_free(&network->async_queue);
+        if (network->profile) {
+            report_profile(network);
+            av_freep(&network->profile);
+        }
         for (layer = 0; layer < network->layers_num; ++layer){
-            if (network->layers[layer].type == DLT_CONV2D){
+            if (network->layers[layer].type == DLT_CONV2D && network->layers[layer].params){
                 conv_params = (ConvolutionalParams *)network->layers[layer].params;
-                av_freep(&conv_params->kernel);
-                av_freep(&conv_params->biases);
+                dnn_free_layer_conv2d(conv_params);
             }
             av_freep(&network->layers[layer].params);
         }
         av_freep(&network->layers);
 
-        for (uint32_t operand = 0; operand < network->operands_num; ++operand)
-            av_freep(&network->operands[operand].data);
+        for (uint32_t operand = 0; operand < network->operands_num; ++operand) {
+            if (!network->operands[operand].in_arena)
+                av_freep(&network->operands[operand].data);
+        }
         av_freep(&network->operands);
+        av_freep(&network->arena);
 
         av_freep(&network->output_indexes);
+        avpriv_slicethread_free(&network->ctx.slicethread);
+        av_freep(&network->ctx.scratch);
+        if (network->file_map)
+            av_file_unmap(network->file_map, network->file_map_size);
         av_freep(&network);
         av_freep(model);
     }
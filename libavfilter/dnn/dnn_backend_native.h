@@ -28,7 +28,9 @@
 #define AVFILTER_DNN_DNN_BACKEND_NATIVE_H
 
 #include "../dnn_interface.h"
+#include "dnn_async.h"
 #include "libavformat/avio.h"
+#include "libavutil/slicethread.h"
 
 /**
  * the enum value of DNNLayerType should not be changed,
@@ -44,7 +46,7 @@ typedef enum {
     DLT_COUNT
 } DNNLayerType;
 
-typedef enum {DOT_INPUT = 1, DOT_OUTPUT = 2, DOT_INTERMEDIATE = DOT_INPUT | DOT_INPUT} DNNOperandType;
+typedef enum {DOT_INPUT = 1, DOT_OUTPUT = 2, DOT_INTERMEDIATE = DOT_INPUT | DOT_OUTPUT} DNNOperandType;
 
 typedef struct Layer{
     DNNLayerType type;
@@ -90,34 +92,183 @@ typedef struct DnnOperand{
     /**
      * data pointer with data length in bytes.
      * usedNumbersLeft is only valid for intermediate operand,
-     * it means how many layers still depend on this operand,
-     * todo: the memory can be reused when usedNumbersLeft is zero.
+     * it means how many layers still depend on this operand.
      */
     void *data;
     int32_t length;
     int32_t usedNumbersLeft;
+
+    /**
+     * set when data points into the operand arena of the network, it is
+     * then shared with operands having non-overlapping lifetimes, and it
+     * must not be reallocated or freed, see ff_dnn_native_alloc_operand_data().
+     */
+    int8_t in_arena;
 }DnnOperand;
 
 typedef struct InputParams{
     int height, width, channels;
 } InputParams;
 
+typedef struct NativeOptions{
+    int32_t threads;
+    int32_t fuse;
+    int32_t nireq;
+    int32_t profile;
+} NativeOptions;
+
+typedef struct NativeContext{
+    const AVClass *class;
+    NativeOptions options;
+
+    /**
+     * layers split their work across nb_threads jobs run on slicethread,
+     * slicethread is NULL when there is only one thread.
+     */
+    AVSliceThread *slicethread;
+    int nb_threads;
+
+    /**
+     * job currently dispatched by ff_dnn_native_execute_jobs()
+     */
+    void (*job_func)(void *arg, int jobnr, int nb_jobs);
+    void *job_arg;
+
+    /**
+     * temporary buffer of the layer executions, kept across executions,
+     * see ff_dnn_native_get_scratch()
+     */
+    uint8_t *scratch;
+    unsigned int scratch_size;
+} NativeContext;
+
+/**
+ * weight blobs of version 2 model files start at a multiple of this offset
+ */
+#define DNN_NATIVE_BLOB_ALIGN 64
+
+typedef struct NativeModelFile{
+    AVIOContext *pb;
+    int file_size;
+    int major_version;
+
+    /**
+     * whole model file mapped read-only, NULL if it could not be mapped,
+     * the weight blobs of version 2 files are then read into private buffers.
+     */
+    uint8_t *map;
+    size_t map_size;
+} NativeModelFile;
+
+/**
+ * accumulated over the executions of a layer when profiling
+ */
+typedef struct LayerProfile{
+    int64_t nb_calls;
+    int64_t time;               ///< in microseconds
+    int64_t flops;
+} LayerProfile;
+
 // Represents simple feed-forward convolutional network.
 typedef struct ConvolutionalNetwork{
+    NativeContext ctx;
     Layer *layers;
     int32_t layers_num;
     DnnOperand *operands;
     int32_t operands_num;
+    int32_t input_index;
     int32_t *output_indexes;
     uint32_t nb_output;
+
+    /**
+     * buffer shared by the intermediate and output operands,
+     * planned by set_input_output from the operand lifetimes.
+     */
+    uint8_t *arena;
+    size_t arena_size;
+
+    /**
+     * model file mapping the layer weights of version 2 files point into
+     */
+    uint8_t *file_map;
+    size_t file_map_size;
+
+    /**
+     * requests of the asynchronous execution, allocated by the first
+     * start_request call after set_input_output
+     */
+    DNNAsyncQueue *async_queue;
+
+    /**
+     * one entry per layer with the profile option, reported when the model
+     * is freed, NULL otherwise
+     */
+    LayerProfile *profile;
 } ConvolutionalNetwork;
 
-DNNModel *ff_dnn_load_model_native(const char *model_filename);
+DNNModel *ff_dnn_load_model_native(const char *model_filename, const char *options);
 
 DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *outputs, uint32_t nb_output);
 
+DNNReturnType ff_dnn_start_request_native(const DNNModel *model, DNNData *input);
+
+DNNReturnType ff_dnn_execute_model_async_native(const DNNModel *model, void *user_data);
+
+DNNAsyncStatusType ff_dnn_get_async_result_native(const DNNModel *model, DNNData *outputs, uint32_t nb_output,
+                                                  void **user_data, int wait);
+
+DNNReturnType ff_dnn_flush_native(const DNNModel *model);
+
 void ff_dnn_free_model_native(DNNModel **model);
 
+/**
+ * Get the number of jobs a layer producing nb_rows output rows should be split into.
+ *
+ * @param ctx native context, may be NULL for single-threaded execution
+ */
+int ff_dnn_native_get_nb_jobs(const NativeContext *ctx, int nb_rows);
+
+/**
+ * Get a buffer of at least size bytes for the temporary data of a layer
+ * execution. It is reused by the next layers and executions, and freed
+ * with the model.
+ *
+ * @return the buffer, or NULL on allocation failure
+ */
+void *ff_dnn_native_get_scratch(NativeContext *ctx, size_t size);
+
+/**
+ * Call func(arg, jobnr, nb_jobs) for each jobnr in [0, nb_jobs), on the slice
+ * threads of ctx if it has any and on the calling thread otherwise.
+ *
+ * @param ctx native context, may be NULL for single-threaded execution
+ */
+void ff_dnn_native_execute_jobs(NativeContext *ctx, void (*func)(void *arg, int jobnr, int nb_jobs),
+                                void *arg, int nb_jobs);
+
+/**
+ * Make oprd->data hold the calculate_operand_data_length(oprd) bytes of the
+ * operand, the buffer reserved by the memory planner is used if there is one.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int ff_dnn_native_alloc_operand_data(DnnOperand *oprd);
+
+/**
+ * Get nb_elements little-endian elements of elem_size bytes stored at the next
+ * multiple of DNN_NATIVE_BLOB_ALIGN in a version 2 model file, and skip them.
+ * When ff_dnn_native_blob_is_mapped() the elements are used in place from the
+ * file mapping, otherwise they are read into a buffer to be freed by the caller.
+ *
+ * @return pointer to the elements, NULL on failure
+ */
+void *ff_dnn_native_read_blob(NativeModelFile *model_file, int nb_elements, int elem_size);
+
+/**
+ * @return 1 if ff_dnn_native_read_blob() returns pointers into the file mapping
+ */
+int ff_dnn_native_blob_is_mapped(const NativeModelFile *model_file);
+
 int32_t calculate_operand_data_length(const DnnOperand *oprd);
 int32_t calculate_operand_dims_count(const DnnOperand *oprd);
 #endif
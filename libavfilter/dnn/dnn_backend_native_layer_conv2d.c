@@ -18,20 +18,86 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
+
 #include "libavutil/avassert.h"
+#include "libavutil/common.h"
 #include "dnn_backend_native_layer_conv2d.h"
 
 #define CLAMP_TO_EDGE(x, w) ((x) < 0 ? 0 : ((x) >= (w) ? (w - 1) : (x)))
 
-int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size)
+/**
+ * compute one output pel as a vector/matrix product:
+ * dst[n] = sum(src[k] * kernel[k][n]) for 0 <= k < src_len, 0 <= n < dst_len,
+ * with kernel in the layout produced by dnn_pack_layer_conv2d()
+ */
+static void conv2d_gemv(float *dst, const float *src, const float *kernel,
+                        int src_len, int dst_len)
 {
-    ConvolutionalParams *conv_params;
-    int kernel_size;
-    int dnn_size = 0;
-    conv_params = av_malloc(sizeof(*conv_params));
-    if (!conv_params)
-        return 0;
+    for (int n = 0; n < dst_len; n += DNN_CONV2D_BLOCK) {
+        float acc[DNN_CONV2D_BLOCK] = { 0 };
+        for (int k = 0; k < src_len; ++k) {
+            for (int i = 0; i < DNN_CONV2D_BLOCK; ++i)
+                acc[i] += src[k] * kernel[i];
+            kernel += DNN_CONV2D_BLOCK;
+        }
+        memcpy(dst + n, acc, sizeof(acc));
+    }
+}
+
+int dnn_pack_layer_conv2d(ConvolutionalParams *conv_params)
+{
+    int input_num = conv_params->input_num;
+    int output_num = conv_params->output_num;
+    int filter_size = conv_params->kernel_size * conv_params->kernel_size * input_num;
+    int packed_output_num = FFALIGN(output_num, DNN_CONV2D_BLOCK);
+
+    conv_params->packed_output_num = packed_output_num;
+    conv_params->packed_kernel = NULL;
+    conv_params->weights_mapped = 0;
+
+    conv_params->packed_kernel = av_mallocz_array(filter_size, packed_output_num * sizeof(float));
+    if (!conv_params->packed_kernel)
+        return -1;
+
+    // the model stores kernel as [n_filter][kernel_y][kernel_x][ch],
+    // the im2col row index k covers (kernel_y, kernel_x, ch) in that order
+    for (int n_filter = 0; n_filter < output_num; ++n_filter) {
+        float *panel = conv_params->packed_kernel + (n_filter / DNN_CONV2D_BLOCK) * filter_size * DNN_CONV2D_BLOCK;
+        for (int k = 0; k < filter_size; ++k)
+            panel[k * DNN_CONV2D_BLOCK + n_filter % DNN_CONV2D_BLOCK] = conv_params->kernel[n_filter * filter_size + k];
+    }
+
+    return 0;
+}
+
+void dnn_get_kernel_conv2d(const ConvolutionalParams *conv_params, float *kernel)
+{
+    int filter_size = conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+
+    if (conv_params->kernel) {
+        memcpy(kernel, conv_params->kernel, conv_params->output_num * filter_size * sizeof(float));
+        return;
+    }
 
+    for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
+        const float *panel = conv_params->packed_kernel + (n_filter / DNN_CONV2D_BLOCK) * filter_size * DNN_CONV2D_BLOCK;
+        for (int k = 0; k < filter_size; ++k)
+            kernel[n_filter * filter_size + k] = panel[k * DNN_CONV2D_BLOCK + n_filter % DNN_CONV2D_BLOCK];
+    }
+}
+
+void dnn_free_layer_conv2d(ConvolutionalParams *conv_params)
+{
+    av_freep(&conv_params->kernel);
+    if (conv_params->weights_mapped)
+        return;
+    av_freep(&conv_params->biases);
+    av_freep(&conv_params->packed_kernel);
+}
+
+static int read_conv2d_params(ConvolutionalParams *conv_params, AVIOContext *model_file_context)
+{
     conv_params->dilation = (int32_t)avio_rl32(model_file_context);
     conv_params->padding_method = (int32_t)avio_rl32(model_file_context);
     conv_params->activation = (int32_t)avio_rl32(model_file_context);
@@ -39,25 +105,61 @@ int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int fil
     conv_params->output_num = (int32_t)avio_rl32(model_file_context);
     conv_params->kernel_size = (int32_t)avio_rl32(model_file_context);
     conv_params->has_bias = (int32_t)avio_rl32(model_file_context);
-    dnn_size += 28;
 
-    kernel_size = conv_params->input_num * conv_params->output_num *
-                      conv_params->kernel_size * conv_params->kernel_size;
-    dnn_size += kernel_size * 4;
-    if (conv_params->has_bias)
-        dnn_size += conv_params->output_num * 4;
+    if (conv_params->input_num <= 0 || conv_params->output_num <= 0 || conv_params->kernel_size <= 0 ||
+        conv_params->kernel_size > INT_MAX / conv_params->kernel_size / conv_params->input_num)
+        return -1;
+    return 28;
+}
 
-    if (dnn_size > file_size || conv_params->input_num <= 0 ||
-        conv_params->output_num <= 0 || conv_params->kernel_size <= 0){
-        av_freep(&conv_params);
-        return 0;
+/**
+ * load the weights of a version 2 model file, which are stored as aligned
+ * blobs already in the packed layout, so they can be used in place
+ */
+static int load_packed_weights(ConvolutionalParams *conv_params, NativeModelFile *model_file)
+{
+    int filter_size = conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+    int packed_output_num = FFALIGN(conv_params->output_num, DNN_CONV2D_BLOCK);
+
+    conv_params->packed_output_num = packed_output_num;
+    conv_params->weights_mapped = ff_dnn_native_blob_is_mapped(model_file);
+
+    if (filter_size > INT_MAX / packed_output_num / sizeof(float))
+        return -1;
+    conv_params->packed_kernel = ff_dnn_native_read_blob(model_file, filter_size * packed_output_num, 4);
+    if (!conv_params->packed_kernel)
+        return -1;
+
+    if (conv_params->has_bias) {
+        conv_params->biases = ff_dnn_native_read_blob(model_file, conv_params->output_num, 4);
+        if (!conv_params->biases)
+            return -1;
     }
 
+    return 0;
+}
+
+/**
+ * load the weights of a version 1 model file, stored unaligned in model order
+ */
+static int load_kernel_v1(ConvolutionalParams *conv_params, NativeModelFile *model_file)
+{
+    AVIOContext *model_file_context = model_file->pb;
+    int kernel_size = conv_params->input_num * conv_params->kernel_size * conv_params->kernel_size;
+    int dnn_size;
+
+    if (kernel_size > (model_file->file_size / 4) / conv_params->output_num)
+        return -1;
+    kernel_size *= conv_params->output_num;
+    dnn_size = kernel_size * 4;
+    if (conv_params->has_bias)
+        dnn_size += conv_params->output_num * 4;
+    if (dnn_size > model_file->file_size - avio_tell(model_file_context))
+        return -1;
+
     conv_params->kernel = av_malloc(kernel_size * sizeof(float));
-    if (!conv_params->kernel) {
-        av_freep(&conv_params);
-        return 0;
-    }
+    if (!conv_params->kernel)
+        return -1;
     for (int i = 0; i < kernel_size; ++i) {
         conv_params->kernel[i] = av_int2float(avio_rl32(model_file_context));
     }
@@ -65,103 +167,266 @@ int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int fil
     conv_params->biases = NULL;
     if (conv_params->has_bias) {
         conv_params->biases = av_malloc(conv_params->output_num * sizeof(float));
-        if (!conv_params->biases){
-            av_freep(&conv_params->kernel);
-            av_freep(&conv_params);
-            return 0;
-        }
+        if (!conv_params->biases)
+            return -1;
         for (int i = 0; i < conv_params->output_num; ++i){
             conv_params->biases[i] = av_int2float(avio_rl32(model_file_context));
         }
     }
 
+    return dnn_pack_layer_conv2d(conv_params);
+}
+
+int dnn_load_layer_conv2d(Layer *layer, NativeModelFile *model_file)
+{
+    AVIOContext *model_file_context = model_file->pb;
+    int64_t start = avio_tell(model_file_context);
+    ConvolutionalParams *conv_params;
+
+    conv_params = av_mallocz(sizeof(*conv_params));
+    if (!conv_params)
+        return 0;
+
+    if (read_conv2d_params(conv_params, model_file_context) < 0)
+        goto fail;
+
+    if (model_file->major_version >= 2) {
+        if (load_packed_weights(conv_params, model_file) < 0)
+            goto fail;
+    } else {
+        if (load_kernel_v1(conv_params, model_file) < 0)
+            goto fail;
+    }
+
     layer->params = conv_params;
 
     layer->input_operand_indexes[0] = (int32_t)avio_rl32(model_file_context);
     layer->output_operand_index = (int32_t)avio_rl32(model_file_context);
-    dnn_size += 8;
-    return dnn_size;
+    if (avio_tell(model_file_context) > model_file->file_size)
+        return 0;
+    return avio_tell(model_file_context) - start;
+
+fail:
+    dnn_free_layer_conv2d(conv_params);
+    av_freep(&conv_params);
+    return 0;
 }
 
-int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
-                             int32_t output_operand_index, const void *parameters)
-{
+typedef struct ThreadData {
+    const ConvolutionalParams *conv_params;
+    const float *input;
     float *output;
-    int32_t input_operand_index = input_operand_indexes[0];
-    int number = operands[input_operand_index].dims[0];
-    int height = operands[input_operand_index].dims[1];
-    int width = operands[input_operand_index].dims[2];
-    int channel = operands[input_operand_index].dims[3];
-    const float *input = operands[input_operand_index].data;
-    const ConvolutionalParams *conv_params = (const ConvolutionalParams *)parameters;
+    float *scratch;
+    // size of the input operand, and of the input of the convolution
+    // which differs when a pad layer is fused
+    int in_width, in_height;
+    int width, height;
+    int pad_size;
+    int filter_size;
+    int scratch_size;
+    float pad_value;
 
+    // output layout, see dnn_execute_layer_conv2d()
+    int out_linesize;
+    int pel_stride;
+    int *channel_offsets;
+} ThreadData;
+
+/**
+ * map a coordinate of the convolution input along dim (1 for the height,
+ * 2 for the width) to the input operand, or -1 if it is filled with pad_value
+ */
+static av_always_inline int get_src_pos(const ThreadData *td, int pos, int dim)
+{
+    const ConvolutionalParams *conv_params = td->conv_params;
+    int size = dim == 1 ? td->in_height : td->in_width;
+
+    if (conv_params->fused_pad)
+        return dnn_pad_get_src_index(pos, conv_params->pad_params.paddings[dim][0], size,
+                                     conv_params->pad_params.mode);
+    if (conv_params->padding_method == SAME_CLAMP_TO_EDGE)
+        return CLAMP_TO_EDGE(pos, size);
+    return pos < 0 || pos >= size ? -1 : pos;
+}
+
+/**
+ * gather the input pels covered by the kernel centered on (x, y) into col,
+ * in the (kernel_y, kernel_x, ch) order used by the packed kernel
+ */
+static void im2col(float *col, const ThreadData *td, int x, int y)
+{
+    const ConvolutionalParams *conv_params = td->conv_params;
     int radius = conv_params->kernel_size >> 1;
-    int src_linesize = width * conv_params->input_num;
-    int filter_linesize = conv_params->kernel_size * conv_params->input_num;
-    int filter_size = conv_params->kernel_size * filter_linesize;
+    int src_linesize = td->in_width * conv_params->input_num;
+    int pel_size = conv_params->input_num * sizeof(float);
+
+    for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
+        int y_pos = get_src_pos(td, y + (kernel_y - radius) * conv_params->dilation, 1);
+        for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
+            int x_pos = get_src_pos(td, x + (kernel_x - radius) * conv_params->dilation, 2);
+            if (x_pos < 0 || y_pos < 0) {
+                for (int ch = 0; ch < conv_params->input_num; ++ch)
+                    col[ch] = td->pad_value;
+            } else {
+                memcpy(col, td->input + y_pos * src_linesize + x_pos * conv_params->input_num, pel_size);
+            }
+            col += conv_params->input_num;
+        }
+    }
+}
+
+static av_always_inline float activate(float x, DNNActivationFunc activation)
+{
+    switch (activation){
+    case RELU:
+        return FFMAX(x, 0.0);
+    case TANH:
+        return 2.0f  / (1.0f + exp(-2.0f * x)) - 1.0f;
+    case SIGMOID:
+        return 1.0f / (1.0f + exp(-x));
+    case NONE:
+        return x;
+    case LEAKY_RELU:
+        return FFMAX(x, 0.0) + 0.2 * FFMIN(x, 0.0);
+    }
+    return x;
+}
+
+/**
+ * apply the bias, the activation and a fused maximum layer to the result of
+ * the output channel n_filter, and store it at its place in dst
+ */
+static av_always_inline void store_output(const ThreadData *td, float *dst, int n_filter, float value)
+{
+    const ConvolutionalParams *conv_params = td->conv_params;
+
+    if (conv_params->has_bias)
+        value += conv_params->biases[n_filter];
+    value = activate(value, conv_params->activation);
+    if (conv_params->fused_maximum)
+        value = FFMAX(value, conv_params->maximum_value);
+    dst[td->channel_offsets[n_filter]] = value;
+}
+
+static void conv2d_job(void *arg, int jobnr, int nb_jobs)
+{
+    const ThreadData *td = arg;
+    const ConvolutionalParams *conv_params = td->conv_params;
+    int out_height = td->height - td->pad_size * 2;
+    int start = td->pad_size + (out_height * jobnr) / nb_jobs;
+    int end = td->pad_size + (out_height * (jobnr + 1)) / nb_jobs;
+    // acc first, so that it keeps the alignment of scratch
+    float *acc = td->scratch + jobnr * td->scratch_size;
+    float *col = acc + conv_params->packed_output_num;
+
+    for (int y = start; y < end; ++y) {
+        float *output = td->output + (y - td->pad_size) * td->out_linesize;
+        for (int x = td->pad_size; x < td->width - td->pad_size; ++x) {
+            im2col(col, td, x, y);
+            conv2d_gemv(acc, col, conv_params->packed_kernel,
+                        td->filter_size, conv_params->packed_output_num);
+
+            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter)
+                store_output(td, output, n_filter, acc[n_filter]);
+            output += td->pel_stride;
+        }
+    }
+}
+
+int dnn_infer_shape_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                 int32_t output_operand_index, const void *parameters)
+{
+    const DnnOperand *input_operand = &operands[input_operand_indexes[0]];
+    DnnOperand *output_operand = &operands[output_operand_index];
+    const ConvolutionalParams *conv_params = (const ConvolutionalParams *)parameters;
     int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+    int block_size = FFMAX(conv_params->fused_block_size, 1);
+    int height = input_operand->dims[1];
+    int width = input_operand->dims[2];
+
+    if (conv_params->fused_pad) {
+        height += conv_params->pad_params.paddings[1][0] + conv_params->pad_params.paddings[1][1];
+        width += conv_params->pad_params.paddings[2][0] + conv_params->pad_params.paddings[2][1];
+    }
+
+    if (input_operand->dims[3] != conv_params->input_num ||
+        height - pad_size * 2 <= 0 || width - pad_size * 2 <= 0)
+        return -1;
+
+    output_operand->dims[0] = input_operand->dims[0];
+    output_operand->dims[1] = (height - pad_size * 2) * block_size;
+    output_operand->dims[2] = (width - pad_size * 2) * block_size;
+    output_operand->dims[3] = conv_params->output_num / (block_size * block_size);
+    output_operand->data_type = input_operand->data_type;
+    return 0;
+}
+
+int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
+                             int32_t output_operand_index, const void *parameters, NativeContext *ctx)
+{
+    ThreadData td = { 0 };
+    int nb_jobs;
+    size_t scratch_size;
+    uint8_t *scratch;
+    int32_t input_operand_index = input_operand_indexes[0];
+    const ConvolutionalParams *conv_params = (const ConvolutionalParams *)parameters;
+    int block_size = FFMAX(conv_params->fused_block_size, 1);
+    int out_channels = conv_params->output_num / (block_size * block_size);
+    int out_width;
 
     DnnOperand *output_operand = &operands[output_operand_index];
-    output_operand->dims[0] = number;
-    output_operand->dims[1] = height - pad_size * 2;
-    output_operand->dims[2] = width - pad_size * 2;
-    output_operand->dims[3] = conv_params->output_num;
-    output_operand->data_type = operands[input_operand_index].data_type;
-    output_operand->length = calculate_operand_data_length(output_operand);
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data)
+    av_assert0(operands[input_operand_index].dims[3] == conv_params->input_num);
+    if (dnn_infer_shape_layer_conv2d(operands, input_operand_indexes, output_operand_index, parameters) < 0)
         return -1;
-    output = output_operand->data;
-
-    av_assert0(channel == conv_params->input_num);
-
-    for (int y = pad_size; y < height - pad_size; ++y) {
-        for (int x = pad_size; x < width - pad_size; ++x) {
-            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
-                if (conv_params->has_bias)
-                    output[n_filter] = conv_params->biases[n_filter];
-                else
-                    output[n_filter] = 0.f;
-
-                for (int ch = 0; ch < conv_params->input_num; ++ch) {
-                    for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
-                        for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
-                            float input_pel;
-                            if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
-                                int y_pos = CLAMP_TO_EDGE(y + (kernel_y - radius) * conv_params->dilation, height);
-                                int x_pos = CLAMP_TO_EDGE(x + (kernel_x - radius) * conv_params->dilation, width);
-                                input_pel = input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            } else {
-                                int y_pos = y + (kernel_y - radius) * conv_params->dilation;
-                                int x_pos = x + (kernel_x - radius) * conv_params->dilation;
-                                input_pel = (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height) ? 0.0 :
-                                                   input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            }
-
-
-                            output[n_filter] += input_pel * conv_params->kernel[n_filter * filter_size + kernel_y * filter_linesize +
-                                                                                kernel_x * conv_params->input_num + ch];
-                        }
-                    }
-                }
-                switch (conv_params->activation){
-                case RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0);
-                    break;
-                case TANH:
-                    output[n_filter] = 2.0f  / (1.0f + exp(-2.0f * output[n_filter])) - 1.0f;
-                    break;
-                case SIGMOID:
-                    output[n_filter] = 1.0f / (1.0f + exp(-output[n_filter]));
-                    break;
-                case NONE:
-                    break;
-                case LEAKY_RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0) + 0.2 * FFMIN(output[n_filter], 0.0);
-                }
-            }
-            output += conv_params->output_num;
-        }
+    if (ff_dnn_native_alloc_operand_data(output_operand) < 0)
+        return -1;
+
+    td.conv_params = conv_params;
+    td.input = operands[input_operand_index].data;
+    td.output = output_operand->data;
+    td.in_height = operands[input_operand_index].dims[1];
+    td.in_width = operands[input_operand_index].dims[2];
+    td.pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+    td.height = output_operand->dims[1] / block_size + td.pad_size * 2;
+    td.width = output_operand->dims[2] / block_size + td.pad_size * 2;
+    td.filter_size = conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+    td.scratch_size = conv_params->packed_output_num + FFALIGN(td.filter_size, DNN_CONV2D_BLOCK);
+    if (conv_params->fused_pad && conv_params->pad_params.mode == LPMP_CONSTANT)
+        td.pad_value = conv_params->pad_params.constant_values;
+
+    // the output of a pel is a block_size x block_size square of out_channels
+    // pels with a fused depth to space layer, and a single pel otherwise
+    out_width = output_operand->dims[2] / block_size;
+    td.out_linesize = out_width * conv_params->output_num;
+    td.pel_stride = block_size * out_channels;
+    nb_jobs = ff_dnn_native_get_nb_jobs(ctx, td.height - td.pad_size * 2);
+
+    // the im2col and accumulator rows of each job, then the channel offsets
+    scratch_size = nb_jobs * td.scratch_size * sizeof(float);
+    scratch = ff_dnn_native_get_scratch(ctx, scratch_size + conv_params->output_num * sizeof(int));
+    if (!scratch)
+        return -1;
+    td.scratch = (float *)scratch;
+    td.channel_offsets = (int *)(scratch + scratch_size);
+    for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
+        int block_pos = n_filter / out_channels;
+        td.channel_offsets[n_filter] = ((block_pos / block_size) * out_width * block_size + block_pos % block_size) *
+                                       out_channels + n_filter % out_channels;
     }
+
+    ff_dnn_native_execute_jobs(ctx, conv2d_job, &td, nb_jobs);
     return 0;
 }
+
+int64_t dnn_flops_layer_conv2d(const DnnOperand *operands, const int32_t *input_operand_indexes,
+                               int32_t output_operand_index, const void *parameters)
+{
+    const ConvolutionalParams *conv_params = (const ConvolutionalParams *)parameters;
+    // a fused depth to space layer only reorders the output elements
+    int64_t nb_outputs = calculate_operand_dims_count(&operands[output_operand_index]);
+    int64_t ops = 2LL * conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+
+    ops += conv_params->has_bias + (conv_params->activation != NONE) + conv_params->fused_maximum;
+
+    return nb_outputs * ops;
+}
@@ -22,10 +22,17 @@
 #define AVFILTER_DNN_DNN_BACKEND_NATIVE_LAYER_CONV2D_H
 
 #include "dnn_backend_native.h"
+#include "dnn_backend_native_layer_pad.h"
 
 typedef enum {RELU, TANH, SIGMOID, NONE, LEAKY_RELU} DNNActivationFunc;
 typedef enum {VALID, SAME, SAME_CLAMP_TO_EDGE} DNNConvPaddingParam;
 
+/**
+ * number of output channels held in one panel of the packed kernel,
+ * the packed output channel count is always a multiple of it.
+ */
+#define DNN_CONV2D_BLOCK 16
+
 typedef struct ConvolutionalParams{
     int32_t input_num, output_num, kernel_size;
     DNNActivationFunc activation;
@@ -34,9 +41,70 @@ typedef struct ConvolutionalParams{
     int32_t has_bias;
     float *kernel;
     float *biases;
+
+    /**
+     * kernel reorganised at load time into panels of DNN_CONV2D_BLOCK output
+     * channels, each panel stores kernel_size * kernel_size * input_num rows
+     * of DNN_CONV2D_BLOCK contiguous weights, in the same (ky, kx, ch) order
+     * as the im2col rows built during execution.
+     * Version 2 model files store the kernel already packed, kernel is NULL then.
+     */
+    float *packed_kernel;
+    int32_t packed_output_num;
+
+    /**
+     * set when the weights and biases point into the
+     * mapping of a version 2 model file instead of being owned by the layer
+     */
+    int32_t weights_mapped;
+
+    /**
+     * layers merged into this one by the fusion pass of the native backend:
+     * fused_pad:        the input is padded on the fly as described by
+     *                   pad_params, only along the height and the width
+     * fused_maximum:    the output is FFMAX(output, maximum_value),
+     *                   after the activation
+     * fused_block_size: if not 0, the output is written in the order of a
+     *                   depth to space layer with this block size
+     */
+    int32_t fused_pad;
+    LayerPadParams pad_params;
+    int32_t fused_maximum;
+    float maximum_value;
+    int32_t fused_block_size;
 } ConvolutionalParams;
 
-int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size);
+int dnn_load_layer_conv2d(Layer *layer, NativeModelFile *model_file);
+/**
+ * Build the packed kernel, must be called once after kernel has been filled
+ * and before dnn_execute_layer_conv2d().
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+int dnn_pack_layer_conv2d(ConvolutionalParams *conv_params);
+/**
+ * Write the kernel of conv_params in model order, [n_filter][kernel_y][kernel_x][ch],
+ * to kernel, whatever the layout it has been loaded with.
+ */
+void dnn_get_kernel_conv2d(const ConvolutionalParams *conv_params, float *kernel);
+/**
+ * Free the buffers owned by conv_params, but not conv_params itself.
+ */
+void dnn_free_layer_conv2d(ConvolutionalParams *conv_params);
+/**
+ * Set the dims and data type of the output operand from the input operands,
+ * without computing the output.
+ *
+ * @return 0 on success, -1 if the input shape is not supported by the layer
+ */
+int dnn_infer_shape_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                 int32_t output_operand_index, const void *parameters);
 int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
-                             int32_t output_operand_index, const void *parameters);
+                             int32_t output_operand_index, const void *parameters, NativeContext *ctx);
+/**
+ * Get the number of arithmetic operations of the last execution of the layer,
+ * counting a multiply-add as two.
+ */
+int64_t dnn_flops_layer_conv2d(const DnnOperand *operands, const int32_t *input_operand_indexes,
+                               int32_t output_operand_index, const void *parameters);
 #endif
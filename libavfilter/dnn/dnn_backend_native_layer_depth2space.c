@@ -27,8 +27,9 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_depth2space.h"
 
-int dnn_load_layer_depth2space(Layer *layer, AVIOContext *model_file_context, int file_size)
+int dnn_load_layer_depth2space(Layer *layer, NativeModelFile *model_file)
 {
+    AVIOContext *model_file_context = model_file->pb;
     DepthToSpaceParams *params;
     int dnn_size = 0;
     params = av_malloc(sizeof(*params));
@@ -45,18 +46,21 @@ int dnn_load_layer_depth2space(Layer *layer, AVIOContext *model_file_context, in
     return dnn_size;
 }
 
-int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_operand_indexes,
-                                  int32_t output_operand_index, const void *parameters)
-{
+typedef struct ThreadData {
+    const float *input;
     float *output;
-    const DepthToSpaceParams *params = (const DepthToSpaceParams *)parameters;
-    int block_size = params->block_size;
-    int32_t input_operand_index = input_operand_indexes[0];
-    int number = operands[input_operand_index].dims[0];
-    int height = operands[input_operand_index].dims[1];
-    int width = operands[input_operand_index].dims[2];
-    int channels = operands[input_operand_index].dims[3];
-    const float *input = operands[input_operand_index].data;
+    int block_size;
+    int height, width, channels;
+} ThreadData;
+
+static void depth2space_job(void *arg, int jobnr, int nb_jobs)
+{
+    const ThreadData *td = arg;
+    int block_size = td->block_size;
+    int width = td->width;
+    int channels = td->channels;
+    int start = (td->height * jobnr) / nb_jobs;
+    int end = (td->height * (jobnr + 1)) / nb_jobs;
 
     int y, x, by, bx, ch;
     int new_channels = channels / (block_size * block_size);
@@ -64,19 +68,10 @@ int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_ope
     int by_linesize = output_linesize / block_size;
     int x_linesize = new_channels * block_size;
 
-    DnnOperand *output_operand = &operands[output_operand_index];
-    output_operand->dims[0] = number;
-    output_operand->dims[1] = height * block_size;
-    output_operand->dims[2] = width * block_size;
-    output_operand->dims[3] = new_channels;
-    output_operand->data_type = operands[input_operand_index].data_type;
-    output_operand->length = calculate_operand_data_length(output_operand);
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data)
-        return -1;
-    output = output_operand->data;
+    const float *input = td->input + start * width * channels;
+    float *output = td->output + start * output_linesize;
 
-    for (y = 0; y < height; ++y){
+    for (y = start; y < end; ++y){
         for (x = 0; x < width; ++x){
             for (by = 0; by < block_size; ++by){
                 for (bx = 0; bx < block_size; ++bx){
@@ -89,5 +84,51 @@ int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_ope
         }
         output += output_linesize;
     }
+}
+
+int dnn_infer_shape_layer_depth2space(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                      int32_t output_operand_index, const void *parameters)
+{
+    const DnnOperand *input_operand = &operands[input_operand_indexes[0]];
+    DnnOperand *output_operand = &operands[output_operand_index];
+    const DepthToSpaceParams *params = (const DepthToSpaceParams *)parameters;
+    int block_size = params->block_size;
+
+    if (block_size <= 0 || input_operand->dims[3] % (block_size * block_size))
+        return -1;
+
+    output_operand->dims[0] = input_operand->dims[0];
+    output_operand->dims[1] = input_operand->dims[1] * block_size;
+    output_operand->dims[2] = input_operand->dims[2] * block_size;
+    output_operand->dims[3] = input_operand->dims[3] / (block_size * block_size);
+    output_operand->data_type = input_operand->data_type;
+    return 0;
+}
+
+int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                  int32_t output_operand_index, const void *parameters, NativeContext *ctx)
+{
+    ThreadData td;
+    const DepthToSpaceParams *params = (const DepthToSpaceParams *)parameters;
+    int block_size = params->block_size;
+    int32_t input_operand_index = input_operand_indexes[0];
+    int height = operands[input_operand_index].dims[1];
+    int width = operands[input_operand_index].dims[2];
+    int channels = operands[input_operand_index].dims[3];
+
+    DnnOperand *output_operand = &operands[output_operand_index];
+    if (dnn_infer_shape_layer_depth2space(operands, input_operand_indexes, output_operand_index, parameters) < 0)
+        return -1;
+    if (ff_dnn_native_alloc_operand_data(output_operand) < 0)
+        return -1;
+
+    td.input = operands[input_operand_index].data;
+    td.output = output_operand->data;
+    td.block_size = block_size;
+    td.height = height;
+    td.width = width;
+    td.channels = channels;
+
+    ff_dnn_native_execute_jobs(ctx, depth2space_job, &td, ff_dnn_native_get_nb_jobs(ctx, height));
     return 0;
 }
@@ -27,8 +27,9 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_maximum.h"
 
-int dnn_load_layer_maximum(Layer *layer, AVIOContext *model_file_context, int file_size)
+int dnn_load_layer_maximum(Layer *layer, NativeModelFile *model_file)
 {
+    AVIOContext *model_file_context = model_file->pb;
     DnnLayerMaximumParams *params;
     int dnn_size = 0;
     params = av_malloc(sizeof(*params));
@@ -45,8 +46,20 @@ int dnn_load_layer_maximum(Layer *layer, AVIOContext *model_file_context, int fi
     return dnn_size;
 }
 
+int dnn_infer_shape_layer_maximum(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                  int32_t output_operand_index, const void *parameters)
+{
+    const DnnOperand *input = &operands[input_operand_indexes[0]];
+    DnnOperand *output = &operands[output_operand_index];
+
+    for (int i = 0; i < 4; ++i)
+        output->dims[i] = input->dims[i];
+    output->data_type = input->data_type;
+    return 0;
+}
+
 int dnn_execute_layer_maximum(DnnOperand *operands, const int32_t *input_operand_indexes,
-                              int32_t output_operand_index, const void *parameters)
+                              int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
     const DnnOperand *input = &operands[input_operand_indexes[0]];
     DnnOperand *output = &operands[output_operand_index];
@@ -55,13 +68,8 @@ int dnn_execute_layer_maximum(DnnOperand *operands, const int32_t *input_operand
     const float *src;
     float *dst;
 
-    for (int i = 0; i < 4; ++i)
-        output->dims[i] = input->dims[i];
-
-    output->data_type = input->data_type;
-    output->length = calculate_operand_data_length(output);
-    output->data = av_realloc(output->data, output->length);
-    if (!output->data)
+    dnn_infer_shape_layer_maximum(operands, input_operand_indexes, output_operand_index, parameters);
+    if (ff_dnn_native_alloc_operand_data(output) < 0)
         return DNN_ERROR;
 
     dims_count = calculate_operand_dims_count(output);
@@ -72,3 +80,9 @@ int dnn_execute_layer_maximum(DnnOperand *operands, const int32_t *input_operand
 
     return 0;
 }
+
+int64_t dnn_flops_layer_maximum(const DnnOperand *operands, const int32_t *input_operand_indexes,
+                                int32_t output_operand_index, const void *parameters)
+{
+    return calculate_operand_dims_count(&operands[output_operand_index]);
+}
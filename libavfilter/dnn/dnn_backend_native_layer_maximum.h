@@ -37,8 +37,18 @@ typedef struct DnnLayerMaximumParams{
     }val;
 } DnnLayerMaximumParams;
 
-int dnn_load_layer_maximum(Layer *layer, AVIOContext *model_file_context, int file_size);
+int dnn_load_layer_maximum(Layer *layer, NativeModelFile *model_file);
+/**
+ * Set the dims and data type of the output operand from the input operands,
+ * without computing the output.
+ *
+ * @return 0 on success, -1 if the input shape is not supported by the layer
+ */
+int dnn_infer_shape_layer_maximum(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                  int32_t output_operand_index, const void *parameters);
 int dnn_execute_layer_maximum(DnnOperand *operands, const int32_t *input_operand_indexes,
-                              int32_t output_operand_index, const void *parameters);
+                              int32_t output_operand_index, const void *parameters, NativeContext *ctx);
+int64_t dnn_flops_layer_maximum(const DnnOperand *operands, const int32_t *input_operand_indexes,
+                                int32_t output_operand_index, const void *parameters);
 
 #endif
@@ -22,11 +22,12 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_pad.h"
 
-int dnn_load_layer_pad(Layer *layer, AVIOContext *model_file_context, int file_size)
+int dnn_load_layer_pad(Layer *layer, NativeModelFile *model_file)
 {
+    AVIOContext *model_file_context = model_file->pb;
     LayerPadParams *params;
     int dnn_size = 0;
-    params = av_malloc(sizeof(*params));
+    params = av_mallocz(sizeof(*params));
     if (!params)
         return 0;
 
@@ -71,188 +72,133 @@ static int after_get_buddy(int given, int border, LayerPadModeParam mode)
     }
 }
 
-int dnn_execute_layer_pad(DnnOperand *operands, const int32_t *input_operand_indexes,
-                          int32_t output_operand_index, const void *parameters)
+int dnn_pad_get_src_index(int given, int before_paddings, int size, LayerPadModeParam mode)
 {
-    int32_t before_paddings;
-    int32_t after_paddings;
-    float* output;
-    const LayerPadParams *params = (const LayerPadParams *)parameters;
-
-    // suppose format is <N, H, W, C>
-    int32_t input_operand_index = input_operand_indexes[0];
-    int number = operands[input_operand_index].dims[0];
-    int height = operands[input_operand_index].dims[1];
-    int width = operands[input_operand_index].dims[2];
-    int channel = operands[input_operand_index].dims[3];
-    const float *input = operands[input_operand_index].data;
+    if (given < before_paddings) {
+        if (mode == LPMP_CONSTANT)
+            return -1;
+        return before_get_buddy(given, before_paddings, mode) - before_paddings;
+    } else if (given >= before_paddings + size) {
+        if (mode == LPMP_CONSTANT)
+            return -1;
+        return after_get_buddy(given, before_paddings + size, mode) - before_paddings;
+    }
+    return given - before_paddings;
+}
 
-    int new_number = number + params->paddings[0][0] + params->paddings[0][1];
-    int new_height = height + params->paddings[1][0] + params->paddings[1][1];
-    int new_width = width + params->paddings[2][0] + params->paddings[2][1];
-    int new_channel = channel + params->paddings[3][0] + params->paddings[3][1];
+typedef struct ThreadData {
+    const LayerPadParams *params;
+    const float *input;
+    float *output;
+    int number, height, width, channel;
+    int new_height, new_width, new_channel;
+} ThreadData;
 
-    int c_stride = channel;
-    int wc_stride = c_stride * width;
-    int hwc_stride = wc_stride * height;
+static void fill_constant(float *dst, int len, float value)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] = value;
+}
 
-    int new_c_stride = new_channel;
-    int new_wc_stride = new_c_stride * new_width;
-    int new_hwc_stride = new_wc_stride * new_height;
+/**
+ * each job fills a range of the new_number * new_height output rows,
+ * every output row is either a constant row or built from one input row
+ */
+static void pad_job(void *arg, int jobnr, int nb_jobs)
+{
+    const ThreadData *td = arg;
+    const LayerPadParams *params = td->params;
+    int nb_rows = (td->number + params->paddings[0][0] + params->paddings[0][1]) * td->new_height;
+    int start = (nb_rows * jobnr) / nb_jobs;
+    int end = (nb_rows * (jobnr + 1)) / nb_jobs;
+
+    int c_stride = td->channel;
+    int wc_stride = c_stride * td->width;
+    int hwc_stride = wc_stride * td->height;
+
+    int new_c_stride = td->new_channel;
+    int new_wc_stride = new_c_stride * td->new_width;
+
+    for (int row = start; row < end; row++) {
+        float *dst_row = td->output + row * new_wc_stride;
+        int n = dnn_pad_get_src_index(row / td->new_height, params->paddings[0][0], td->number, params->mode);
+        int h = dnn_pad_get_src_index(row % td->new_height, params->paddings[1][0], td->height, params->mode);
+        const float *src_row;
+
+        if (n < 0 || h < 0) {
+            fill_constant(dst_row, new_wc_stride, params->constant_values);
+            continue;
+        }
+        src_row = td->input + n * hwc_stride + h * wc_stride;
 
-    DnnOperand *output_operand = &operands[output_operand_index];
-    output_operand->dims[0] = new_number;
-    output_operand->dims[1] = new_height;
-    output_operand->dims[2] = new_width;
-    output_operand->dims[3] = new_channel;
-    output_operand->data_type = operands[input_operand_index].data_type;
-    output_operand->length = calculate_operand_data_length(output_operand);
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data)
-        return -1;
-    output = output_operand->data;
+        for (int new_w = 0; new_w < td->new_width; new_w++) {
+            float *dst = dst_row + new_w * new_c_stride;
+            int w = dnn_pad_get_src_index(new_w, params->paddings[2][0], td->width, params->mode);
+            const float *src;
 
-    // copy the original data
-    for (int n = 0; n < number; n++) {
-        for (int h = 0; h < height; h++) {
-            for (int w = 0; w < width; w++) {
-                const float *src = input + n * hwc_stride + h * wc_stride + w * c_stride;
-                float *dst = output + (n + params->paddings[0][0]) * new_hwc_stride
-                                    + (h + params->paddings[1][0]) * new_wc_stride
-                                    + (w + params->paddings[2][0]) * new_c_stride
-                                    + params->paddings[3][0];
-                memcpy(dst, src, channel * sizeof(float));
+            if (w < 0) {
+                fill_constant(dst, new_c_stride, params->constant_values);
+                continue;
             }
-        }
-    }
+            src = src_row + w * c_stride;
 
-    // handle the first dimension
-    before_paddings = params->paddings[0][0];
-    after_paddings = params->paddings[0][1];
-    for (int n = 0; n < before_paddings; n++) {
-        float *dst = output + n * new_hwc_stride;
-        if (params->mode == LPMP_CONSTANT) {
-            for (int i = 0; i < new_hwc_stride; i++) {
-                dst[i] = params->constant_values;
+            memcpy(dst + params->paddings[3][0], src, td->channel * sizeof(float));
+            for (int c = 0; c < params->paddings[3][0]; c++) {
+                int buddy = dnn_pad_get_src_index(c, params->paddings[3][0], td->channel, params->mode);
+                dst[c] = buddy < 0 ? params->constant_values : src[buddy];
             }
-        }
-        else {
-            int buddy = before_get_buddy(n, before_paddings, params->mode);
-            float *src = output + buddy * new_hwc_stride;
-            memcpy(dst, src, new_hwc_stride * sizeof(float));
-        }
-    }
-    for (int n = 0; n < after_paddings; n++) {
-        int given = number + before_paddings + n;
-        float *dst = output + given * new_hwc_stride;
-        if (params->mode == LPMP_CONSTANT) {
-            for (int i = 0; i < new_hwc_stride; i++) {
-                dst[i] = params->constant_values;
+            for (int c = params->paddings[3][0] + td->channel; c < td->new_channel; c++) {
+                int buddy = dnn_pad_get_src_index(c, params->paddings[3][0], td->channel, params->mode);
+                dst[c] = buddy < 0 ? params->constant_values : src[buddy];
             }
-        } else {
-            int buddy = after_get_buddy(given, number + before_paddings, params->mode);
-            float *src = output + buddy * new_hwc_stride;
-            memcpy(dst, src, new_hwc_stride * sizeof(float));
         }
     }
+}
 
-    // handle the second dimension
-    before_paddings = params->paddings[1][0];
-    after_paddings = params->paddings[1][1];
-    for (int n = 0; n < new_number; n++) {
-        float *start = output + n * new_hwc_stride;
-        for (int h = 0; h < before_paddings; h++) {
-            float *dst = start + h * new_wc_stride;
-            if (params->mode == LPMP_CONSTANT) {
-                for (int i = 0; i < new_wc_stride; i++) {
-                    dst[i] = params->constant_values;
-                }
-            } else {
-                int buddy = before_get_buddy(h, before_paddings, params->mode);
-                float *src = start + buddy * new_wc_stride;
-                memcpy(dst, src, new_wc_stride * sizeof(float));
-            }
-        }
-        for (int h = 0; h < after_paddings; h++) {
-            int given = height + before_paddings + h;
-            float *dst = start + given * new_wc_stride;
-            if (params->mode == LPMP_CONSTANT) {
-                for (int i = 0; i < new_wc_stride; i++) {
-                    dst[i] = params->constant_values;
-                }
-            } else {
-                int buddy = after_get_buddy(given, height + before_paddings, params->mode);
-                float *src = start + buddy * new_wc_stride;
-                memcpy(dst, src, new_wc_stride * sizeof(float));
-            }
-        }
-    }
+int dnn_infer_shape_layer_pad(DnnOperand *operands, const int32_t *input_operand_indexes,
+                              int32_t output_operand_index, const void *parameters)
+{
+    const DnnOperand *input_operand = &operands[input_operand_indexes[0]];
+    DnnOperand *output_operand = &operands[output_operand_index];
+    const LayerPadParams *params = (const LayerPadParams *)parameters;
 
-    // handle the third dimension
-    before_paddings = params->paddings[2][0];
-    after_paddings = params->paddings[2][1];
-    for (int n = 0; n < new_number; n++) {
-        for (int h = 0; h < new_height; h++) {
-            float *start = output + n * new_hwc_stride + h * new_wc_stride;
-            for (int w = 0; w < before_paddings; w++) {
-                float *dst = start + w * new_c_stride;
-                if (params->mode == LPMP_CONSTANT) {
-                    for (int i = 0; i < new_c_stride; i++) {
-                        dst[i] = params->constant_values;
-                    }
-                } else {
-                    int buddy = before_get_buddy(w, before_paddings, params->mode);
-                    float *src = start + buddy * new_c_stride;
-                    memcpy(dst, src, new_c_stride * sizeof(float));
-                }
-            }
-            for (int w = 0; w < after_paddings; w++) {
-                int given = width + before_paddings + w;
-                float *dst = start + given * new_c_stride;
-                if (params->mode == LPMP_CONSTANT) {
-                    for (int i = 0; i < new_c_stride; i++) {
-                        dst[i] = params->constant_values;
-                    }
-                } else {
-                    int buddy = after_get_buddy(given, width + before_paddings, params->mode);
-                    float *src = start + buddy * new_c_stride;
-                    memcpy(dst, src, new_c_stride * sizeof(float));
-                }
-            }
-        }
-    }
+    for (int i = 0; i < 4; ++i)
+        output_operand->dims[i] = input_operand->dims[i] + params->paddings[i][0] + params->paddings[i][1];
+    output_operand->data_type = input_operand->data_type;
+    return 0;
+}
 
-    // handle the fourth dimension
-    before_paddings = params->paddings[3][0];
-    after_paddings = params->paddings[3][1];
-    for (int n = 0; n < new_number; n++) {
-        for (int h = 0; h < new_height; h++) {
-            for (int w = 0; w < new_width; w++) {
-                float *start = output + n * new_hwc_stride + h * new_wc_stride + w * new_c_stride;
-                for (int c = 0; c < before_paddings; c++) {
-                    float *dst = start + c;
-                    if (params->mode == LPMP_CONSTANT) {
-                        *dst = params->constant_values;
-                    } else {
-                        int buddy = before_get_buddy(c, before_paddings, params->mode);
-                        float *src = start + buddy;
-                        *dst = *src;
-                    }
-                }
-                for (int c = 0; c < after_paddings; c++) {
-                    int given = channel + before_paddings + c;
-                    float *dst = start + given;
-                    if (params->mode == LPMP_CONSTANT) {
-                        *dst = params->constant_values;
-                    } else {
-                        int buddy = after_get_buddy(given, channel + before_paddings, params->mode);
-                        float *src = start + buddy;
-                        *dst = *src;
-                    }
-                }
-            }
-        }
-    }
+int dnn_execute_layer_pad(DnnOperand *operands, const int32_t *input_operand_indexes,
+                          int32_t output_operand_index, const void *parameters, NativeContext *ctx)
+{
+    ThreadData td;
+    const LayerPadParams *params = (const LayerPadParams *)parameters;
+
+    // suppose format is <N, H, W, C>
+    int32_t input_operand_index = input_operand_indexes[0];
+    int number = operands[input_operand_index].dims[0];
+    int height = operands[input_operand_index].dims[1];
+    int width = operands[input_operand_index].dims[2];
+    int channel = operands[input_operand_index].dims[3];
+
+    DnnOperand *output_operand = &operands[output_operand_index];
+    if (dnn_infer_shape_layer_pad(operands, input_operand_indexes, output_operand_index, parameters) < 0)
+        return -1;
+    if (ff_dnn_native_alloc_operand_data(output_operand) < 0)
+        return -1;
 
+    td.params = params;
+    td.input = operands[input_operand_index].data;
+    td.output = output_operand->data;
+    td.number = number;
+    td.height = height;
+    td.width = width;
+    td.channel = channel;
+    td.new_height = output_operand->dims[1];
+    td.new_width = output_operand->dims[2];
+    td.new_channel = output_operand->dims[3];
+
+    ff_dnn_native_execute_jobs(ctx, pad_job, &td,
+                               ff_dnn_native_get_nb_jobs(ctx, output_operand->dims[0] * output_operand->dims[1]));
     return 0;
 }
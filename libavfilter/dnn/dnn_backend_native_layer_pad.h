@@ -36,8 +36,25 @@ typedef struct LayerPadParams{
     float constant_values;
 } LayerPadParams;
 
-int dnn_load_layer_pad(Layer *layer, AVIOContext *model_file_context, int file_size);
+int dnn_load_layer_pad(Layer *layer, NativeModelFile *model_file);
+/**
+ * Map an index of a padded dimension to the index of the input it is
+ * copied from.
+ *
+ * @param before_paddings padding added before the input in this dimension
+ * @param size            size of the input in this dimension
+ * @return the input index, or -1 if given is filled with constant_values
+ */
+int dnn_pad_get_src_index(int given, int before_paddings, int size, LayerPadModeParam mode);
+/**
+ * Set the dims and data type of the output operand from the input operands,
+ * without computing the output.
+ *
+ * @return 0 on success, -1 if the input shape is not supported by the layer
+ */
+int dnn_infer_shape_layer_pad(DnnOperand *operands, const int32_t *input_operand_indexes,
+                              int32_t output_operand_index, const void *parameters);
 int dnn_execute_layer_pad(DnnOperand *operands, const int32_t *input_operand_indexes,
-                          int32_t output_operand_index, const void *parameters);
+                          int32_t output_operand_index, const void *parameters, NativeContext *ctx);
 
 #endif
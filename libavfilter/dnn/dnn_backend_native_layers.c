@@ -26,9 +26,9 @@
 #include "dnn_backend_native_layer_maximum.h"
 
 LayerFunc layer_funcs[DLT_COUNT] = {
-    {NULL, NULL},
-    {dnn_execute_layer_conv2d,      dnn_load_layer_conv2d},
-    {dnn_execute_layer_depth2space, dnn_load_layer_depth2space},
-    {dnn_execute_layer_pad,         dnn_load_layer_pad},
-    {dnn_execute_layer_maximum,     dnn_load_layer_maximum},
+    {NULL, NULL, NULL, NULL},
+    {dnn_execute_layer_conv2d,      dnn_load_layer_conv2d,      dnn_infer_shape_layer_conv2d,      dnn_flops_layer_conv2d},
+    {dnn_execute_layer_depth2space, dnn_load_layer_depth2space, dnn_infer_shape_layer_depth2space, NULL},
+    {dnn_execute_layer_pad,         dnn_load_layer_pad,         dnn_infer_shape_layer_pad,         NULL},
+    {dnn_execute_layer_maximum,     dnn_load_layer_maximum,     dnn_infer_shape_layer_maximum,     dnn_flops_layer_maximum},
 };
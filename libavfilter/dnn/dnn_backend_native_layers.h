@@ -25,12 +25,19 @@
 #include "dnn_backend_native.h"
 
 typedef int (*LAYER_EXEC_FUNC)(DnnOperand *operands, const int32_t *input_operand_indexes,
-                               int32_t output_operand_index, const void *parameters);
-typedef int (*LAYER_LOAD_FUNC)(Layer *layer, AVIOContext *model_file_context, int file_size);
+                               int32_t output_operand_index, const void *parameters, NativeContext *ctx);
+typedef int (*LAYER_LOAD_FUNC)(Layer *layer, NativeModelFile *model_file);
+typedef int (*LAYER_INFER_SHAPE_FUNC)(DnnOperand *operands, const int32_t *input_operand_indexes,
+                                      int32_t output_operand_index, const void *parameters);
+typedef int64_t (*LAYER_FLOPS_FUNC)(const DnnOperand *operands, const int32_t *input_operand_indexes,
+                                    int32_t output_operand_index, const void *parameters);
 
 typedef struct LayerFunc {
     LAYER_EXEC_FUNC pf_exec;
     LAYER_LOAD_FUNC pf_load;
+    LAYER_INFER_SHAPE_FUNC pf_infer_shape;
+    // NULL for the layers which only move data around
+    LAYER_FLOPS_FUNC pf_flops;
 }LayerFunc;
 
 extern LayerFunc layer_funcs[DLT_COUNT];
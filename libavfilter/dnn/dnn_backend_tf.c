@@ -270,7 +270,7 @@ static DNNReturnType add_conv_layer(TFModel *tf_model, TF_Operation *transpose_o
     dims[3] = params->input_num;
     dims_len = 4;
     tensor = TF_AllocateTensor(TF_FLOAT, dims, dims_len, size * sizeof(float));
-    memcpy(TF_TensorData(tensor), params->kernel, size * sizeof(float));
+    dnn_get_kernel_conv2d(params, TF_TensorData(tensor));
     TF_SetAttrTensor(op_desc, "value", tensor, tf_model->status);
     if (TF_GetCode(tf_model->status) != TF_OK){
         return DNN_ERROR;
@@ -490,7 +490,7 @@ static DNNReturnType load_native_model(TFModel *tf_model, const char *model_file
     DNNModel *native_model = NULL;
     ConvolutionalNetwork *conv_network;
 
-    native_model = ff_dnn_load_model_native(model_filename);
+    native_model = ff_dnn_load_model_native(model_filename, "threads=1&fuse=0");
     if (!native_model){
         return DNN_ERROR;
     }
@@ -572,12 +572,12 @@ static DNNReturnType load_native_model(TFModel *tf_model, const char *model_file
     return DNN_SUCCESS;
 }
 
-DNNModel *ff_dnn_load_model_tf(const char *model_filename)
+DNNModel *ff_dnn_load_model_tf(const char *model_filename, const char *options)
 {
     DNNModel *model = NULL;
     TFModel *tf_model = NULL;
 
-    model = av_malloc(sizeof(DNNModel));
+    model = av_mallocz(sizeof(DNNModel));
     if (!model){
         return NULL;
     }
@@ -0,0 +1,96 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Conversion between frame samples and the NHWC tensors of the DNN filters.
+ */
+
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "dnn_convert.h"
+
+static void u8_to_float(float *dst, const uint8_t *src, ptrdiff_t len, float scale, float offset)
+{
+    for (ptrdiff_t i = 0; i < len; i++)
+        dst[i] = src[i] * scale + offset;
+}
+
+static void u16_to_float(float *dst, const uint16_t *src, ptrdiff_t len, float scale, float offset)
+{
+    for (ptrdiff_t i = 0; i < len; i++)
+        dst[i] = src[i] * scale + offset;
+}
+
+static void float_to_u8(uint8_t *dst, const float *src, ptrdiff_t len, float scale, float offset)
+{
+    for (ptrdiff_t i = 0; i < len; i++)
+        dst[i] = lrintf(av_clipf(src[i] * scale + offset, 0.0f, 255.0f));
+}
+
+static void float_to_u16(uint16_t *dst, const float *src, ptrdiff_t len, float scale, float offset, float max)
+{
+    for (ptrdiff_t i = 0; i < len; i++)
+        dst[i] = lrintf(av_clipf(src[i] * scale + offset, 0.0f, max));
+}
+
+void ff_dnn_samples_to_tensor(void *dst, DNNDataType dt, ptrdiff_t dst_stride,
+                              const uint8_t *src, ptrdiff_t src_linesize, int depth,
+                              int nb_samples, int height, float mean, float std)
+{
+    // (sample / max - mean) / std as a single multiply-add
+    const float scale = 1.0f / (((1 << depth) - 1) * std);
+    const float offset = -mean / std;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *src_row = src + y * src_linesize;
+
+        if (dt == DNN_UINT8) {
+            av_assert1(depth == 8);
+            memcpy((uint8_t *)dst + y * dst_stride, src_row, nb_samples);
+        } else if (depth == 8) {
+            u8_to_float((float *)dst + y * dst_stride, src_row, nb_samples, scale, offset);
+        } else {
+            u16_to_float((float *)dst + y * dst_stride, (const uint16_t *)src_row, nb_samples, scale, offset);
+        }
+    }
+}
+
+void ff_dnn_tensor_to_samples(uint8_t *dst, ptrdiff_t dst_linesize, int depth,
+                              const void *src, DNNDataType dt, ptrdiff_t src_stride,
+                              int nb_samples, int height, float mean, float std)
+{
+    const float max = (1 << depth) - 1;
+    const float scale = std * max;
+    const float offset = mean * max;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *dst_row = dst + y * dst_linesize;
+
+        if (dt == DNN_UINT8) {
+            av_assert1(depth == 8);
+            memcpy(dst_row, (const uint8_t *)src + y * src_stride, nb_samples);
+        } else if (depth == 8) {
+            float_to_u8(dst_row, (const float *)src + y * src_stride, nb_samples, scale, offset);
+        } else {
+            float_to_u16((uint16_t *)dst_row, (const float *)src + y * src_stride, nb_samples, scale, offset, max);
+        }
+    }
+}
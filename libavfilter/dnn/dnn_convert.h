@@ -0,0 +1,54 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Conversion between frame samples and the NHWC tensors of the DNN filters.
+ */
+
+#ifndef AVFILTER_DNN_DNN_CONVERT_H
+#define AVFILTER_DNN_DNN_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../dnn_interface.h"
+
+/**
+ * Convert height rows of nb_samples samples into tensor rows.
+ * A float tensor holds (sample / (2^depth - 1) - mean) / std, a uint8 tensor
+ * holds the 8-bit samples unchanged.
+ *
+ * @param dst        first element of the tensor rows, of type dt
+ * @param dst_stride number of elements between two tensor rows
+ * @param src        first sample, 8-bit when depth is 8 and 16-bit otherwise
+ * @param nb_samples number of samples per row, including every component
+ *                   of packed and semi-planar formats
+ */
+void ff_dnn_samples_to_tensor(void *dst, DNNDataType dt, ptrdiff_t dst_stride,
+                              const uint8_t *src, ptrdiff_t src_linesize, int depth,
+                              int nb_samples, int height, float mean, float std);
+
+/**
+ * Convert tensor rows back into samples, inverting ff_dnn_samples_to_tensor()
+ * with rounding and clamping to the sample range.
+ */
+void ff_dnn_tensor_to_samples(uint8_t *dst, ptrdiff_t dst_linesize, int depth,
+                              const void *src, DNNDataType dt, ptrdiff_t src_stride,
+                              int nb_samples, int height, float mean, float std);
+
+#endif
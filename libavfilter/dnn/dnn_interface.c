@@ -26,6 +26,7 @@
 #include "../dnn_interface.h"
 #include "dnn_backend_native.h"
 #include "dnn_backend_tf.h"
+#include "libavutil/common.h"
 #include "libavutil/mem.h"
 
 DNNModule *ff_get_dnn_module(DNNBackendType backend_type)
@@ -42,6 +43,10 @@ DNNModule *ff_get_dnn_module(DNNBackendType backend_type)
         dnn_module->load_model = &ff_dnn_load_model_native;
         dnn_module->execute_model = &ff_dnn_execute_model_native;
         dnn_module->free_model = &ff_dnn_free_model_native;
+        dnn_module->start_request = &ff_dnn_start_request_native;
+        dnn_module->execute_model_async = &ff_dnn_execute_model_async_native;
+        dnn_module->get_async_result = &ff_dnn_get_async_result_native;
+        dnn_module->flush = &ff_dnn_flush_native;
         break;
     case DNN_TF:
     #if (CONFIG_LIBTENSORFLOW == 1)
@@ -61,3 +66,29 @@ DNNModule *ff_get_dnn_module(DNNBackendType backend_type)
 
     return dnn_module;
 }
+
+void ff_dnn_tile_layout_init(DNNTileLayout *layout, int width, int height, int tile_size, int overlap)
+{
+    layout->width      = width;
+    layout->height     = height;
+    layout->overlap    = overlap;
+    layout->tile_w     = FFMIN(tile_size, width);
+    layout->tile_h     = FFMIN(tile_size, height);
+    layout->in_w       = FFMIN(layout->tile_w + 2 * overlap, width);
+    layout->in_h       = FFMIN(layout->tile_h + 2 * overlap, height);
+    layout->nb_tiles_x = (width  + layout->tile_w - 1) / layout->tile_w;
+    layout->nb_tiles_y = (height + layout->tile_h - 1) / layout->tile_h;
+    layout->nb_tiles   = layout->nb_tiles_x * layout->nb_tiles_y;
+}
+
+void ff_dnn_get_tile(const DNNTileLayout *layout, int index, DNNTile *tile)
+{
+    tile->x    = index % layout->nb_tiles_x * layout->tile_w;
+    tile->y    = index / layout->nb_tiles_x * layout->tile_h;
+    tile->w    = FFMIN(layout->tile_w, layout->width  - tile->x);
+    tile->h    = FFMIN(layout->tile_h, layout->height - tile->y);
+    // either overlap pixels remain around the kept part, or the window
+    // touches the frame border where the model pads like for the whole frame
+    tile->in_x = av_clip(tile->x - layout->overlap, 0, layout->width  - layout->in_w);
+    tile->in_y = av_clip(tile->y - layout->overlap, 0, layout->height - layout->in_h);
+}
@@ -34,6 +34,13 @@ typedef enum {DNN_NATIVE, DNN_TF} DNNBackendType;
 
 typedef enum {DNN_FLOAT = 1, DNN_UINT8 = 4} DNNDataType;
 
+typedef enum {
+    DAST_FAIL,          // the request failed, its outputs are not set
+    DAST_EMPTY_QUEUE,   // no request has been submitted since the last result
+    DAST_NOT_READY,     // the oldest submitted request is still executing
+    DAST_SUCCESS,       // the outputs of the oldest submitted request are returned
+} DNNAsyncStatusType;
+
 typedef struct DNNData{
     void *data;
     DNNDataType dt;
@@ -49,19 +56,72 @@ typedef struct DNNModel{
     // Sets model input and output.
     // Should be called at least once before model execution.
     DNNReturnType (*set_input_output)(void *model, DNNData *input, const char *input_name, const char **output_names, uint32_t nb_output);
+    // Gets how many input pixels on each side of a pixel can change the output at its position.
+    // Optional, NULL when the backend cannot tell.
+    DNNReturnType (*get_receptive_field)(void *model, int *radius);
+    // Called on another thread with async_done_opaque each time asynchronous
+    // requests have been executed. Optional, set before the first start_request().
+    void (*async_done)(void *opaque);
+    void *async_done_opaque;
 } DNNModel;
 
 // Stores pointers to functions for loading, executing, freeing DNN models for one of the backends.
 typedef struct DNNModule{
     // Loads model and parameters from given file. Returns NULL if it is not possible.
-    DNNModel *(*load_model)(const char *model_filename);
+    // options is a list of key=value pairs separated by '&' and specific to the backend, it can be NULL.
+    DNNModel *(*load_model)(const char *model_filename, const char *options);
     // Executes model with specified input and output. Returns DNN_ERROR otherwise.
     DNNReturnType (*execute_model)(const DNNModel *model, DNNData *outputs, uint32_t nb_output);
     // Frees memory allocated for model.
     void (*free_model)(DNNModel **model);
+
+    // Asynchronous execution, optional. A model owns a fixed number of requests,
+    // set with the nireq backend config, which are executed in submission order
+    // on another thread, grouped in batches when the backend supports it.
+    // Requests must not be in flight when set_input_output or execute_model is called.
+
+    // Gets the input of a free request, input->data is to be filled before
+    // execute_model_async(). Returns DNN_ERROR when all the requests are in use,
+    // get_async_result() must then be called.
+    DNNReturnType (*start_request)(const DNNModel *model, DNNData *input);
+    // Submits the request started last, user_data is returned with its outputs.
+    DNNReturnType (*execute_model_async)(const DNNModel *model, void *user_data);
+    // Gets the outputs of the oldest submitted request, which stay valid until the
+    // next call to get_async_result() or start_request(). If wait is set, blocks
+    // until the request is executed instead of returning DAST_NOT_READY.
+    DNNAsyncStatusType (*get_async_result)(const DNNModel *model, DNNData *outputs, uint32_t nb_output,
+                                           void **user_data, int wait);
+    // Executes the submitted requests without waiting for their batch to be full.
+    DNNReturnType (*flush)(const DNNModel *model);
 } DNNModule;
 
 // Initializes DNNModule depending on chosen backend.
 DNNModule *ff_get_dnn_module(DNNBackendType backend_type);
 
+/**
+ * Split of a frame into tiles which the model processes independently.
+ * Every tile is executed on an input window of in_w x in_h pixels which
+ * extends its kept part by overlap pixels on each side, windows touching a
+ * frame border are moved inwards instead of being clipped, so all the tiles
+ * share one input size and the kept parts only depend on frame pixels.
+ */
+typedef struct DNNTileLayout {
+    int width, height;          ///< frame size, in model input pixels
+    int tile_w, tile_h;         ///< size of the kept part of a tile
+    int in_w, in_h;             ///< size of the model input of every tile
+    int overlap;
+    int nb_tiles_x, nb_tiles_y, nb_tiles;
+} DNNTileLayout;
+
+typedef struct DNNTile {
+    int x, y, w, h;             ///< kept part, in frame coordinates
+    int in_x, in_y;             ///< top left corner of the input window
+} DNNTile;
+
+// Fills layout for tiles of tile_size x tile_size kept pixels.
+void ff_dnn_tile_layout_init(DNNTileLayout *layout, int width, int height, int tile_size, int overlap);
+
+// Gets the position of the tile number index, in raster order.
+void ff_dnn_get_tile(const DNNTileLayout *layout, int index, DNNTile *tile);
+
 #endif
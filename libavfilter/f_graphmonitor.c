@@ -30,6 +30,7 @@
 #include "filters.h"
 #include "formats.h"
 #include "internal.h"
+#include "thread.h"
 #include "video.h"
 
 typedef struct GraphMonitorContext {
@@ -60,6 +61,7 @@ enum {
     MODE_FMT   = 1 << 6,
     MODE_SIZE  = 1 << 7,
     MODE_RATE  = 1 << 8,
+    MODE_PROF  = 1 << 9,
 };
 
 #define OFFSET(x) offsetof(GraphMonitorContext, x)
@@ -85,6 +87,7 @@ static const AVOption graphmonitor_options[] = {
         { "format",           NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_FMT},     0, 0, VF, "flags" },
         { "size",             NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_SIZE},    0, 0, VF, "flags" },
         { "rate",             NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_RATE},    0, 0, VF, "flags" },
+        { "profile",          NULL, 0, AV_OPT_TYPE_CONST, {.i64=MODE_PROF},    0, 0, VF, "flags" },
     { "rate", "set video rate", OFFSET(frame_rate), AV_OPT_TYPE_VIDEO_RATE, {.str = "25"}, 0, INT_MAX, VF },
     { "r",    "set video rate", OFFSET(frame_rate), AV_OPT_TYPE_VIDEO_RATE, {.str = "25"}, 0, INT_MAX, VF },
     { NULL }
@@ -173,6 +176,14 @@ static void draw_items(AVFilterContext *ctx, AVFrame *out,
 {
     GraphMonitorContext *s = ctx->priv;
     char buffer[1024] = { 0 };
+    int64_t frame_count_in, frame_count_out, current_pts_us;
+
+    /* updated by the filters of the link, which may run concurrently */
+    ff_graph_lock(ctx->graph);
+    frame_count_in  = l->frame_count_in;
+    frame_count_out = l->frame_count_out;
+    current_pts_us  = l->current_pts_us;
+    ff_graph_unlock(ctx->graph);
 
     if (s->flags & MODE_FMT) {
         if (l->type == AVMEDIA_TYPE_VIDEO) {
@@ -217,22 +228,22 @@ static void draw_items(AVFilterContext *ctx, AVFrame *out,
         xpos += strlen(buffer) * 8;
     }
     if (s->flags & MODE_FCIN) {
-        snprintf(buffer, sizeof(buffer)-1, " | in: %"PRId64, l->frame_count_in);
+        snprintf(buffer, sizeof(buffer)-1, " | in: %"PRId64, frame_count_in);
         drawtext(out, xpos, ypos, buffer, s->white);
         xpos += strlen(buffer) * 8;
     }
     if (s->flags & MODE_FCOUT) {
-        snprintf(buffer, sizeof(buffer)-1, " | out: %"PRId64, l->frame_count_out);
+        snprintf(buffer, sizeof(buffer)-1, " | out: %"PRId64, frame_count_out);
         drawtext(out, xpos, ypos, buffer, s->white);
         xpos += strlen(buffer) * 8;
     }
     if (s->flags & MODE_PTS) {
-        snprintf(buffer, sizeof(buffer)-1, " | pts: %s", av_ts2str(l->current_pts_us));
+        snprintf(buffer, sizeof(buffer)-1, " | pts: %s", av_ts2str(current_pts_us));
         drawtext(out, xpos, ypos, buffer, s->white);
         xpos += strlen(buffer) * 8;
     }
     if (s->flags & MODE_TIME) {
-        snprintf(buffer, sizeof(buffer)-1, " | time: %s", av_ts2timestr(l->current_pts_us, &AV_TIME_BASE_Q));
+        snprintf(buffer, sizeof(buffer)-1, " | time: %s", av_ts2timestr(current_pts_us, &AV_TIME_BASE_Q));
         drawtext(out, xpos, ypos, buffer, s->white);
         xpos += strlen(buffer) * 8;
     }
@@ -262,6 +273,19 @@ static int create_frame(AVFilterContext *ctx, int64_t pts)
         drawtext(out, xpos, ypos, filter->name, s->white);
         xpos += strlen(filter->name) * 8 + 10;
         drawtext(out, xpos, ypos, filter->filter->name, s->white);
+        xpos += strlen(filter->filter->name) * 8;
+        if (s->flags & MODE_PROF && !ctx->graph->profile) {
+            drawtext(out, xpos, ypos, " | profiling disabled", s->red);
+        } else if (s->flags & MODE_PROF) {
+            AVFilterProfile p;
+
+            avfilter_get_profile(filter, &p);
+            snprintf(buffer, sizeof(buffer)-1,
+                     " | activations: %"PRId64" | wall: %.1f ms | cpu: %.1f ms | alloc: %"PRId64" kB",
+                     p.nb_activations, p.wall_time / 1000.0, p.cpu_time / 1000.0,
+                     p.bytes_allocated >> 10);
+            drawtext(out, xpos, ypos, buffer, s->white);
+        }
         ypos += 10;
         for (int j = 0; j < filter->nb_inputs; j++) {
             AVFilterLink *l = filter->inputs[j];
@@ -360,6 +384,10 @@ static int config_output(AVFilterLink *outlink)
     outlink->frame_rate = s->frame_rate;
     outlink->time_base = av_inv_q(s->frame_rate);
 
+    if (s->flags & MODE_PROF && !outlink->src->graph->profile)
+        av_log(outlink->src, AV_LOG_WARNING,
+               "Profiling is disabled in the filter graph, enable its profile option to get the counters.\n");
+
     return 0;
 }
 
@@ -154,6 +154,15 @@ typedef struct SelectContext {
     ff_scene_sad_fn sad;            ///< Sum of the absolute difference function (scene detect only)
     double prev_mafd;               ///< previous MAFD                           (scene detect only)
     AVFrame *prev_picref;           ///< previous frame                          (scene detect only)
+    int scene_downscale;            ///< log2 of the thumbnail downscaling factor (scene detect only)
+    int thumb_log2_scale;           ///< scene_downscale reduced to fit the frames, 0 without thumbnails
+    int thumb_src_w, thumb_src_h;   ///< size of the frames the thumbnails are computed for
+    int thumb_step;                 ///< number of interleaved components of the thumbnails
+    int thumb_width, thumb_height;  ///< size of the thumbnails in pixels
+    ptrdiff_t thumb_linesize;
+    uint8_t *thumb[2];              ///< current and previous thumbnails of the nb_planes planes,
+                                    ///< stacked vertically                      (scene detect only)
+    int have_prev_thumb;
     double select;
     int select_out;                 ///< mark the selected output pad index
     int nb_outputs;
@@ -166,6 +175,7 @@ static const AVOption filt_name##_options[] = {                     \
     { "e",    "set an expression to use for selecting frames", OFFSET(expr_str), AV_OPT_TYPE_STRING, { .str = "1" }, .flags=FLAGS }, \
     { "outputs", "set the number of outputs", OFFSET(nb_outputs), AV_OPT_TYPE_INT, {.i64 = 1}, 1, INT_MAX, .flags=FLAGS }, \
     { "n",       "set the number of outputs", OFFSET(nb_outputs), AV_OPT_TYPE_INT, {.i64 = 1}, 1, INT_MAX, .flags=FLAGS }, \
+    { "scene_downscale", "detect scenes on thumbnails downscaled by 2^scene_downscale", OFFSET(scene_downscale), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 6, .flags=FLAGS }, \
     { NULL }                                                            \
 }
 
@@ -205,6 +215,39 @@ static av_cold int init(AVFilterContext *ctx)
 #define INTERLACE_TYPE_T 1
 #define INTERLACE_TYPE_B 2
 
+/**
+ * (Re)allocate the thumbnails for frames of size w x h, dropping the
+ * previous one. All the planes that are scored have the size of the frame.
+ */
+static int alloc_thumbnails(SelectContext *select, int w, int h)
+{
+    int log2_scale = select->scene_downscale;
+
+    av_freep(&select->thumb[0]);
+    av_freep(&select->thumb[1]);
+    select->have_prev_thumb = 0;
+    select->thumb_src_w = select->thumb_src_h = 0;
+
+    while (log2_scale && (w >> log2_scale < 1 || h >> log2_scale < 1))
+        log2_scale--;
+    if (log2_scale) {
+        select->thumb_width = w >> log2_scale;
+        select->thumb_height = h >> log2_scale;
+        select->thumb_linesize = FFALIGN(select->thumb_width * select->thumb_step << (select->bitdepth > 8), 64);
+        select->thumb[0] = av_malloc_array(select->thumb_linesize * select->thumb_height, select->nb_planes);
+        select->thumb[1] = av_malloc_array(select->thumb_linesize * select->thumb_height, select->nb_planes);
+        if (!select->thumb[0] || !select->thumb[1]) {
+            av_freep(&select->thumb[0]);
+            av_freep(&select->thumb[1]);
+            return AVERROR(ENOMEM);
+        }
+    }
+    select->thumb_log2_scale = log2_scale;
+    select->thumb_src_w = w;
+    select->thumb_src_h = h;
+    return 0;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     SelectContext *select = inlink->dst->priv;
@@ -266,21 +309,81 @@ static int config_input(AVFilterLink *inlink)
         select->sad = ff_scene_sad_get_fn(select->bitdepth == 8 ? 8 : 16);
         if (!select->sad)
             return AVERROR(EINVAL);
+
+        if (select->scene_downscale) {
+            int ret;
+
+            select->thumb_step = desc->comp[0].step >> (select->bitdepth > 8);
+            ret = alloc_thumbnails(select, inlink->w, inlink->h);
+            if (ret < 0)
+                return ret;
+        }
     }
     return 0;
 }
 
+static double get_scene_score_from_sad(SelectContext *select, uint64_t sad, uint64_t count)
+{
+    double mafd, diff;
+
+    mafd = (double)sad / count / (1ULL << (select->bitdepth - 8));
+    diff = fabs(mafd - select->prev_mafd);
+    select->prev_mafd = mafd;
+    return av_clipf(FFMIN(mafd, diff) / 100., 0, 1);
+}
+
+/* Only the thumbnail of the previous frame is kept, each frame is read once
+ * at a fraction of its rows. */
+static double get_thumbnail_scene_score(AVFilterContext *ctx, AVFrame *frame)
+{
+    SelectContext *select = ctx->priv;
+    const int depth = select->bitdepth == 8 ? 8 : 16;
+    const int height = select->thumb_height * select->nb_planes;
+    double ret = 0;
+
+    for (int plane = 0; plane < select->nb_planes; plane++)
+        ff_scene_thumbnail(select->thumb[0] + plane * select->thumb_height * select->thumb_linesize,
+                           select->thumb_linesize, frame->data[plane], frame->linesize[plane],
+                           depth, select->thumb_step,
+                           select->thumb_width, select->thumb_height, select->thumb_log2_scale);
+
+    if (select->have_prev_thumb) {
+        uint64_t sad;
+
+        select->sad(select->thumb[1], select->thumb_linesize,
+                    select->thumb[0], select->thumb_linesize,
+                    select->thumb_width * select->thumb_step, height, &sad);
+        emms_c();
+        ret = get_scene_score_from_sad(select, sad, (uint64_t)select->thumb_width * select->thumb_step * height);
+    }
+
+    FFSWAP(uint8_t *, select->thumb[0], select->thumb[1]);
+    select->have_prev_thumb = 1;
+    return ret;
+}
+
 static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
 {
     double ret = 0;
     SelectContext *select = ctx->priv;
     AVFrame *prev_picref = select->prev_picref;
 
+    if (select->scene_downscale) {
+        /* the frame size can change without the link being reconfigured */
+        if (frame->width != select->thumb_src_w || frame->height != select->thumb_src_h) {
+            av_log(ctx, AV_LOG_VERBOSE, "Frame size changed to %dx%d, restarting scene detection.\n",
+                   frame->width, frame->height);
+            if (alloc_thumbnails(select, frame->width, frame->height) < 0)
+                return 0;
+        }
+        if (select->thumb_log2_scale)
+            return get_thumbnail_scene_score(ctx, frame);
+    }
+
     if (prev_picref &&
         frame->height == prev_picref->height &&
         frame->width  == prev_picref->width) {
         uint64_t sad = 0;
-        double mafd, diff;
         uint64_t count = 0;
 
         for (int plane = 0; plane < select->nb_planes; plane++) {
@@ -293,10 +396,7 @@ static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
         }
 
         emms_c();
-        mafd = (double)sad / count / (1ULL << (select->bitdepth - 8));
-        diff = fabs(mafd - select->prev_mafd);
-        ret  = av_clipf(FFMIN(mafd, diff) / 100., 0, 1);
-        select->prev_mafd = mafd;
+        ret = get_scene_score_from_sad(select, sad, count);
         av_frame_free(&prev_picref);
     }
     select->prev_picref = av_frame_clone(frame);
@@ -445,6 +545,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     if (select->do_scene_detect) {
         av_frame_free(&select->prev_picref);
+        av_freep(&select->thumb[0]);
+        av_freep(&select->thumb[1]);
     }
 }
 
@@ -52,7 +52,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
-                                      int align)
+                                      int align,
+                                      int flags)
 {
     int i, ret;
     FFFramePool *pool;
@@ -100,6 +101,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
                                              alloc);
         if (!pool->pools[i])
             goto fail;
+        av_buffer_pool_set_flags(pool->pools[i], flags);
     }
 
     if (desc->flags & AV_PIX_FMT_FLAG_PAL ||
@@ -120,7 +122,8 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(int size),
                                       int channels,
                                       int nb_samples,
                                       enum AVSampleFormat format,
-                                      int align)
+                                      int align,
+                                      int flags)
 {
     int ret, planar;
     FFFramePool *pool;
@@ -146,6 +149,7 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(int size),
     pool->pools[0] = av_buffer_pool_init(pool->linesize[0], NULL);
     if (!pool->pools[0])
         goto fail;
+    av_buffer_pool_set_flags(pool->pools[0], flags);
 
     return pool;
 
@@ -41,13 +41,15 @@ typedef struct FFFramePool FFFramePool;
  * @param height height of each frame in this pool
  * @param format format of each frame in this pool
  * @param align buffers alignement of each frame in this pool
+ * @param flags AV_BUFFER_POOL_FLAG_* for the buffers of the frame data
  * @return newly created video frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
-                                      int align);
+                                      int align,
+                                      int flags);
 
 /**
  * Allocate and initialize an audio frame pool.
@@ -59,13 +61,15 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
  * @param nb_samples number of samples of each frame in this pool
  * @param format format of each frame in this pool
  * @param align buffers alignement of each frame in this pool
+ * @param flags AV_BUFFER_POOL_FLAG_* for the buffers of the frame data
  * @return newly created audio frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(int size),
                                       int channels,
                                       int samples,
                                       enum AVSampleFormat format,
-                                      int align);
+                                      int align,
+                                      int flags);
 
 /**
  * Deallocate the frame pool. It is safe to call this function while
@@ -137,11 +137,21 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+    void *executor;
     FFFrameQueueGlobal frame_queues;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    /**
+     * Profiling counters, updated while AVFilterGraph.profile is set,
+     * under ff_graph_lock().
+     */
+    int64_t nb_activations;
+    int64_t wall_time;
+    int64_t cpu_time;
+    int64_t bytes_allocated;
 };
 
 /**
@@ -353,6 +363,12 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name);
 
 int ff_filter_activate(AVFilterContext *filter);
 
+/**
+ * Add the size of a frame obtained by a filter for one of its outputs to
+ * its profiling counters, if enabled.
+ */
+void ff_filter_profile_alloc(AVFilterContext *filter, const AVFrame *frame);
+
 /**
  * Remove a filter from a graph;
  */
@@ -23,6 +23,7 @@
 
 #include "config.h"
 
+#include "libavutil/avassert.h"
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
@@ -114,3 +115,182 @@ void ff_graph_thread_free(AVFilterGraph *graph)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
 }
+
+/* The executor runs the filters of a round as jobs of the slice threads of
+ * the graph, so that the graph never uses more than nb_threads threads. */
+typedef struct GraphExecutor {
+    int nb_threads;
+
+    /* state shared between concurrently activated filters */
+    AVMutex lock;
+    /* the slice threading is not reentrant, set while it is in use */
+    int execute_busy;
+    avfilter_execute_func *execute;
+
+    /* filters activated in the current round and their return values */
+    AVFilterContext **filters;
+    int *rets;
+    unsigned nb_filters_allocated;
+} GraphExecutor;
+
+static int activate_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    GraphExecutor *e = arg;
+    return ff_filter_activate(e->filters[jobnr]);
+}
+
+static int executor_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                            void *arg, int *ret, int nb_jobs)
+{
+    GraphExecutor *e = ctx->graph->internal->executor;
+    int i, r, busy;
+
+    ff_mutex_lock(&e->lock);
+    busy = e->execute_busy;
+    e->execute_busy = 1;
+    ff_mutex_unlock(&e->lock);
+
+    /* the slice threads are running the filters of the current round, run
+     * the jobs on the calling thread */
+    if (busy) {
+        for (i = 0; i < nb_jobs; i++) {
+            r = func(ctx, arg, i, nb_jobs);
+            if (ret)
+                ret[i] = r;
+        }
+        return 0;
+    }
+    r = e->execute(ctx, func, arg, ret, nb_jobs);
+
+    ff_mutex_lock(&e->lock);
+    e->execute_busy = 0;
+    ff_mutex_unlock(&e->lock);
+    return r;
+}
+
+int ff_graph_executor_init(AVFilterGraph *graph)
+{
+    GraphExecutor *e;
+    int nb_threads = graph->nb_threads > 0 ? graph->nb_threads : av_cpu_count();
+
+    if (nb_threads <= 1 || !graph->internal->thread_execute) {
+        graph->thread_type &= ~AVFILTER_THREAD_GRAPH;
+        return 0;
+    }
+
+    e = av_mallocz(sizeof(*e));
+    if (!e)
+        return AVERROR(ENOMEM);
+
+    e->nb_threads = nb_threads;
+    ff_mutex_init(&e->lock, NULL);
+    e->execute = graph->internal->thread_execute;
+    graph->internal->thread_execute = executor_execute;
+
+    graph->internal->executor = e;
+    return 0;
+}
+
+void ff_graph_executor_free(AVFilterGraph *graph)
+{
+    GraphExecutor *e = graph->internal->executor;
+
+    if (!e)
+        return;
+    ff_mutex_destroy(&e->lock);
+    av_freep(&e->filters);
+    av_freep(&e->rets);
+    av_freep(&graph->internal->executor);
+}
+
+static int filters_linked(const AVFilterContext *a, const AVFilterContext *b)
+{
+    unsigned i;
+
+    if (a == b)
+        return 1;
+    for (i = 0; i < a->nb_inputs; i++)
+        if (a->inputs[i] && a->inputs[i]->src == b)
+            return 1;
+    for (i = 0; i < a->nb_outputs; i++)
+        if (a->outputs[i] && a->outputs[i]->dst == b)
+            return 1;
+    return 0;
+}
+
+int ff_graph_executor_run_once(AVFilterGraph *graph)
+{
+    GraphExecutor *e = graph->internal->executor;
+    unsigned i, j, nb_filters = 0;
+    int busy;
+
+    if (e->nb_filters_allocated < graph->nb_filters) {
+        unsigned size = graph->nb_filters;
+        if (av_reallocp_array(&e->filters, size, sizeof(*e->filters)) < 0 ||
+            av_reallocp_array(&e->rets,    size, sizeof(*e->rets))    < 0) {
+            e->nb_filters_allocated = 0;
+            return AVERROR(ENOMEM);
+        }
+        e->nb_filters_allocated = size;
+    }
+
+    /* Pick the ready filters by decreasing readiness, in graph order for the
+     * same readiness like ff_filter_graph_run_once(). The picked filters do
+     * not share any link, so the outcome of a round does not depend on the
+     * order in which the threads run them. */
+    while (nb_filters < e->nb_threads) {
+        AVFilterContext *best = NULL;
+
+        for (i = 0; i < graph->nb_filters; i++) {
+            AVFilterContext *filter = graph->filters[i];
+
+            if (!filter->ready || (best && filter->ready <= best->ready))
+                continue;
+            for (j = 0; j < nb_filters; j++)
+                if (filters_linked(filter, e->filters[j]))
+                    break;
+            if (j == nb_filters)
+                best = filter;
+        }
+        if (!best)
+            break;
+        e->filters[nb_filters++] = best;
+    }
+
+    if (!nb_filters)
+        return AVERROR(EAGAIN);
+    if (nb_filters == 1)
+        return ff_filter_activate(e->filters[0]);
+
+    ff_mutex_lock(&e->lock);
+    busy = e->execute_busy;
+    e->execute_busy = 1;
+    ff_mutex_unlock(&e->lock);
+    /* only the activated filters could be using the slice threads */
+    av_assert0(!busy);
+
+    e->execute(e->filters[0], activate_job, e, e->rets, nb_filters);
+
+    ff_mutex_lock(&e->lock);
+    e->execute_busy = 0;
+    ff_mutex_unlock(&e->lock);
+
+    for (i = 0; i < nb_filters; i++)
+        if (e->rets[i] < 0)
+            return e->rets[i];
+    return 0;
+}
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+    GraphExecutor *e = graph ? graph->internal->executor : NULL;
+    if (e)
+        ff_mutex_lock(&e->lock);
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+    GraphExecutor *e = graph ? graph->internal->executor : NULL;
+    if (e)
+        ff_mutex_unlock(&e->lock);
+}
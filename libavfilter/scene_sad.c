@@ -56,6 +56,40 @@ void ff_scene_sad_c(SCENE_SAD_PARAMS)
     *sum = sad;
 }
 
+#define THUMBNAIL_ROW(type)                                                     \
+    do {                                                                        \
+        const type *srcp = (const type *)src;                                   \
+        type *dstp = (type *)dst;                                               \
+                                                                                \
+        for (int x = 0; x < width; x++) {                                       \
+            for (int c = 0; c < step; c++) {                                    \
+                unsigned sum = 0;                                               \
+                for (int i = 0; i < scale; i++)                                 \
+                    sum += srcp[i * step + c];                                  \
+                dstp[c] = (sum + (scale >> 1)) >> log2_scale;                   \
+            }                                                                   \
+            srcp += scale * step;                                               \
+            dstp += step;                                                       \
+        }                                                                       \
+    } while (0)
+
+void ff_scene_thumbnail(uint8_t *dst, ptrdiff_t dst_linesize,
+                        const uint8_t *src, ptrdiff_t src_linesize,
+                        int depth, int step, int width, int height, int log2_scale)
+{
+    const int scale = 1 << log2_scale;
+
+    src += (scale >> 1) * src_linesize;
+    for (int y = 0; y < height; y++) {
+        if (depth == 8)
+            THUMBNAIL_ROW(uint8_t);
+        else
+            THUMBNAIL_ROW(uint16_t);
+        src += scale * src_linesize;
+        dst += dst_linesize;
+    }
+}
+
 ff_scene_sad_fn ff_scene_sad_get_fn(int depth)
 {
     ff_scene_sad_fn sad = NULL;
@@ -41,4 +41,20 @@ ff_scene_sad_fn ff_scene_sad_get_fn_x86(int depth);
 
 ff_scene_sad_fn ff_scene_sad_get_fn(int depth);
 
+/**
+ * Compute a low resolution thumbnail of a plane for scene detection.
+ * Each sample of the thumbnail is the rounded mean of the 1 << log2_scale
+ * samples of the middle row of its block, so that only one row of every
+ * block is read.
+ *
+ * @param depth      8 for 8-bit samples, 16 for 16-bit samples
+ * @param step       number of interleaved components of the plane
+ * @param width      width of the thumbnail in pixels
+ * @param height     height of the thumbnail
+ * @param log2_scale log2 of the downscaling factor in each dimension
+ */
+void ff_scene_thumbnail(uint8_t *dst, ptrdiff_t dst_linesize,
+                        const uint8_t *src, ptrdiff_t src_linesize,
+                        int depth, int step, int width, int height, int log2_scale);
+
 #endif /* AVFILTER_SCENE_SAD_H */
@@ -45,6 +45,13 @@ enum lookup_mode {
     NB_LOOKUP_MODE
 };
 
+enum index_mode {
+    INDEX_OFF,
+    INDEX_ADD,
+    INDEX_QUERY,
+    NB_INDEX_MODES
+};
+
 enum formats {
     FORMAT_BINARY,
     FORMAT_XML,
@@ -122,6 +129,10 @@ typedef struct StreamContext {
     uint32_t lastindex; /* helper to store amount of frames */
 
     int exported; /* boolean whether stream already exported */
+
+    /* row sums of the pixels of each block row, one buffer per job */
+    uint16_t* row_acc;
+    int nb_jobs;
 } StreamContext;
 
 typedef struct SignatureContext {
@@ -135,9 +146,14 @@ typedef struct SignatureContext {
     int thcomposdist;
     int thl1;
     int thdi;
-    int thit;
+    double thit;
+    char *index;
+    int index_mode;
+    char *index_label;
     /* end input parameters */
 
+    int index_done; /* boolean whether the index was already used */
+
     uint8_t l1distlut[243*242/2]; /* 243 + 242 + 241 ... */
     StreamContext* streamcontexts;
 } SignatureContext;
@@ -0,0 +1,806 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * On-disk index of MPEG-7 video signatures
+ *
+ * The index stores the fine signatures of every video added to it (an entry)
+ * and an inverted index from hashes of the coarse signatures to the segments
+ * of the entries having them, so a video is only compared with the segments
+ * it probably matches instead of with every segment of every entry.
+ *
+ * The hashes are locality sensitive: each of the 5 bags of words of a coarse
+ * signature is hashed with MinHash, i.e. the words are permuted by
+ * NB_MINHASH permutations and the smallest permuted word of the bag is kept
+ * for each permutation. Two bags have the same minhash with a probability
+ * equal to their jaccard similarity. The minhashes are grouped by pairs, and
+ * each pair of each bag gives one key, so two segments are candidates when
+ * any bag of one has the same pair of minhashes as the same bag of the other.
+ * The candidates are then compared by the usual stages of the lookup.
+ *
+ * A segment of an entry is the coarse signature starting at its frame
+ * 45 * segment, covering up to 90 frames.
+ *
+ * The file is only appended to: each addition writes its entries and a table
+ * of the postings of their segments at the end, then rewrites the header to
+ * point to this table, which links to the table of the previous addition. A
+ * lookup searches every table. Once INDEX_MAX_TABLES tables are chained, the
+ * next addition merges them, rewriting the whole index with a single table.
+ * A table holds at most INDEX_MAX_POSTINGS postings, i.e. about 600 million
+ * frames, and an addition exceeding it fails. Tables which would exceed it
+ * once merged are kept apart.
+ *
+ * All numbers are little-endian:
+ *
+ *  header:    "FFSIGIDX", version (32), number of entries (32),
+ *             number of tables (32), offset of the last table (64)
+ *  entry:     label length (32), label, time base (2 x 32),
+ *             number of frames (32), and for each frame pts (64),
+ *             confidence (8), words (5 x 8) and frame signature (76 x 8)
+ *  table:     offset of the previous table or 0 (64), first entry (32),
+ *             number of entries (32), offset of each entry (64),
+ *             number of buckets (32), number of postings (32),
+ *             index of the first posting of each bucket and of the end (32),
+ *             postings: key (32), entry (32), segment (32), sorted by bucket
+ */
+
+#include "libavformat/avio.h"
+#include "libavutil/intreadwrite.h"
+#include "signature.h"
+
+#define INDEX_MAGIC "FFSIGIDX"
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 28
+#define INDEX_POSTING_SIZE 12
+#define INDEX_FRAME_SIZE (8 + 1 + 5 + 76)
+#define INDEX_MAX_TABLES 16
+#define INDEX_MAX_POSTINGS (INT_MAX / sizeof(IndexPosting))
+
+#define NB_MINHASH 4
+#define NB_KEYS (5 * NB_MINHASH / 2)
+
+/* permutations w -> (a * w + b) % 251 of the 243 words, 251 being prime */
+static const uint8_t minhash_coeffs[NB_MINHASH][2] = {
+    { 37, 11 }, { 101, 59 }, { 173, 3 }, { 229, 131 },
+};
+
+typedef struct IndexPosting {
+    uint32_t key;
+    uint32_t entry;
+    uint32_t segment;
+    uint32_t bucket; /* not stored */
+} IndexPosting;
+
+typedef struct IndexCandidate {
+    uint32_t entry;
+    uint32_t segment;
+    uint32_t query_segment;
+    CoarseSignature *cs;
+} IndexCandidate;
+
+typedef struct IndexTable {
+    uint32_t first_entry;
+    uint32_t nb_entries;
+    uint32_t nb_buckets;
+    uint32_t nb_postings;
+    int64_t dir_offset;     /* offset of the entry offsets */
+    int64_t bucket_offset;
+} IndexTable;
+
+typedef struct SignatureIndex {
+    AVIOContext *pb;
+    uint32_t nb_entries;
+    uint32_t nb_tables;
+    int64_t last_table;
+    IndexTable *tables;     /* from the oldest to the last one */
+} SignatureIndex;
+
+typedef struct IndexEntry {
+    char *label;
+    AVRational time_base;
+    uint32_t nb_frames;
+    FineSignature *frames;
+} IndexEntry;
+
+static void get_index_keys(const CoarseSignature *cs, uint32_t keys[NB_KEYS])
+{
+    int i, j, w;
+
+    for (i = 0; i < 5; i++) {
+        uint8_t minhash[NB_MINHASH];
+
+        memset(minhash, 0xFF, sizeof(minhash));
+        for (w = 0; w < 243; w++) {
+            if (!(cs->data[i][w >> 3] & (0x80 >> (w & 7))))
+                continue;
+            for (j = 0; j < NB_MINHASH; j++)
+                minhash[j] = FFMIN(minhash[j], (minhash_coeffs[j][0] * w + minhash_coeffs[j][1]) % 251);
+        }
+        for (j = 0; j < NB_MINHASH / 2; j++)
+            keys[i * NB_MINHASH / 2 + j] = (i * NB_MINHASH / 2 + j) << 16 | minhash[2*j] << 8 | minhash[2*j + 1];
+    }
+}
+
+static uint32_t get_bucket(uint32_t key, uint32_t nb_buckets)
+{
+    uint32_t h = key * 0x9E3779B1U;
+    return (h ^ h >> 15) & (nb_buckets - 1);
+}
+
+static void index_write_header(AVIOContext *pb, uint32_t nb_entries, uint32_t nb_tables, int64_t last_table)
+{
+    avio_write(pb, INDEX_MAGIC, 8);
+    avio_wl32(pb, INDEX_VERSION);
+    avio_wl32(pb, nb_entries);
+    avio_wl32(pb, nb_tables);
+    avio_wl64(pb, last_table);
+}
+
+static int cmp_postings(const void *a, const void *b)
+{
+    const IndexPosting *pa = a, *pb = b;
+    if (pa->bucket != pb->bucket)
+        return pa->bucket < pb->bucket ? -1 : 1;
+    if (pa->key != pb->key)
+        return pa->key < pb->key ? -1 : 1;
+    if (pa->entry != pb->entry)
+        return pa->entry < pb->entry ? -1 : 1;
+    return pa->segment < pb->segment ? -1 : pa->segment > pb->segment;
+}
+
+static int cmp_candidates(const void *a, const void *b)
+{
+    const IndexCandidate *ca = a, *cb = b;
+    if (ca->entry != cb->entry)
+        return ca->entry < cb->entry ? -1 : 1;
+    if (ca->segment != cb->segment)
+        return ca->segment < cb->segment ? -1 : 1;
+    return ca->query_segment < cb->query_segment ? -1 : ca->query_segment > cb->query_segment;
+}
+
+static void index_close(SignatureIndex *idx)
+{
+    avio_closep(&idx->pb);
+    av_freep(&idx->tables);
+}
+
+/**
+ * Read the table at offset, and return the offset of the previous one.
+ */
+static int64_t index_read_table(SignatureIndex *idx, int64_t offset, IndexTable *table)
+{
+    AVIOContext *pb = idx->pb;
+    int64_t prev;
+
+    avio_seek(pb, offset, SEEK_SET);
+    prev = avio_rl64(pb);
+    table->first_entry = avio_rl32(pb);
+    table->nb_entries  = avio_rl32(pb);
+    table->dir_offset  = offset + 16;
+    avio_seek(pb, table->dir_offset + 8LL * table->nb_entries, SEEK_SET);
+    table->nb_buckets  = avio_rl32(pb);
+    table->nb_postings = avio_rl32(pb);
+    table->bucket_offset = avio_tell(pb);
+    if (pb->eof_reached || prev < 0 || prev >= offset ||
+        !table->nb_buckets || table->nb_buckets & (table->nb_buckets - 1))
+        return AVERROR_INVALIDDATA;
+
+    return prev;
+}
+
+static int index_open(AVFilterContext *ctx, SignatureIndex *idx, const char *filename)
+{
+    uint8_t magic[8];
+    uint32_t nb_entries = 0, t;
+    int64_t offset;
+    int ret;
+
+    memset(idx, 0, sizeof(*idx));
+    if ((ret = avio_open(&idx->pb, filename, AVIO_FLAG_READ)) < 0)
+        return ret;
+
+    avio_read(idx->pb, magic, sizeof(magic));
+    if (memcmp(magic, INDEX_MAGIC, sizeof(magic)) || avio_rl32(idx->pb) != INDEX_VERSION) {
+        av_log(ctx, AV_LOG_ERROR, "%s is not a signature index\n", filename);
+        index_close(idx);
+        return AVERROR_INVALIDDATA;
+    }
+    idx->nb_entries = avio_rl32(idx->pb);
+    idx->nb_tables  = avio_rl32(idx->pb);
+    idx->last_table = avio_rl64(idx->pb);
+    if (idx->pb->eof_reached || !idx->nb_tables)
+        goto fail;
+
+    idx->tables = av_malloc_array(idx->nb_tables, sizeof(*idx->tables));
+    if (!idx->tables) {
+        index_close(idx);
+        return AVERROR(ENOMEM);
+    }
+    /* the tables are linked from the last one */
+    offset = idx->last_table;
+    for (t = idx->nb_tables; t > 0; t--) {
+        if (!offset)
+            goto fail;
+        offset = index_read_table(idx, offset, &idx->tables[t - 1]);
+        if (offset < 0)
+            goto fail;
+    }
+    for (t = 0; t < idx->nb_tables; t++) {
+        if (idx->tables[t].first_entry != nb_entries)
+            goto fail;
+        nb_entries += idx->tables[t].nb_entries;
+    }
+    if (offset || nb_entries != idx->nb_entries)
+        goto fail;
+
+    return 0;
+
+fail:
+    av_log(ctx, AV_LOG_ERROR, "invalid signature index %s\n", filename);
+    index_close(idx);
+    return AVERROR_INVALIDDATA;
+}
+
+/**
+ * Append the postings of the key in table to the candidates of the query
+ * segment.
+ */
+static int index_find(SignatureIndex *idx, const IndexTable *table, uint32_t key,
+                      CoarseSignature *cs, uint32_t query_segment,
+                      IndexCandidate **candidates, unsigned int *candidates_size, int *nb_candidates)
+{
+    uint32_t bucket = get_bucket(key, table->nb_buckets);
+    uint32_t start, end;
+
+    avio_seek(idx->pb, table->bucket_offset + 4 * bucket, SEEK_SET);
+    start = avio_rl32(idx->pb);
+    end   = avio_rl32(idx->pb);
+    if (start > end || end > table->nb_postings)
+        return AVERROR_INVALIDDATA;
+
+    avio_seek(idx->pb, table->bucket_offset + 4 * (table->nb_buckets + 1LL) +
+              (int64_t)INDEX_POSTING_SIZE * start, SEEK_SET);
+    for (; start < end; start++) {
+        IndexCandidate *c;
+        uint32_t posting_key = avio_rl32(idx->pb);
+        uint32_t entry       = avio_rl32(idx->pb);
+        uint32_t segment     = avio_rl32(idx->pb);
+
+        if (posting_key != key)
+            continue;
+        c = av_fast_realloc(*candidates, candidates_size, (*nb_candidates + 1) * sizeof(**candidates));
+        if (!c)
+            return AVERROR(ENOMEM);
+        *candidates = c;
+        c += (*nb_candidates)++;
+        c->entry = entry;
+        c->segment = segment;
+        c->query_segment = query_segment;
+        c->cs = cs;
+    }
+
+    return idx->pb->eof_reached ? AVERROR_INVALIDDATA : 0;
+}
+
+static void index_free_entry(IndexEntry *entry)
+{
+    av_freep(&entry->label);
+    av_freep(&entry->frames);
+}
+
+/**
+ * Get the offset of the entry number n.
+ */
+static int64_t index_get_entry_offset(SignatureIndex *idx, uint32_t n)
+{
+    const IndexTable *table = NULL;
+    int64_t offset;
+    uint32_t t;
+
+    for (t = 0; t < idx->nb_tables; t++) {
+        if (n - idx->tables[t].first_entry < idx->tables[t].nb_entries) {
+            table = &idx->tables[t];
+            break;
+        }
+    }
+    if (!table)
+        return AVERROR_INVALIDDATA;
+
+    avio_seek(idx->pb, table->dir_offset + 8LL * (n - table->first_entry), SEEK_SET);
+    offset = avio_rl64(idx->pb);
+    return idx->pb->eof_reached || offset < INDEX_HEADER_SIZE ? AVERROR_INVALIDDATA : offset;
+}
+
+static int index_read_entry(SignatureIndex *idx, uint32_t n, IndexEntry *entry)
+{
+    AVIOContext *pb = idx->pb;
+    uint32_t label_len, i;
+    int64_t offset = index_get_entry_offset(idx, n);
+
+    memset(entry, 0, sizeof(*entry));
+    if (offset < 0)
+        return offset;
+    avio_seek(pb, offset, SEEK_SET);
+
+    label_len = avio_rl32(pb);
+    if (label_len > 4096)
+        return AVERROR_INVALIDDATA;
+    entry->label = av_mallocz(label_len + 1);
+    if (!entry->label)
+        return AVERROR(ENOMEM);
+    avio_read(pb, (unsigned char *)entry->label, label_len);
+    entry->time_base.num = avio_rl32(pb);
+    entry->time_base.den = avio_rl32(pb);
+    entry->nb_frames = avio_rl32(pb);
+    if (!entry->nb_frames || !entry->time_base.den || pb->eof_reached)
+        goto fail;
+
+    entry->frames = av_calloc(entry->nb_frames, sizeof(*entry->frames));
+    if (!entry->frames) {
+        index_free_entry(entry);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < entry->nb_frames; i++) {
+        FineSignature *fs = &entry->frames[i];
+
+        fs->prev = i > 0 ? &entry->frames[i - 1] : NULL;
+        fs->next = i + 1 < entry->nb_frames ? &entry->frames[i + 1] : NULL;
+        fs->index = i;
+        fs->pts = avio_rl64(pb);
+        fs->confidence = avio_r8(pb);
+        avio_read(pb, fs->words, sizeof(fs->words));
+        avio_read(pb, fs->framesig, sizeof(fs->framesig));
+    }
+    if (pb->eof_reached)
+        goto fail;
+
+    return 0;
+
+fail:
+    index_free_entry(entry);
+    return AVERROR_INVALIDDATA;
+}
+
+/**
+ * Rebuild the coarse signature of a segment of an entry.
+ */
+static void get_entry_segment(const IndexEntry *entry, uint32_t segment, CoarseSignature *cs)
+{
+    uint32_t i, end = FFMIN(45 * segment + 90, entry->nb_frames);
+    int j;
+
+    memset(cs, 0, sizeof(*cs));
+    cs->first = &entry->frames[45 * segment];
+    cs->last = &entry->frames[end - 1];
+    for (i = 45 * segment; i < end; i++) {
+        for (j = 0; j < 5; j++) {
+            uint8_t w = entry->frames[i].words[j];
+            cs->data[j][w >> 3] |= 0x80 >> (w & 7);
+        }
+    }
+}
+
+/**
+ * Look up the signature of one input in the index and log the best match
+ * with each entry.
+ */
+static int index_lookup(AVFilterContext *ctx, SignatureContext *sic, SignatureIndex *idx,
+                        StreamContext *sc, int input)
+{
+    IndexCandidate *candidates = NULL;
+    unsigned int candidates_size = 0;
+    int nb_candidates = 0, nb_matches = 0, i, k, ret = 0;
+    uint32_t segment = 0, t;
+    CoarseSignature *cs;
+
+    /* stage 1: coarse signatures with a common key */
+    for (cs = sc->coarsesiglist; cs; cs = cs->next, segment++) {
+        uint32_t keys[NB_KEYS];
+
+        get_index_keys(cs, keys);
+        for (t = 0; t < idx->nb_tables; t++) {
+            for (k = 0; k < NB_KEYS; k++) {
+                ret = index_find(idx, &idx->tables[t], keys[k], cs, segment,
+                                 &candidates, &candidates_size, &nb_candidates);
+                if (ret < 0)
+                    goto end;
+            }
+        }
+    }
+    av_log(ctx, AV_LOG_DEBUG, "Stage 1: %d candidate segments in the index\n", nb_candidates);
+    if (nb_candidates)
+        qsort(candidates, nb_candidates, sizeof(*candidates), cmp_candidates);
+
+    for (i = 0; i < nb_candidates;) {
+        MatchingInfo bestmatch = { .score = 0, .meandist = 99999, .whole = 0 };
+        uint32_t n = candidates[i].entry;
+        IndexEntry entry;
+
+        if ((ret = index_read_entry(idx, n, &entry)) < 0)
+            goto end;
+
+        for (; i < nb_candidates && candidates[i].entry == n; i++) {
+            const IndexCandidate *c = &candidates[i];
+            CoarseSignature refcs;
+            MatchingInfo *infos;
+
+            /* several keys can give the same pair */
+            if (i > 0 && !cmp_candidates(c, c - 1))
+                continue;
+            if (bestmatch.whole || c->segment >= (entry.nb_frames + 44) / 45)
+                continue;
+
+            get_entry_segment(&entry, c->segment, &refcs);
+            if (!get_jaccarddist(sic, c->cs, &refcs))
+                continue;
+            /* stage 2 and 3 */
+            infos = get_matching_parameters(ctx, sic, c->cs->first, refcs.first);
+            if (infos) {
+                bestmatch = evaluate_parameters(ctx, sic, infos, bestmatch, sic->mode);
+                sll_free(infos);
+            }
+        }
+
+        if (bestmatch.score != 0) {
+            av_log(ctx, AV_LOG_INFO, "matching of video %d at %f and index entry %"PRIu32" (%s) at %f, %d frames matching\n",
+                   input, ((double) bestmatch.first->pts * sc->time_base.num) / sc->time_base.den,
+                   n, entry.label, ((double) bestmatch.second->pts * entry.time_base.num) / entry.time_base.den,
+                   bestmatch.matchframes);
+            if (bestmatch.whole)
+                av_log(ctx, AV_LOG_INFO, "whole video matching\n");
+            nb_matches++;
+        }
+        index_free_entry(&entry);
+    }
+
+    if (!nb_matches)
+        av_log(ctx, AV_LOG_INFO, "no matching of video %d in the index\n", input);
+
+end:
+    av_freep(&candidates);
+    if (ret == AVERROR_INVALIDDATA)
+        av_log(ctx, AV_LOG_ERROR, "invalid signature index %s\n", sic->index);
+    return ret;
+}
+
+static void index_write_entry(AVIOContext *pb, const StreamContext *sc, const char *label)
+{
+    FineSignature *fs;
+
+    avio_wl32(pb, strlen(label));
+    avio_write(pb, label, strlen(label));
+    avio_wl32(pb, sc->time_base.num);
+    avio_wl32(pb, sc->time_base.den);
+    avio_wl32(pb, sc->lastindex);
+    for (fs = sc->finesiglist; fs; fs = fs->next) {
+        avio_wl64(pb, fs->pts);
+        avio_w8(pb, fs->confidence);
+        avio_write(pb, fs->words, sizeof(fs->words));
+        avio_write(pb, fs->framesig, sizeof(fs->framesig));
+    }
+}
+
+static uint32_t get_nb_segments(const StreamContext *sc)
+{
+    return (sc->lastindex + 44) / 45;
+}
+
+/**
+ * Copy size bytes from the current position of in to out.
+ */
+static int index_copy(AVIOContext *out, AVIOContext *in, int64_t size)
+{
+    uint8_t buf[4096];
+
+    while (size > 0) {
+        int ret = avio_read(in, buf, FFMIN(size, sizeof(buf)));
+        if (ret <= 0)
+            return AVERROR_INVALIDDATA;
+        avio_write(out, buf, ret);
+        size -= ret;
+    }
+    return 0;
+}
+
+/**
+ * Write the signatures of all inputs as the entries numbered from
+ * first_entry, storing their offsets and appending their postings.
+ */
+static int index_write_entries(SignatureContext *sic, AVIOContext *pb, uint32_t first_entry,
+                               int64_t *offsets, IndexPosting *postings, uint32_t *nb_postings)
+{
+    int i;
+
+    for (i = 0; i < sic->nb_inputs; i++) {
+        StreamContext *sc = &sic->streamcontexts[i];
+        uint32_t segment = 0;
+        CoarseSignature *cs;
+        char *label;
+
+        if (sic->nb_inputs > 1)
+            label = av_asprintf("%s%s%d", sic->index_label, *sic->index_label ? ":" : "", i);
+        else
+            label = av_strdup(sic->index_label);
+        if (!label)
+            return AVERROR(ENOMEM);
+        offsets[i] = avio_tell(pb);
+        index_write_entry(pb, sc, label);
+        av_freep(&label);
+
+        for (cs = sc->coarsesiglist; cs && segment < get_nb_segments(sc); cs = cs->next, segment++) {
+            uint32_t keys[NB_KEYS];
+            int k;
+
+            get_index_keys(cs, keys);
+            for (k = 0; k < NB_KEYS; k++) {
+                postings[*nb_postings].key = keys[k];
+                postings[*nb_postings].entry = first_entry + i;
+                postings[*nb_postings].segment = segment;
+                (*nb_postings)++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Write the table of the entries first_entry to first_entry + nb_entries - 1,
+ * and return its offset.
+ */
+static int64_t index_write_table(AVIOContext *pb, int64_t prev, uint32_t first_entry, uint32_t nb_entries,
+                                 const int64_t *offsets, IndexPosting *postings, uint32_t nb_postings)
+{
+    int64_t offset = avio_tell(pb);
+    uint32_t nb_buckets, i, b;
+
+    /* about 4 postings per bucket */
+    nb_buckets = 64;
+    while (nb_buckets < nb_postings / 4 && nb_buckets < 1U << 30)
+        nb_buckets <<= 1;
+    for (i = 0; i < nb_postings; i++)
+        postings[i].bucket = get_bucket(postings[i].key, nb_buckets);
+    if (nb_postings)
+        qsort(postings, nb_postings, sizeof(*postings), cmp_postings);
+
+    avio_wl64(pb, prev);
+    avio_wl32(pb, first_entry);
+    avio_wl32(pb, nb_entries);
+    for (i = 0; i < nb_entries; i++)
+        avio_wl64(pb, offsets[i]);
+    avio_wl32(pb, nb_buckets);
+    avio_wl32(pb, nb_postings);
+    for (b = 0, i = 0; b <= nb_buckets; b++) {
+        while (i < nb_postings && postings[i].bucket < b)
+            i++;
+        avio_wl32(pb, i);
+    }
+    for (i = 0; i < nb_postings; i++) {
+        avio_wl32(pb, postings[i].key);
+        avio_wl32(pb, postings[i].entry);
+        avio_wl32(pb, postings[i].segment);
+    }
+
+    return offset;
+}
+
+/**
+ * Write the entries of old and of the inputs with a single table into a
+ * temporary file which then replaces the index.
+ */
+static int index_rewrite(AVFilterContext *ctx, SignatureContext *sic, SignatureIndex *old,
+                         uint32_t nb_postings)
+{
+    AVIOContext *pb = NULL;
+    IndexPosting *postings = NULL;
+    int64_t *offsets = NULL;
+    uint32_t nb_entries = old->nb_entries + sic->nb_inputs, i, t;
+    char *tmpname = av_asprintf("%s.tmp", sic->index);
+    int64_t table;
+    int ret;
+
+    for (t = 0; t < old->nb_tables; t++)
+        nb_postings += old->tables[t].nb_postings;
+    offsets = av_malloc_array(nb_entries, sizeof(*offsets));
+    postings = av_malloc_array(FFMAX(nb_postings, 1), sizeof(*postings));
+    if (!tmpname || !offsets || !postings) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if ((ret = avio_open(&pb, tmpname, AVIO_FLAG_WRITE)) < 0) {
+        av_log(ctx, AV_LOG_ERROR, "cannot open index file %s\n", tmpname);
+        goto end;
+    }
+    /* rewritten once the table is written */
+    index_write_header(pb, 0, 0, 0);
+
+    /* the entries of old keep their numbers */
+    for (i = 0; i < old->nb_entries; i++) {
+        int64_t offset = index_get_entry_offset(old, i);
+        uint32_t label_len, nb_frames;
+
+        if (offset < 0) {
+            ret = offset;
+            goto end;
+        }
+        avio_seek(old->pb, offset, SEEK_SET);
+        label_len = avio_rl32(old->pb);
+        avio_skip(old->pb, label_len + 8LL);
+        nb_frames = avio_rl32(old->pb);
+        avio_seek(old->pb, offset, SEEK_SET);
+
+        offsets[i] = avio_tell(pb);
+        ret = index_copy(pb, old->pb, 16LL + label_len + (int64_t)nb_frames * INDEX_FRAME_SIZE);
+        if (ret < 0)
+            goto end;
+    }
+    nb_postings = 0;
+    for (t = 0; t < old->nb_tables; t++) {
+        const IndexTable *old_table = &old->tables[t];
+
+        avio_seek(old->pb, old_table->bucket_offset + 4 * (old_table->nb_buckets + 1LL), SEEK_SET);
+        for (i = 0; i < old_table->nb_postings; i++) {
+            postings[nb_postings].key     = avio_rl32(old->pb);
+            postings[nb_postings].entry   = avio_rl32(old->pb);
+            postings[nb_postings].segment = avio_rl32(old->pb);
+            nb_postings++;
+        }
+        if (old->pb->eof_reached) {
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+    }
+
+    ret = index_write_entries(sic, pb, old->nb_entries, offsets + old->nb_entries, postings, &nb_postings);
+    if (ret < 0)
+        goto end;
+    table = index_write_table(pb, 0, 0, nb_entries, offsets, postings, nb_postings);
+    avio_seek(pb, 0, SEEK_SET);
+    index_write_header(pb, nb_entries, 1, table);
+
+    avio_flush(pb);
+    ret = pb->error;
+    avio_closep(&pb);
+    index_close(old);
+    if (ret >= 0)
+        ret = avpriv_io_move(tmpname, sic->index);
+    if (ret < 0)
+        av_log(ctx, AV_LOG_ERROR, "cannot write index file %s\n", sic->index);
+
+end:
+    if (pb) {
+        avio_closep(&pb);
+        avpriv_io_delete(tmpname);
+    }
+    av_freep(&postings);
+    av_freep(&offsets);
+    av_freep(&tmpname);
+    return ret;
+}
+
+/**
+ * Append the entries of the inputs and their table to the index. The header
+ * is only updated once they are written, so the index stays valid if this
+ * fails.
+ */
+static int index_append(AVFilterContext *ctx, SignatureContext *sic, SignatureIndex *old,
+                        uint32_t nb_postings)
+{
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    IndexPosting *postings = NULL;
+    int64_t *offsets = NULL;
+    uint32_t nb_entries = old->nb_entries, nb_tables = old->nb_tables;
+    int64_t last_table = old->last_table, size, table;
+    int ret;
+
+    offsets = av_malloc_array(sic->nb_inputs, sizeof(*offsets));
+    postings = av_malloc_array(FFMAX(nb_postings, 1), sizeof(*postings));
+    if (!offsets || !postings) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    index_close(old);
+
+    av_dict_set(&opts, "truncate", "0", 0);
+    ret = avio_open2(&pb, sic->index, AVIO_FLAG_READ_WRITE, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+    size = avio_size(pb);
+    if (size < INDEX_HEADER_SIZE) {
+        ret = size < 0 ? size : AVERROR_INVALIDDATA;
+        goto end;
+    }
+    avio_seek(pb, size, SEEK_SET);
+
+    nb_postings = 0;
+    ret = index_write_entries(sic, pb, nb_entries, offsets, postings, &nb_postings);
+    if (ret < 0)
+        goto end;
+    table = index_write_table(pb, last_table, nb_entries, sic->nb_inputs, offsets, postings, nb_postings);
+    avio_flush(pb);
+    if (pb->error) {
+        ret = pb->error;
+        goto end;
+    }
+    avio_seek(pb, 0, SEEK_SET);
+    index_write_header(pb, nb_entries + sic->nb_inputs, nb_tables + 1, table);
+    avio_flush(pb);
+    ret = pb->error;
+
+end:
+    if (ret < 0)
+        av_log(ctx, AV_LOG_ERROR, "cannot write index file %s\n", sic->index);
+    avio_closep(&pb);
+    av_freep(&postings);
+    av_freep(&offsets);
+    return ret;
+}
+
+/**
+ * Add the signatures of all inputs to the index, creating it if needed.
+ */
+static int index_add(AVFilterContext *ctx, SignatureContext *sic)
+{
+    SignatureIndex old;
+    const char *protocol = avio_find_protocol_name(sic->index);
+    uint64_t nb_postings = 0, nb_merged;
+    uint32_t t;
+    int i, ret;
+
+    for (i = 0; i < sic->nb_inputs; i++)
+        nb_postings += (uint64_t)get_nb_segments(&sic->streamcontexts[i]) * NB_KEYS;
+    if (nb_postings > INDEX_MAX_POSTINGS) {
+        av_log(ctx, AV_LOG_ERROR, "Cannot add more than %"PRIu64" frames to the index at once.\n",
+               (uint64_t)(INDEX_MAX_POSTINGS / NB_KEYS * 45));
+        return AVERROR(EINVAL);
+    }
+
+    ret = index_open(ctx, &old, sic->index);
+    if (ret < 0 && ret != AVERROR(ENOENT))
+        goto end;
+    if (old.nb_entries > INT32_MAX - sic->nb_inputs) {
+        av_log(ctx, AV_LOG_ERROR, "The index %s is full.\n", sic->index);
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    nb_merged = nb_postings;
+    for (t = 0; t < old.nb_tables; t++)
+        nb_merged += old.tables[t].nb_postings;
+
+    /* only local files can be appended to */
+    if (old.pb && (old.nb_tables < INDEX_MAX_TABLES || nb_merged > INDEX_MAX_POSTINGS) &&
+        protocol && !strcmp(protocol, "file")) {
+        ret = index_append(ctx, sic, &old, nb_postings);
+    } else if (nb_merged <= INDEX_MAX_POSTINGS) {
+        ret = index_rewrite(ctx, sic, &old, nb_postings);
+    } else {
+        av_log(ctx, AV_LOG_ERROR, "The index %s is too large to be rewritten.\n", sic->index);
+        ret = AVERROR(EINVAL);
+    }
+
+end:
+    if (ret == AVERROR_INVALIDDATA)
+        av_log(ctx, AV_LOG_ERROR, "invalid signature index %s\n", sic->index);
+    index_close(&old);
+    return ret;
+}
@@ -0,0 +1,151 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Check that a graph run with the graph thread type gives the same frames
+ * as when run on a single thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+
+#define MAX_FRAMES 64
+
+static const char *const graph_desc =
+    "testsrc2=s=320x240:r=25:d=1,format=yuv420p,split=4[a][b][c][d];"
+    "[b]hflip,scale=160:120[b1];"
+    "[c]vflip,scale=160:120,negate[c1];"
+    "[d]avgblur=sizeX=2,crop=160:120:80:60[d1];"
+    "[a][b1]overlay=x=0:y=0[ab];"
+    "[ab][c1]overlay=x=160:y=0[abc];"
+    "[abc][d1]overlay=x=0:y=120,buffersink";
+
+typedef struct FrameSum {
+    int64_t pts;
+    uint32_t sum;
+} FrameSum;
+
+static uint32_t frame_checksum(const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    uint32_t sum = 0;
+    int plane, y;
+
+    for (plane = 0; plane < 4 && frame->data[plane]; plane++) {
+        int h = frame->height;
+        int linesize = av_image_get_linesize(frame->format, frame->width, plane);
+
+        if (plane == 1 || plane == 2)
+            h = AV_CEIL_RSHIFT(h, desc->log2_chroma_h);
+        for (y = 0; y < h; y++)
+            sum = av_adler32_update(sum, frame->data[plane] + y * frame->linesize[plane], linesize);
+    }
+    return sum;
+}
+
+/**
+ * Run the graph until EOF, storing the checksum of every output frame.
+ *
+ * @return the number of frames, or a negative error code
+ */
+static int run_graph(int thread_type, int nb_threads, FrameSum *sums)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterContext *sink = NULL;
+    AVFrame *frame = av_frame_alloc();
+    int nb_frames = 0, ret, i;
+
+    if (!graph || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    graph->thread_type = thread_type;
+    graph->nb_threads  = nb_threads;
+
+    if ((ret = avfilter_graph_parse_ptr(graph, graph_desc, NULL, NULL, NULL)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        if (!strcmp(graph->filters[i]->filter->name, "buffersink"))
+            sink = graph->filters[i];
+
+    while ((ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+        if (nb_frames == MAX_FRAMES) {
+            ret = AVERROR(ENOSPC);
+            goto end;
+        }
+        sums[nb_frames].pts = frame->pts;
+        sums[nb_frames].sum = frame_checksum(frame);
+        nb_frames++;
+        av_frame_unref(frame);
+    }
+    if (ret == AVERROR_EOF)
+        ret = nb_frames;
+
+end:
+    av_frame_free(&frame);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(void)
+{
+    static const int thread_counts[] = { 2, 3, 4, 8 };
+    FrameSum ref[MAX_FRAMES], sums[MAX_FRAMES];
+    int nb_ref, nb, i, j;
+
+    nb_ref = run_graph(0, 1, ref);
+    if (nb_ref < 0) {
+        fprintf(stderr, "single thread run failed: %s\n", av_err2str(nb_ref));
+        return 1;
+    }
+    for (i = 0; i < nb_ref; i++)
+        printf("%"PRId64" 0x%08"PRIx32"\n", ref[i].pts, ref[i].sum);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(thread_counts); i++) {
+        nb = run_graph(AVFILTER_THREAD_GRAPH | AVFILTER_THREAD_SLICE, thread_counts[i], sums);
+        if (nb < 0) {
+            fprintf(stderr, "%d threads: run failed: %s\n", thread_counts[i], av_err2str(nb));
+            return 1;
+        }
+        if (nb != nb_ref) {
+            printf("%d threads: %d frames instead of %d\n", thread_counts[i], nb, nb_ref);
+            return 1;
+        }
+        for (j = 0; j < nb; j++) {
+            if (sums[j].pts != ref[j].pts || sums[j].sum != ref[j].sum) {
+                printf("%d threads: frame %d differs\n", thread_counts[i], j);
+                return 1;
+            }
+        }
+        printf("%d threads: ok\n", thread_counts[i]);
+    }
+
+    return 0;
+}
@@ -25,4 +25,33 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Set up the AVFILTER_THREAD_GRAPH executor, which activates the ready
+ * filters that do not share a link concurrently on the slice threads of the
+ * graph. Clears the flag from graph->thread_type if a single thread is
+ * available.
+ */
+int ff_graph_executor_init(AVFilterGraph *graph);
+
+void ff_graph_executor_free(AVFilterGraph *graph);
+
+/**
+ * ff_filter_graph_run_once() through the executor: activate the most ready
+ * filter along with as many other ready filters not linked to it or to each
+ * other as there are threads.
+ *
+ * @return  0 or the first error returned by the activated filters,
+ *          AVERROR(EAGAIN) if no filter was ready
+ */
+int ff_graph_executor_run_once(AVFilterGraph *graph);
+
+/**
+ * Protect the state filters activated concurrently by the executor can
+ * share: the readiness and output links of their common neighbours, and
+ * the sink links heap. No-op without executor.
+ */
+void ff_graph_lock(AVFilterGraph *graph);
+
+void ff_graph_unlock(AVFilterGraph *graph);
+
 #endif /* AVFILTER_THREAD_H */
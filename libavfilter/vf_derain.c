@@ -37,6 +37,7 @@ typedef struct DRContext {
     int                filter_type;
     char              *model_filename;
     DNNBackendType     backend_type;
+    char              *backend_options;
     DNNModule         *dnn_module;
     DNNModel          *model;
     DNNData            input;
@@ -56,6 +57,7 @@ static const AVOption derain_options[] = {
     { "tensorflow",  "tensorflow backend flag",     0,                      AV_OPT_TYPE_CONST,  { .i64 = 1 },    0, 0, FLAGS, "backend" },
 #endif
     { "model",       "path to model file",          OFFSET(model_filename), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
+    { "backend_configs", "backend configs, key=value pairs separated by '&'", OFFSET(backend_options), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
     { NULL }
 };
 
@@ -165,7 +167,7 @@ static av_cold int init(AVFilterContext *ctx)
         return AVERROR(EINVAL);
     }
 
-    dr_context->model = (dr_context->dnn_module->load_model)(dr_context->model_filename);
+    dr_context->model = (dr_context->dnn_module->load_model)(dr_context->model_filename, dr_context->backend_options);
     if (!dr_context->model) {
         av_log(ctx, AV_LOG_ERROR, "could not load DNN model\n");
         return AVERROR(EINVAL);
@@ -24,11 +24,16 @@
  */
 
 #include "libavformat/avio.h"
+#include "libavutil/avstring.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/avassert.h"
+#include "libavutil/imgutils.h"
+#include "libswscale/swscale.h"
 #include "avfilter.h"
 #include "dnn_interface.h"
+#include "dnn/dnn_convert.h"
+#include "filters.h"
 #include "formats.h"
 #include "internal.h"
 
@@ -37,8 +42,15 @@ typedef struct DnnProcessingContext {
 
     char *model_filename;
     DNNBackendType backend_type;
+    char *backend_options;
     char *model_inputname;
     char *model_outputname;
+    int async;
+    // requests given to the backend whose result has not been sent yet
+    int nb_in_flight;
+    int eof;
+    int eof_status;
+    int64_t eof_pts;
 
     DNNModule *dnn_module;
     DNNModel *model;
@@ -46,6 +58,20 @@ typedef struct DnnProcessingContext {
     // input & output of the model at execution time
     DNNData input;
     DNNData output;
+
+    // tiled execution, tile_models[0] is model and tile_inputs[0] is input
+    int tile_size, tile_overlap;
+    DNNTileLayout tile_layout;
+    int model_scale;
+    DNNModel **tile_models;
+    DNNData *tile_inputs;
+    int *tile_ret;
+    int nb_tile_models;
+
+    // the model only processes the luma of yuv frames, the chroma is
+    // copied, or scaled when the model changes the frame size
+    struct SwsContext *sws_uv_scale;
+    int sws_uv_height;
 } DnnProcessingContext;
 
 #define OFFSET(x) offsetof(DnnProcessingContext, x)
@@ -59,6 +85,10 @@ static const AVOption dnn_processing_options[] = {
     { "model",       "path to model file",         OFFSET(model_filename),   AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
     { "input",       "input name of the model",    OFFSET(model_inputname),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
     { "output",      "output name of the model",   OFFSET(model_outputname), AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "backend_configs", "backend configs, key=value pairs separated by '&'", OFFSET(backend_options), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
+    { "async",       "keep several frames in flight, executed on another thread", OFFSET(async), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { "tile_size",   "run the model on tiles of this many pixels, 0 for the whole frame", OFFSET(tile_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "tile_overlap", "pixels shared by adjacent tiles on each side, -1 for the receptive field of the model", OFFSET(tile_overlap), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, FLAGS },
     { NULL }
 };
 
@@ -91,7 +121,7 @@ static av_cold int init(AVFilterContext *context)
         return AVERROR(EINVAL);
     }
 
-    ctx->model = (ctx->dnn_module->load_model)(ctx->model_filename);
+    ctx->model = (ctx->dnn_module->load_model)(ctx->model_filename, ctx->backend_options);
     if (!ctx->model) {
         av_log(ctx, AV_LOG_ERROR, "could not load DNN model\n");
         return AVERROR(EINVAL);
@@ -105,6 +135,10 @@ static int query_formats(AVFilterContext *context)
     static const enum AVPixelFormat pix_fmts[] = {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24,
         AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAYF32,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_NV12, AV_PIX_FMT_GRAY10, AV_PIX_FMT_YUV420P10,
+        AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV444P10,
         AV_PIX_FMT_NONE
     };
     AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
@@ -167,6 +201,34 @@ static int check_modelinput_inlink(const DNNData *model_input, const AVFilterLin
             return AVERROR(EIO);
         }
         return 0;
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUV444P:
+    case AV_PIX_FMT_YUV410P:
+    case AV_PIX_FMT_YUV411P:
+    case AV_PIX_FMT_NV12:
+        if (model_input->channels != 1) {
+            LOG_FORMAT_CHANNEL_MISMATCH();
+            return AVERROR(EIO);
+        }
+        if (model_input->dt != DNN_FLOAT && model_input->dt != DNN_UINT8) {
+            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type as float32 and uint8.\n");
+            return AVERROR(EIO);
+        }
+        return 0;
+    case AV_PIX_FMT_GRAY10:
+    case AV_PIX_FMT_YUV420P10:
+    case AV_PIX_FMT_YUV422P10:
+    case AV_PIX_FMT_YUV444P10:
+        if (model_input->channels != 1) {
+            LOG_FORMAT_CHANNEL_MISMATCH();
+            return AVERROR(EIO);
+        }
+        if (model_input->dt != DNN_FLOAT) {
+            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type float32.\n");
+            return AVERROR(EIO);
+        }
+        return 0;
     default:
         av_log(ctx, AV_LOG_ERROR, "%s not supported.\n", av_get_pix_fmt_name(fmt));
         return AVERROR(EIO);
@@ -196,6 +258,23 @@ static int config_input(AVFilterLink *inlink)
 
     ctx->input.width    = inlink->w;
     ctx->input.height   = inlink->h;
+    if (ctx->tile_size) {
+        int overlap = ctx->tile_overlap;
+        if (model_input.width != -1 || model_input.height != -1) {
+            av_log(ctx, AV_LOG_ERROR, "tiles need a model accepting any input size\n");
+            return AVERROR(EINVAL);
+        }
+        if (overlap < 0) {
+            if (!ctx->model->get_receptive_field ||
+                ctx->model->get_receptive_field(ctx->model->model, &overlap) != DNN_SUCCESS) {
+                av_log(ctx, AV_LOG_ERROR, "could not get the receptive field of the model, set tile_overlap\n");
+                return AVERROR(EINVAL);
+            }
+        }
+        ff_dnn_tile_layout_init(&ctx->tile_layout, inlink->w, inlink->h, ctx->tile_size, overlap);
+        ctx->input.width  = ctx->tile_layout.in_w;
+        ctx->input.height = ctx->tile_layout.in_h;
+    }
     ctx->input.channels = model_input.channels;
     ctx->input.dt = model_input.dt;
 
@@ -210,11 +289,132 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
+/**
+ * Check that the try run on one tile scales it by an integer factor, then
+ * create one model instance per thread running tiles.
+ */
+static int config_tiles(AVFilterContext *context, AVFilterLink *outlink)
+{
+    DnnProcessingContext *ctx = context->priv;
+    const DNNTileLayout *layout = &ctx->tile_layout;
+    DNNReturnType result;
+    char *options = NULL;
+    int first = 1, ret = 0;
+
+    ctx->model_scale = ctx->output.width / layout->in_w;
+    if (ctx->model_scale < 1 ||
+        ctx->output.width != layout->in_w * ctx->model_scale ||
+        ctx->output.height != layout->in_h * ctx->model_scale) {
+        av_log(ctx, AV_LOG_ERROR, "tiles need a model whose output size is a multiple of its input size, "
+               "got %dx%d for %dx%d\n", ctx->output.width, ctx->output.height, layout->in_w, layout->in_h);
+        return AVERROR(EINVAL);
+    }
+    outlink->w = layout->width * ctx->model_scale;
+    outlink->h = layout->height * ctx->model_scale;
+
+    ctx->nb_tile_models = FFMIN(layout->nb_tiles, ff_filter_get_nb_threads(context));
+    ctx->tile_models = av_mallocz_array(ctx->nb_tile_models, sizeof(*ctx->tile_models));
+    ctx->tile_inputs = av_mallocz_array(ctx->nb_tile_models, sizeof(*ctx->tile_inputs));
+    ctx->tile_ret = av_mallocz_array(ctx->nb_tile_models, sizeof(*ctx->tile_ret));
+    if (!ctx->tile_models || !ctx->tile_inputs || !ctx->tile_ret)
+        return AVERROR(ENOMEM);
+    ctx->tile_models[0] = ctx->model;
+    ctx->tile_inputs[0] = ctx->input;
+
+    // the model instances already run in parallel on the filter threads,
+    // so the native backend must not start threads of its own as well
+    if (ctx->nb_tile_models > 1 && ctx->backend_type == DNN_NATIVE) {
+        options = av_asprintf("%s%sthreads=1", ctx->backend_options ? ctx->backend_options : "",
+                              ctx->backend_options ? "&" : "");
+        if (!options)
+            return AVERROR(ENOMEM);
+        (ctx->dnn_module->free_model)(&ctx->model);
+        ctx->tile_models[0] = NULL;
+        first = 0;
+    }
+
+    for (int i = first; i < ctx->nb_tile_models; i++) {
+        ctx->tile_models[i] = (ctx->dnn_module->load_model)(ctx->model_filename,
+                                                           options ? options : ctx->backend_options);
+        if (!ctx->tile_models[i]) {
+            av_log(ctx, AV_LOG_ERROR, "could not load DNN model\n");
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        ctx->tile_inputs[i] = ctx->input;
+        result = (ctx->tile_models[i]->set_input_output)(ctx->tile_models[i]->model,
+                                                        &ctx->tile_inputs[i], ctx->model_inputname,
+                                                        (const char **)&ctx->model_outputname, 1);
+        if (result != DNN_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "could not set input and output for the model\n");
+            ret = AVERROR(EIO);
+            goto end;
+        }
+    }
+    av_log(ctx, AV_LOG_VERBOSE, "%d tiles of %dx%d pixels run on %dx%d inputs by %d model instance(s)\n",
+           layout->nb_tiles, layout->tile_w, layout->tile_h, layout->in_w, layout->in_h, ctx->nb_tile_models);
+
+end:
+    ctx->model = ctx->tile_models[0];
+    av_free(options);
+    return ret;
+}
+
+static int is_yuv(enum AVPixelFormat fmt)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    return !(desc->flags & AV_PIX_FMT_FLAG_RGB) && desc->nb_components >= 3;
+}
+
+static int prepare_uv_scale(AVFilterLink *outlink)
+{
+    AVFilterContext *context = outlink->src;
+    DnnProcessingContext *ctx = context->priv;
+    AVFilterLink *inlink = context->inputs[0];
+    enum AVPixelFormat fmt = inlink->format;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    enum AVPixelFormat uv_fmt;
+    int sws_src_h, sws_src_w, sws_dst_h, sws_dst_w;
+
+    if (!is_yuv(fmt) || (inlink->w == outlink->w && inlink->h == outlink->h))
+        return 0;
+
+    // the chroma planes are scaled one at a time, or both at once when interleaved
+    uv_fmt = fmt == AV_PIX_FMT_NV12 ? AV_PIX_FMT_YA8 :
+             desc->comp[0].depth > 8 ? AV_PIX_FMT_GRAY10 : AV_PIX_FMT_GRAY8;
+    sws_src_h = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
+    sws_src_w = AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w);
+    sws_dst_h = AV_CEIL_RSHIFT(outlink->h, desc->log2_chroma_h);
+    sws_dst_w = AV_CEIL_RSHIFT(outlink->w, desc->log2_chroma_w);
+    ctx->sws_uv_scale = sws_getContext(sws_src_w, sws_src_h, uv_fmt,
+                                       sws_dst_w, sws_dst_h, uv_fmt,
+                                       SWS_BICUBIC, NULL, NULL, NULL);
+    if (!ctx->sws_uv_scale) {
+        av_log(ctx, AV_LOG_ERROR, "could not create SwsContext for chroma scaling\n");
+        return AVERROR(ENOMEM);
+    }
+    ctx->sws_uv_height = sws_src_h;
+
+    return 0;
+}
+
+/**
+ * Called by the backend thread when requests are done, their results are
+ * sent by the next activation of the filter.
+ */
+static void async_done(void *opaque)
+{
+    AVFilterContext *context = opaque;
+
+    ff_filter_set_ready(context, 100);
+}
+
 static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *context = outlink->src;
     DnnProcessingContext *ctx = context->priv;
     DNNReturnType result;
+    int ret;
 
     // have a try run in case that the dnn model resize the frame
     result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
@@ -225,123 +425,139 @@ static int config_output(AVFilterLink *outlink)
 
     outlink->w = ctx->output.width;
     outlink->h = ctx->output.height;
+    // the tiles of a frame already run in parallel
+    if (ctx->tile_size) {
+        ctx->async = 0;
+        ret = config_tiles(context, outlink);
+        if (ret < 0)
+            return ret;
+    } else if (ctx->async && !ctx->dnn_module->start_request) {
+        av_log(ctx, AV_LOG_WARNING, "the backend does not support asynchronous execution\n");
+        ctx->async = 0;
+    }
+    if (ctx->async) {
+        ctx->model->async_done = async_done;
+        ctx->model->async_done_opaque = context;
+    }
 
-    return 0;
+    return prepare_uv_scale(outlink);
 }
 
-static int copy_from_frame_to_dnn(DNNData *dnn_input, const AVFrame *frame)
+/**
+ * Copy the dnn_input->width x dnn_input->height pixels of frame starting at
+ * (x0, y0) into the model input, the luma only for yuv frames.
+ */
+static int copy_from_frame_to_dnn(DnnProcessingContext *ctx, DNNData *dnn_input,
+                                  const AVFrame *frame, int x0, int y0)
 {
-    switch (frame->format) {
-    case AV_PIX_FMT_RGB24:
-    case AV_PIX_FMT_BGR24:
-        if (dnn_input->dt == DNN_FLOAT) {
-            float *dnn_input_data = dnn_input->data;
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width * 3; j++) {
-                    int k = i * frame->linesize[0] + j;
-                    int t = i * frame->width * 3 + j;
-                    dnn_input_data[t] = frame->data[0][k] / 255.0f;
-                }
-            }
-        } else {
-            uint8_t *dnn_input_data = dnn_input->data;
-            av_assert0(dnn_input->dt == DNN_UINT8);
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width * 3; j++) {
-                    int k = i * frame->linesize[0] + j;
-                    int t = i * frame->width * 3 + j;
-                    dnn_input_data[t] = frame->data[0][k];
-                }
-            }
-        }
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const int width = dnn_input->width * dnn_input->channels;
+    const int depth = desc->comp[0].depth;
+    const uint8_t *src = frame->data[0] + y0 * frame->linesize[0] + x0 * desc->comp[0].step;
+
+    if (frame->format == AV_PIX_FMT_GRAYF32) {
+        av_assert0(dnn_input->dt == DNN_FLOAT);
+        for (int i = 0; i < dnn_input->height; i++)
+            memcpy((float *)dnn_input->data + i * width, src + i * frame->linesize[0], width * sizeof(float));
         return 0;
-    case AV_PIX_FMT_GRAY8:
-        {
-            uint8_t *dnn_input_data = dnn_input->data;
-            av_assert0(dnn_input->dt == DNN_UINT8);
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width; j++) {
-                    int k = i * frame->linesize[0] + j;
-                    int t = i * frame->width + j;
-                    dnn_input_data[t] = frame->data[0][k];
-                }
-            }
-        }
-        return 0;
-    case AV_PIX_FMT_GRAYF32:
-        {
-            float *dnn_input_data = dnn_input->data;
-            av_assert0(dnn_input->dt == DNN_FLOAT);
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width; j++) {
-                    int k = i * frame->linesize[0] + j * sizeof(float);
-                    int t = i * frame->width + j;
-                    dnn_input_data[t] = *(float*)(frame->data[0] + k);
-                }
-            }
+    }
+    if (depth == 8 && dnn_input->dt == DNN_FLOAT) {
+        for (int i = 0; i < dnn_input->height; i++) {
+            float *dnn_input_data = (float *)dnn_input->data + i * width;
+            for (int j = 0; j < width; j++)
+                dnn_input_data[j] = src[i * frame->linesize[0] + j] / 255.0f;
         }
         return 0;
-    default:
-        return AVERROR(EIO);
     }
 
+    ff_dnn_samples_to_tensor(dnn_input->data, dnn_input->dt, width,
+                             src, frame->linesize[0], depth, width, dnn_input->height, 0.0f, 1.0f);
     return 0;
 }
 
-static int copy_from_dnn_to_frame(AVFrame *frame, const DNNData *dnn_output)
+/**
+ * Copy the kept part of tile, scaled by scale, from the model output into
+ * frame, the output of the whole frame is the tile at (0, 0) of the frame size.
+ */
+static int copy_from_dnn_to_frame(DnnProcessingContext *ctx, AVFrame *frame, const DNNData *dnn_output,
+                                  const DNNTile *tile, int scale)
 {
-    switch (frame->format) {
-    case AV_PIX_FMT_RGB24:
-    case AV_PIX_FMT_BGR24:
-        if (dnn_output->dt == DNN_FLOAT) {
-            float *dnn_output_data = dnn_output->data;
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width * 3; j++) {
-                    int k = i * frame->linesize[0] + j;
-                    int t = i * frame->width * 3 + j;
-                    frame->data[0][k] = av_clip_uintp2((int)(dnn_output_data[t] * 255.0f), 8);
-                }
-            }
-        } else {
-            uint8_t *dnn_output_data = dnn_output->data;
-            av_assert0(dnn_output->dt == DNN_UINT8);
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width * 3; j++) {
-                    int k = i * frame->linesize[0] + j;
-                    int t = i * frame->width * 3 + j;
-                    frame->data[0][k] = dnn_output_data[t];
-                }
-            }
-        }
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const int channels = dnn_output->channels;
+    const int width = tile->w * scale * channels;
+    const int dnn_linesize = dnn_output->width * channels;
+    const int dnn_offset = (tile->y - tile->in_y) * scale * dnn_linesize + (tile->x - tile->in_x) * scale * channels;
+    uint8_t *dst = frame->data[0] + tile->y * scale * frame->linesize[0] + tile->x * scale * desc->comp[0].step;
+    const void *src;
+
+    if (dnn_output->dt == DNN_FLOAT)
+        src = (const float *)dnn_output->data + dnn_offset;
+    else
+        src = (const uint8_t *)dnn_output->data + dnn_offset;
+
+    if (frame->format == AV_PIX_FMT_GRAYF32) {
+        av_assert0(dnn_output->dt == DNN_FLOAT);
+        for (int i = 0; i < tile->h * scale; i++)
+            memcpy(dst + i * frame->linesize[0], (const float *)src + i * dnn_linesize, width * sizeof(float));
         return 0;
-    case AV_PIX_FMT_GRAY8:
-        {
-            uint8_t *dnn_output_data = dnn_output->data;
-            av_assert0(dnn_output->dt == DNN_UINT8);
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width; j++) {
-                    int k = i * frame->linesize[0] + j;
-                    int t = i * frame->width + j;
-                    frame->data[0][k] = dnn_output_data[t];
-                }
-            }
+    }
+    if (desc->comp[0].depth == 8 && dnn_output->dt == DNN_FLOAT) {
+        for (int i = 0; i < tile->h * scale; i++) {
+            const float *dnn_output_data = (const float *)src + i * dnn_linesize;
+            for (int j = 0; j < width; j++)
+                dst[i * frame->linesize[0] + j] = av_clip_uintp2((int)(dnn_output_data[j] * 255.0f), 8);
         }
         return 0;
-    case AV_PIX_FMT_GRAYF32:
-        {
-            float *dnn_output_data = dnn_output->data;
-            av_assert0(dnn_output->dt == DNN_FLOAT);
-            for (int i = 0; i < frame->height; i++) {
-                for(int j = 0; j < frame->width; j++) {
-                    int k = i * frame->linesize[0] + j * sizeof(float);
-                    int t = i * frame->width + j;
-                    *(float*)(frame->data[0] + k) = dnn_output_data[t];
-                }
-            }
+    }
+
+    ff_dnn_tensor_to_samples(dst, frame->linesize[0], desc->comp[0].depth,
+                             src, dnn_output->dt, dnn_linesize, width, tile->h * scale, 0.0f, 1.0f);
+    return 0;
+}
+
+/**
+ * Copy or scale the chroma planes of in into out.
+ */
+static void copy_uv_planes(DnnProcessingContext *ctx, AVFrame *out, const AVFrame *in)
+{
+    if (!is_yuv(in->format))
+        return;
+
+    if (!ctx->sws_uv_scale) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(in->format);
+        const int uv_height = AV_CEIL_RSHIFT(in->height, desc->log2_chroma_h);
+        for (int i = 1; i < 3 && in->data[i]; i++) {
+            int bytewidth = av_image_get_linesize(in->format, in->width, i);
+            av_image_copy_plane(out->data[i], out->linesize[i], in->data[i], in->linesize[i],
+                                bytewidth, uv_height);
         }
-        return 0;
-    default:
-        return AVERROR(EIO);
+    } else {
+        for (int i = 1; i < 3 && in->data[i]; i++)
+            sws_scale(ctx->sws_uv_scale, (const uint8_t **)(in->data + i), in->linesize + i,
+                      0, ctx->sws_uv_height, out->data + i, out->linesize + i);
+    }
+}
+
+typedef struct ThreadData {
+    const AVFrame *in;
+    AVFrame *out;
+} ThreadData;
+
+static int run_tiles(AVFilterContext *context, void *arg, int jobnr, int nb_jobs)
+{
+    DnnProcessingContext *ctx = context->priv;
+    const DNNTileLayout *layout = &ctx->tile_layout;
+    const ThreadData *td = arg;
+    DNNData output;
+
+    for (int i = jobnr; i < layout->nb_tiles; i += nb_jobs) {
+        DNNTile tile;
+
+        ff_dnn_get_tile(layout, i, &tile);
+        copy_from_frame_to_dnn(ctx, &ctx->tile_inputs[jobnr], td->in, tile.in_x, tile.in_y);
+        if ((ctx->dnn_module->execute_model)(ctx->tile_models[jobnr], &output, 1) != DNN_SUCCESS)
+            return AVERROR(EIO);
+        copy_from_dnn_to_frame(ctx, td->out, &output, &tile, ctx->model_scale);
     }
 
     return 0;
@@ -355,7 +571,32 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     DNNReturnType dnn_result;
     AVFrame *out;
 
-    copy_from_frame_to_dnn(&ctx->input, in);
+    if (ctx->tile_size) {
+        ThreadData td;
+
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        av_frame_copy_props(out, in);
+
+        td.in = in;
+        td.out = out;
+        context->internal->execute(context, run_tiles, &td, ctx->tile_ret, ctx->nb_tile_models);
+        copy_uv_planes(ctx, out, in);
+        av_frame_free(&in);
+        for (int i = 0; i < ctx->nb_tile_models; i++) {
+            if (ctx->tile_ret[i] < 0) {
+                av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+                av_frame_free(&out);
+                return ctx->tile_ret[i];
+            }
+        }
+        return ff_filter_frame(outlink, out);
+    }
+
+    copy_from_frame_to_dnn(ctx, &ctx->input, in, 0, 0);
 
     dnn_result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
     if (dnn_result != DNN_SUCCESS){
@@ -371,19 +612,163 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
 
     av_frame_copy_props(out, in);
-    copy_from_dnn_to_frame(out, &ctx->output);
+    copy_from_dnn_to_frame(ctx, out, &ctx->output, &(DNNTile){ .w = out->width, .h = out->height }, 1);
+    copy_uv_planes(ctx, out, in);
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
 }
 
+/**
+ * Send the output of the oldest request in flight if it is done.
+ *
+ * @return 1 if a frame was sent, 0 if no request is done, a negative error code otherwise
+ */
+static int output_result(AVFilterContext *context)
+{
+    AVFilterLink *outlink = context->outputs[0];
+    DnnProcessingContext *ctx = context->priv;
+    DNNAsyncStatusType status;
+    DNNData output;
+    void *user_data;
+    AVFrame *in, *out;
+    int ret;
+
+    status = (ctx->dnn_module->get_async_result)(ctx->model, &output, 1, &user_data, 0);
+    if (status == DAST_EMPTY_QUEUE || status == DAST_NOT_READY)
+        return 0;
+
+    in = user_data;
+    ctx->nb_in_flight--;
+    if (status != DAST_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+        av_frame_free(&in);
+        return AVERROR(EIO);
+    }
+
+    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+    av_frame_copy_props(out, in);
+    copy_from_dnn_to_frame(ctx, out, &output, &(DNNTile){ .w = out->width, .h = out->height }, 1);
+    copy_uv_planes(ctx, out, in);
+    av_frame_free(&in);
+
+    ret = ff_filter_frame(outlink, out);
+    return ret < 0 ? ret : 1;
+}
+
+/**
+ * Give the queued input frames to the free requests, without waiting for
+ * the requests in flight.
+ */
+static int submit_frames(AVFilterContext *context)
+{
+    AVFilterLink *inlink = context->inputs[0];
+    DnnProcessingContext *ctx = context->priv;
+    DNNData input;
+    AVFrame *in;
+    int ret;
+
+    while (ff_inlink_queued_frames(inlink) &&
+           (ctx->dnn_module->start_request)(ctx->model, &input) == DNN_SUCCESS) {
+        ret = ff_inlink_consume_frame(inlink, &in);
+        if (ret <= 0)
+            return ret;
+
+        copy_from_frame_to_dnn(ctx, &input, in, 0, 0);
+        if ((ctx->dnn_module->execute_model_async)(ctx->model, in) != DNN_SUCCESS) {
+            av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+            av_frame_free(&in);
+            return AVERROR(EIO);
+        }
+        ctx->nb_in_flight++;
+    }
+
+    return 0;
+}
+
+static int activate(AVFilterContext *context)
+{
+    AVFilterLink *inlink = context->inputs[0];
+    AVFilterLink *outlink = context->outputs[0];
+    DnnProcessingContext *ctx = context->priv;
+    int ret, status, got_frame = 0;
+    int64_t pts;
+    AVFrame *in;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    if (!ctx->async) {
+        ret = ff_inlink_consume_frame(inlink, &in);
+        if (ret < 0)
+            return ret;
+        if (ret > 0)
+            return filter_frame(inlink, in);
+    } else {
+        // the model runs while upstream filters produce the next frames,
+        // async_done() activates the filter again when requests are done
+        while ((ret = output_result(context)) > 0)
+            got_frame = 1;
+        if (ret < 0)
+            return ret;
+        ret = submit_frames(context);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (!ctx->eof && ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        ctx->eof = 1;
+        ctx->eof_status = status;
+        ctx->eof_pts = pts;
+        if (ctx->async)
+            (ctx->dnn_module->flush)(ctx->model);
+    }
+    if (ctx->eof) {
+        if (!ctx->nb_in_flight)
+            ff_outlink_set_status(outlink, ctx->eof_status, ctx->eof_pts);
+        return 0;
+    }
+    if (got_frame)
+        return 0;
+
+    // with async, the frames which did not get a request wait in inlink
+    if (!ff_inlink_queued_frames(inlink))
+        FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     DnnProcessingContext *context = ctx->priv;
 
-    if (context->dnn_module)
+    if (context->dnn_module && context->model && context->async) {
+        DNNData output;
+        void *user_data;
+
+        // release the frames of the requests still in flight
+        (context->dnn_module->flush)(context->model);
+        while ((context->dnn_module->get_async_result)(context->model, &output, 1, &user_data, 1) != DAST_EMPTY_QUEUE) {
+            AVFrame *in = user_data;
+            av_frame_free(&in);
+        }
+    }
+
+    if (context->dnn_module) {
+        for (int i = 1; i < context->nb_tile_models; i++) {
+            if (context->tile_models[i])
+                (context->dnn_module->free_model)(&context->tile_models[i]);
+        }
         (context->dnn_module->free_model)(&context->model);
+    }
 
+    av_freep(&context->tile_models);
+    av_freep(&context->tile_inputs);
+    av_freep(&context->tile_ret);
     av_freep(&context->dnn_module);
+    sws_freeContext(context->sws_uv_scale);
 }
 
 static const AVFilterPad dnn_processing_inputs[] = {
@@ -391,7 +776,6 @@ static const AVFilterPad dnn_processing_inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .config_props = config_input,
-        .filter_frame = filter_frame,
     },
     { NULL }
 };
@@ -415,4 +799,6 @@ AVFilter ff_vf_dnn_processing = {
     .inputs        = dnn_processing_inputs,
     .outputs       = dnn_processing_outputs,
     .priv_class    = &dnn_processing_class,
+    .activate      = activate,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -0,0 +1,375 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale the input to several sizes at once
+ */
+
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct MultiScaleOutput {
+    int w, h;
+    int src;                    ///< index of the output scaled from, -1 for the input
+    struct SwsContext *sws;
+} MultiScaleOutput;
+
+typedef struct MultiScaleContext {
+    const AVClass *class;
+    char *sizes_str;
+    enum AVPixelFormat format;
+    char *flags_str;
+    char *cascade_flags_str;
+    int cascade;
+
+    int flags;
+    int cascade_flags;          ///< -1 to pick the flags of each cascaded step
+    int nb_outputs;
+    MultiScaleOutput *outputs;
+    int *order;                 ///< output indices by decreasing size
+    AVFrame **frames;
+} MultiScaleContext;
+
+static int parse_flags(AVFilterContext *ctx, const char *str, int *flags)
+{
+    const AVClass *class = sws_get_class();
+    const AVOption    *o = av_opt_find(&class, "sws_flags", NULL, 0,
+                                       AV_OPT_SEARCH_FAKE_OBJ);
+    int ret = av_opt_eval_flags(&class, o, str, flags);
+    if (ret < 0)
+        av_log(ctx, AV_LOG_ERROR, "Invalid scaler flags '%s'\n", str);
+    return ret;
+}
+
+/**
+ * Select the scaler flags of a step cascaded from a previous output. Steps
+ * which downscale by at most 2 use a Lanczos kernel, sharper than the
+ * default, to compensate for the softening of the previous step. Larger
+ * steps use an area average, which does not alias however many source
+ * lines fall into one output line.
+ */
+static int cascade_step_flags(MultiScaleContext *s, const MultiScaleOutput *src,
+                              const MultiScaleOutput *dst)
+{
+    int flags = s->flags & ~(SWS_POINT | SWS_AREA | SWS_BICUBLIN | SWS_GAUSS |
+                             SWS_SINC | SWS_LANCZOS | SWS_SPLINE | SWS_X |
+                             SWS_BILINEAR | SWS_BICUBIC | SWS_FAST_BILINEAR);
+
+    if (s->cascade_flags >= 0)
+        return s->cascade_flags;
+    if (src->w <= 2 * dst->w && src->h <= 2 * dst->h)
+        return flags | SWS_LANCZOS;
+    return flags | SWS_AREA;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    MultiScaleContext *s = ctx->priv;
+    const int idx = FF_OUTLINK_IDX(outlink);
+    MultiScaleOutput *out = &s->outputs[idx];
+    int src_w, src_h, src_format, flags, ret;
+
+    if (out->src < 0) {
+        src_w      = inlink->w;
+        src_h      = inlink->h;
+        src_format = inlink->format;
+        flags      = s->flags;
+    } else {
+        src_w      = s->outputs[out->src].w;
+        src_h      = s->outputs[out->src].h;
+        src_format = outlink->format;
+        flags      = cascade_step_flags(s, &s->outputs[out->src], out);
+    }
+
+    outlink->w = out->w;
+    outlink->h = out->h;
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    sws_freeContext(out->sws);
+    out->sws = sws_alloc_context();
+    if (!out->sws)
+        return AVERROR(ENOMEM);
+
+    av_opt_set_int(out->sws, "srcw", src_w, 0);
+    av_opt_set_int(out->sws, "srch", src_h, 0);
+    av_opt_set_int(out->sws, "src_format", src_format, 0);
+    av_opt_set_int(out->sws, "dstw", outlink->w, 0);
+    av_opt_set_int(out->sws, "dsth", outlink->h, 0);
+    av_opt_set_int(out->sws, "dst_format", outlink->format, 0);
+    av_opt_set_int(out->sws, "sws_flags", flags, 0);
+    av_opt_set_int(out->sws, "threads", 1, 0);
+    if ((ret = sws_init_context(out->sws, NULL, NULL)) < 0)
+        return ret;
+
+    av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d from %s %dx%d %s flags:0x%0x\n",
+           idx, out->w, out->h, out->src < 0 ? "input" : "output",
+           src_w, src_h, av_get_pix_fmt_name(src_format), flags);
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    const char *p = s->sizes_str;
+    int i, j, ret;
+
+    if (!p || !*p) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes given.\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->nb_outputs = 1;
+    for (; *p; p++)
+        s->nb_outputs += *p == '|';
+
+    s->outputs = av_calloc(s->nb_outputs, sizeof(*s->outputs));
+    s->order   = av_calloc(s->nb_outputs, sizeof(*s->order));
+    s->frames  = av_calloc(s->nb_outputs, sizeof(*s->frames));
+    if (!s->outputs || !s->order || !s->frames)
+        return AVERROR(ENOMEM);
+
+    p = s->sizes_str;
+    for (i = 0; i < s->nb_outputs; i++) {
+        MultiScaleOutput *out = &s->outputs[i];
+        AVFilterPad pad = { 0 };
+        char *size = av_get_token(&p, "|");
+
+        if (!size)
+            return AVERROR(ENOMEM);
+        if (*p)
+            p++;
+        ret = av_parse_video_size(&out->w, &out->h, size);
+        if (ret < 0)
+            av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'\n", size);
+        av_free(size);
+        if (ret < 0)
+            return ret;
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", i);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+        if ((ret = ff_insert_outpad(ctx, i, &pad)) < 0) {
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
+
+    /* insertion sort, stable so that equal sizes keep their order */
+    for (i = 0; i < s->nb_outputs; i++) {
+        const int64_t area = (int64_t)s->outputs[i].w * s->outputs[i].h;
+        for (j = i; j > 0; j--) {
+            const MultiScaleOutput *prev = &s->outputs[s->order[j - 1]];
+            if ((int64_t)prev->w * prev->h >= area)
+                break;
+            s->order[j] = s->order[j - 1];
+        }
+        s->order[j] = i;
+    }
+
+    /* each output is scaled from the smallest larger output already
+     * computed, so the whole ladder reads the input only once */
+    for (i = 0; i < s->nb_outputs; i++) {
+        MultiScaleOutput *out = &s->outputs[s->order[i]];
+        out->src = -1;
+        for (j = 0; s->cascade && j < i; j++) {
+            const MultiScaleOutput *prev = &s->outputs[s->order[j]];
+            if (prev->w >= out->w && prev->h >= out->h)
+                out->src = s->order[j];
+        }
+    }
+
+    s->flags = 0;
+    if (s->flags_str && (ret = parse_flags(ctx, s->flags_str, &s->flags)) < 0)
+        return ret;
+    s->cascade_flags = -1;
+    if (s->cascade_flags_str && strcmp(s->cascade_flags_str, "auto") &&
+        (ret = parse_flags(ctx, s->cascade_flags_str, &s->cascade_flags)) < 0)
+        return ret;
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    int i;
+
+    for (i = 0; i < s->nb_outputs && s->outputs; i++)
+        sws_freeContext(s->outputs[i].sws);
+    for (i = 0; i < s->nb_outputs && s->frames; i++)
+        av_frame_free(&s->frames[i]);
+    av_freep(&s->outputs);
+    av_freep(&s->order);
+    av_freep(&s->frames);
+
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_freep(&ctx->output_pads[i].name);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    AVFilterFormats *formats = NULL;
+    const AVPixFmtDescriptor *desc = NULL;
+    enum AVPixelFormat pix_fmt;
+    int i, ret;
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->out_formats)) < 0)
+        return ret;
+
+    /* a single list for all the outputs, so that they get the same format
+     * and can be scaled from each other */
+    formats = NULL;
+    if (s->format != AV_PIX_FMT_NONE) {
+        if ((ret = ff_add_format(&formats, s->format)) < 0)
+            return ret;
+    } else {
+        desc = NULL;
+        while ((desc = av_pix_fmt_desc_next(desc))) {
+            pix_fmt = av_pix_fmt_desc_get_id(desc);
+            if (sws_isSupportedOutput(pix_fmt) && sws_isSupportedInput(pix_fmt) &&
+                (ret = ff_add_format(&formats, pix_fmt)) < 0)
+                return ret;
+        }
+    }
+    for (i = 0; i < ctx->nb_outputs; i++)
+        if ((ret = ff_formats_ref(formats, &ctx->outputs[i]->in_formats)) < 0)
+            return ret;
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    MultiScaleContext *s = ctx->priv;
+    int i, ret = 0;
+
+    for (i = 0; i < s->nb_outputs; i++) {
+        const int idx = s->order[i];
+        MultiScaleOutput *out = &s->outputs[idx];
+        AVFilterLink *outlink = ctx->outputs[idx];
+        const AVFrame *src = out->src < 0 ? in : s->frames[out->src];
+        AVFrame *frame;
+
+        frame = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!frame) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        s->frames[idx] = frame;
+        av_frame_copy_props(frame, in);
+        frame->width  = outlink->w;
+        frame->height = outlink->h;
+        av_reduce(&frame->sample_aspect_ratio.num, &frame->sample_aspect_ratio.den,
+                  (int64_t)in->sample_aspect_ratio.num * outlink->h * inlink->w,
+                  (int64_t)in->sample_aspect_ratio.den * outlink->w * inlink->h,
+                  INT_MAX);
+
+        ret = sws_scale(out->sws, (const uint8_t * const *)src->data, src->linesize,
+                        0, out->src < 0 ? inlink->h : s->outputs[out->src].h,
+                        frame->data, frame->linesize);
+        if (ret < 0)
+            goto end;
+    }
+
+    for (i = 0; i < s->nb_outputs; i++) {
+        AVFrame *frame = s->frames[i];
+
+        s->frames[i] = NULL;
+        if (ff_outlink_get_status(ctx->outputs[i])) {
+            av_frame_free(&frame);
+            continue;
+        }
+        ret = ff_filter_frame(ctx->outputs[i], frame);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    for (i = 0; i < s->nb_outputs; i++)
+        av_frame_free(&s->frames[i]);
+    av_frame_free(&in);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(MultiScaleContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption multiscale_options[] = {
+    { "sizes",         "set the '|'-separated output sizes",          OFFSET(sizes_str),         AV_OPT_TYPE_STRING,    { .str = NULL },           .flags = FLAGS },
+    { "format",        "set the output pixel format",                 OFFSET(format),            AV_OPT_TYPE_PIXEL_FMT, { .i64 = AV_PIX_FMT_NONE }, -1, INT_MAX, .flags = FLAGS },
+    { "flags",         "set the scaler flags for scaling the input",  OFFSET(flags_str),         AV_OPT_TYPE_STRING,    { .str = "bicubic" },      .flags = FLAGS },
+    { "cascade",       "scale each output from a larger output",      OFFSET(cascade),           AV_OPT_TYPE_BOOL,      { .i64 = 0 }, 0, 1,        .flags = FLAGS },
+    { "cascade_flags", "set the scaler flags for the cascaded steps", OFFSET(cascade_flags_str), AV_OPT_TYPE_STRING,    { .str = "auto" },         .flags = FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(multiscale);
+
+static const AVFilterPad multiscale_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_multiscale = {
+    .name          = "multiscale",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes."),
+    .priv_size     = sizeof(MultiScaleContext),
+    .priv_class    = &multiscale_class,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = multiscale_inputs,
+    .outputs       = NULL,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
@@ -207,6 +207,14 @@ static int config_input(AVFilterLink *inlink)
         return AVERROR(EINVAL);
     }
 
+    /* Have the frames allocated with room for the padding, so that they can
+     * be padded in place. The extra line is needed by buffer_needs_copy(),
+     * which measures the room after the picture from its last line end. */
+    inlink->border[0] = s->x;
+    inlink->border[1] = s->y;
+    inlink->border[2] = s->w - s->x - s->in_w;
+    inlink->border[3] = s->h - s->y - s->in_h + (s->w > s->in_w);
+
     return 0;
 
 eval_fail:
@@ -225,35 +233,6 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
-static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
-{
-    PadContext *s = inlink->dst->priv;
-    AVFrame *frame;
-    int plane;
-
-    if (s->inlink_w <= 0)
-        return NULL;
-
-    frame = ff_get_video_buffer(inlink->dst->outputs[0],
-                                w + (s->w - s->in_w),
-                                h + (s->h - s->in_h) + (s->x > 0));
-
-    if (!frame)
-        return NULL;
-
-    frame->width  = w;
-    frame->height = h;
-
-    for (plane = 0; plane < 4 && frame->data[plane] && frame->linesize[plane]; plane++) {
-        int hsub = s->draw.hsub[plane];
-        int vsub = s->draw.vsub[plane];
-        frame->data[plane] += (s->x >> hsub) * s->draw.pixelstep[plane] +
-                              (s->y >> vsub) * frame->linesize[plane];
-    }
-
-    return frame;
-}
-
 /* check whether each plane in this buffer can be padded without copying */
 static int buffer_needs_copy(PadContext *s, AVFrame *frame, AVBufferRef *buf)
 {
@@ -438,7 +417,6 @@ static const AVFilterPad avfilter_vf_pad_inputs[] = {
         .name             = "default",
         .type             = AVMEDIA_TYPE_VIDEO,
         .config_props     = config_input,
-        .get_video_buffer = get_video_buffer,
         .filter_frame     = filter_frame,
     },
     { NULL }
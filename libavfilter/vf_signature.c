@@ -35,6 +35,7 @@
 #include "internal.h"
 #include "signature.h"
 #include "signature_lookup.c"
+#include "signature_index.c"
 
 #define OFFSET(x) offsetof(SignatureContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM
@@ -64,6 +65,15 @@ static const AVOption signature_options[] = {
         OFFSET(thdi),         AV_OPT_TYPE_INT,    {.i64 = 0},        0, INT_MAX,          FLAGS },
     { "th_it",      "threshold for relation of good to all frames",
         OFFSET(thit),         AV_OPT_TYPE_DOUBLE, {.dbl = 0.5},    0.0, 1.0,              FLAGS },
+    { "index",      "path of the signature index",
+        OFFSET(index),        AV_OPT_TYPE_STRING, {.str = NULL},     0, 0,                FLAGS },
+    { "index_mode", "set how the signature index is used",
+        OFFSET(index_mode),   AV_OPT_TYPE_INT,    {.i64 = INDEX_OFF}, 0, NB_INDEX_MODES-1, FLAGS, "index_mode" },
+        { "off",   NULL, 0, AV_OPT_TYPE_CONST, {.i64 = INDEX_OFF},   0, 0, .flags = FLAGS, "index_mode" },
+        { "add",   NULL, 0, AV_OPT_TYPE_CONST, {.i64 = INDEX_ADD},   0, 0, .flags = FLAGS, "index_mode" },
+        { "query", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = INDEX_QUERY}, 0, 0, .flags = FLAGS, "index_mode" },
+    { "index_label", "label of the videos added to the index",
+        OFFSET(index_label),  AV_OPT_TYPE_STRING, {.str = ""},       0, 0,                FLAGS },
     { NULL }
 };
 
@@ -101,6 +111,55 @@ static int config_input(AVFilterLink *inlink)
     }
     sc->w = inlink->w;
     sc->h = inlink->h;
+
+    /* each job sums whole block rows */
+    sc->nb_jobs = FFMIN(32, ff_filter_get_nb_threads(ctx));
+    av_freep(&sc->row_acc);
+    sc->row_acc = av_malloc_array(sc->w * sc->nb_jobs, sizeof(*sc->row_acc));
+    if (!sc->row_acc)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+typedef struct ThreadData {
+    StreamContext *sc;
+    const AVFrame *in;
+    uint64_t (*intpic)[32];
+} ThreadData;
+
+/**
+ * Sum the pixels of each of the 32x32 blocks of the block rows of the job.
+ * Pixel row i belongs to block row i * 32 / h, and pixel column j to block
+ * column j * 32 / w. The rows of a block row are first summed into 16-bit
+ * sums of columns, which can hold 257 rows of 8-bit pixels.
+ */
+static int block_sums(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    StreamContext *sc = td->sc;
+    const int w = sc->w, h = sc->h;
+    uint16_t *acc = sc->row_acc + jobnr * w;
+    int r, c, y, x, n;
+
+    for (r = 32 * jobnr / nb_jobs; r < 32 * (jobnr + 1) / nb_jobs; r++) {
+        const int y_end = ((r + 1) * h + 31) / 32;
+
+        for (y = (r * h + 31) / 32; y < y_end; y += n) {
+            n = FFMIN(y_end - y, 257);
+            memset(acc, 0, w * sizeof(*acc));
+            for (x = y; x < y + n; x++) {
+                const uint8_t *src = td->in->data[0] + x * td->in->linesize[0];
+                for (c = 0; c < w; c++)
+                    acc[c] += src[c];
+            }
+            for (c = 0; c < 32; c++) {
+                uint64_t sum = 0;
+                for (x = (c * w + 31) / 32; x < ((c + 1) * w + 31) / 32; x++)
+                    sum += acc[x];
+                td->intpic[r][c] += sum;
+            }
+        }
+    }
     return 0;
 }
 
@@ -163,9 +222,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     uint8_t wordt2b[5] = { 0, 0, 0, 0, 0 }; /* word ternary to binary */
     uint64_t intpic[32][32];
     uint64_t rowcount;
-    uint8_t *p = picref->data[0];
-    int inti, intj;
-    int *intjlut;
+    ThreadData td;
 
     uint64_t conflist[DIFFELEM_SIZE];
     int f = 0, g = 0, w = 0;
@@ -196,22 +253,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     fs->index = sc->lastindex++;
 
     memset(intpic, 0, sizeof(uint64_t)*32*32);
-    intjlut = av_malloc_array(inlink->w, sizeof(int));
-    if (!intjlut)
-        return AVERROR(ENOMEM);
-    for (i = 0; i < inlink->w; i++) {
-        intjlut[i] = (i*32)/inlink->w;
-    }
-
-    for (i = 0; i < inlink->h; i++) {
-        inti = (i*32)/inlink->h;
-        for (j = 0; j < inlink->w; j++) {
-            intj = intjlut[j];
-            intpic[inti][intj] += p[j];
-        }
-        p += picref->linesize[0];
-    }
-    av_freep(&intjlut);
+    td.sc = sc;
+    td.in = picref;
+    td.intpic = intpic;
+    ctx->internal->execute(ctx, block_sums, &td, NULL, sc->nb_jobs);
 
     /* The following calculates a summed area table (intpic) and brings the numbers
      * in intpic to the same denominator.
@@ -296,13 +341,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 
         /* ternarize */
         for (j = 0; j < elemcat->elem_count; j++) {
-            if (elemsignature[j] < -th) {
-                ternary = 0;
-            } else if (elemsignature[j] <= th) {
-                ternary = 1;
-            } else {
-                ternary = 2;
-            }
+            /* 0 below -th, 1 in [-th, th] and 2 above th */
+            ternary = (elemsignature[j] >= -th) + (elemsignature[j] > th);
             fs->framesig[f/5] += ternary * pot3[f%5];
 
             if (f == wordvec[w]) {
@@ -617,8 +657,32 @@ static int request_frame(AVFilterLink *outlink)
         lookup &= sc->exported;
     }
 
+    /* signature index */
+    if (lookup && sic->index_mode != INDEX_OFF && !sic->index_done) {
+        int err;
+
+        sic->index_done = 1;
+        if (sic->index_mode == INDEX_ADD) {
+            err = index_add(ctx, sic);
+        } else {
+            SignatureIndex idx;
+
+            fill_l1distlut(sic->l1distlut);
+            err = index_open(ctx, &idx, sic->index);
+            if (err < 0) {
+                av_log(ctx, AV_LOG_ERROR, "cannot open index file %s\n", sic->index);
+                return err;
+            }
+            for (i = 0; i < sic->nb_inputs && err >= 0; i++)
+                err = index_lookup(ctx, sic, &idx, &sic->streamcontexts[i], i);
+            index_close(&idx);
+        }
+        if (err < 0)
+            return err;
+    }
+
     /* signature lookup */
-    if (lookup && sic->mode != MODE_OFF) {
+    if (lookup && sic->mode != MODE_OFF && sic->index_mode != INDEX_QUERY) {
         /* iterate over every pair */
         for (i = 0; i < sic->nb_inputs; i++) {
             sc = &(sic->streamcontexts[i]);
@@ -693,6 +757,15 @@ static av_cold int init(AVFilterContext *ctx)
         return AVERROR(EINVAL);
     }
 
+    if (sic->index_mode != INDEX_OFF && !sic->index) {
+        av_log(ctx, AV_LOG_ERROR, "The index option is needed by the index mode.\n");
+        return AVERROR(EINVAL);
+    }
+    if (sic->index_mode == INDEX_QUERY && sic->mode == MODE_OFF) {
+        av_log(ctx, AV_LOG_ERROR, "Querying the index needs a detectmode.\n");
+        return AVERROR(EINVAL);
+    }
+
     return 0;
 }
 
@@ -728,6 +801,7 @@ static av_cold void uninit(AVFilterContext *ctx)
                 av_freep(&tmp);
             }
             sc->coarsesiglist = NULL;
+            av_freep(&sc->row_acc);
         }
         av_freep(&sic->streamcontexts);
     }
@@ -767,5 +841,5 @@ AVFilter ff_vf_signature = {
     .query_formats = query_formats,
     .outputs       = signature_outputs,
     .inputs        = NULL,
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -33,19 +33,33 @@
 #include "libavformat/avio.h"
 #include "libswscale/swscale.h"
 #include "dnn_interface.h"
+#include "dnn/dnn_convert.h"
 
 typedef struct SRContext {
     const AVClass *class;
 
     char *model_filename;
     DNNBackendType backend_type;
+    char *backend_options;
     DNNModule *dnn_module;
     DNNModel *model;
     DNNData input;
     DNNData output;
     int scale_factor;
-    struct SwsContext *sws_contexts[3];
-    int sws_slice_h, sws_input_linesize, sws_output_linesize;
+    struct SwsContext *sws_context;
+    int sws_slice_h;
+    int depth;                  // luma bit depth
+
+    // tiled execution, tile_models[0] is model and tile_inputs[0] is input
+    int tile_size, tile_overlap;
+    DNNTileLayout tile_layout;
+    int model_scale;
+    DNNModel **tile_models;
+    DNNData *tile_inputs;
+    int *tile_ret;
+    int nb_tile_models;
+    uint8_t *upscaled;          // luma upscaled for SRCNN, read by the tiles
+    int upscaled_linesize;
 } SRContext;
 
 #define OFFSET(x) offsetof(SRContext, x)
@@ -58,6 +72,9 @@ static const AVOption sr_options[] = {
 #endif
     { "scale_factor", "scale factor for SRCNN model", OFFSET(scale_factor), AV_OPT_TYPE_INT, { .i64 = 2 }, 2, 4, FLAGS },
     { "model", "path to model file specifying network architecture and its parameters", OFFSET(model_filename), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "backend_configs", "backend configs, key=value pairs separated by '&'", OFFSET(backend_options), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "tile_size", "run the model on tiles of this many pixels, 0 for the whole frame", OFFSET(tile_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "tile_overlap", "pixels shared by adjacent tiles on each side, -1 for the receptive field of the model", OFFSET(tile_overlap), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, FLAGS },
     { NULL }
 };
 
@@ -81,16 +98,13 @@ static av_cold int init(AVFilterContext *context)
         av_log(context, AV_LOG_ERROR, "load_model for network was not specified\n");
         return AVERROR(EIO);
     }
-    sr_context->model = (sr_context->dnn_module->load_model)(sr_context->model_filename);
+    sr_context->model = (sr_context->dnn_module->load_model)(sr_context->model_filename, sr_context->backend_options);
     if (!sr_context->model){
         av_log(context, AV_LOG_ERROR, "could not load DNN model\n");
         return AVERROR(EIO);
     }
 
     sr_context->input.dt = DNN_FLOAT;
-    sr_context->sws_contexts[0] = NULL;
-    sr_context->sws_contexts[1] = NULL;
-    sr_context->sws_contexts[2] = NULL;
 
     return 0;
 }
@@ -99,7 +113,8 @@ static int query_formats(AVFilterContext *context)
 {
     const enum AVPixelFormat pixel_formats[] = {AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P,
                                                 AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P, AV_PIX_FMT_GRAY8,
-                                                AV_PIX_FMT_NONE};
+                                                AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10,
+                                                AV_PIX_FMT_YUV444P10, AV_PIX_FMT_GRAY10, AV_PIX_FMT_NONE};
     AVFilterFormats *formats_list;
 
     formats_list = ff_make_format_list(pixel_formats);
@@ -111,15 +126,117 @@ static int query_formats(AVFilterContext *context)
     return ff_set_common_formats(context, formats_list);
 }
 
+/**
+ * Probe the model on one tile like config_props() does on the whole frame,
+ * then create one model instance per thread running tiles.
+ */
+static int config_tiles(AVFilterContext *context, AVFilterLink *inlink)
+{
+    SRContext *sr_context = context->priv;
+    DNNTileLayout *layout = &sr_context->tile_layout;
+    const char *model_output_name = "y";
+    int overlap = sr_context->tile_overlap;
+    DNNReturnType result;
+
+    if (overlap < 0) {
+        if (!sr_context->model->get_receptive_field ||
+            sr_context->model->get_receptive_field(sr_context->model->model, &overlap) != DNN_SUCCESS) {
+            av_log(context, AV_LOG_ERROR, "could not get the receptive field of the model, set tile_overlap\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
+    for (int upscaled_input = 1; upscaled_input >= 0; upscaled_input--) {
+        int scale = upscaled_input ? sr_context->scale_factor : 1;
+
+        ff_dnn_tile_layout_init(layout, inlink->w * scale, inlink->h * scale, sr_context->tile_size, overlap);
+        sr_context->input.width = layout->in_w;
+        sr_context->input.height = layout->in_h;
+        sr_context->input.channels = 1;
+        result = (sr_context->model->set_input_output)(sr_context->model->model, &sr_context->input, "x", &model_output_name, 1);
+        if (result != DNN_SUCCESS){
+            av_log(context, AV_LOG_ERROR, "could not set input and output for the model\n");
+            return AVERROR(EIO);
+        }
+        result = (sr_context->dnn_module->execute_model)(sr_context->model, &sr_context->output, 1);
+        if (result != DNN_SUCCESS){
+            av_log(context, AV_LOG_ERROR, "failed to execute loaded model\n");
+            return AVERROR(EIO);
+        }
+        if (sr_context->output.width == layout->in_w && sr_context->output.height == layout->in_h)
+            break;
+        sr_context->scale_factor = 0;
+    }
+
+    sr_context->model_scale = sr_context->output.width / layout->in_w;
+    if (sr_context->model_scale < 1 ||
+        sr_context->output.width != layout->in_w * sr_context->model_scale ||
+        sr_context->output.height != layout->in_h * sr_context->model_scale) {
+        av_log(context, AV_LOG_ERROR, "tiles need a model whose output size is a multiple of its input size, "
+               "got %dx%d for %dx%d\n", sr_context->output.width, sr_context->output.height, layout->in_w, layout->in_h);
+        return AVERROR(EINVAL);
+    }
+
+    sr_context->nb_tile_models = FFMIN(layout->nb_tiles, ff_filter_get_nb_threads(context));
+    sr_context->tile_models = av_mallocz_array(sr_context->nb_tile_models, sizeof(*sr_context->tile_models));
+    sr_context->tile_inputs = av_mallocz_array(sr_context->nb_tile_models, sizeof(*sr_context->tile_inputs));
+    sr_context->tile_ret = av_mallocz_array(sr_context->nb_tile_models, sizeof(*sr_context->tile_ret));
+    if (!sr_context->tile_models || !sr_context->tile_inputs || !sr_context->tile_ret)
+        return AVERROR(ENOMEM);
+    sr_context->tile_models[0] = sr_context->model;
+    sr_context->tile_inputs[0] = sr_context->input;
+    for (int i = 1; i < sr_context->nb_tile_models; i++) {
+        sr_context->tile_models[i] = (sr_context->dnn_module->load_model)(sr_context->model_filename, sr_context->backend_options);
+        if (!sr_context->tile_models[i]) {
+            av_log(context, AV_LOG_ERROR, "could not load DNN model\n");
+            return AVERROR(EIO);
+        }
+        sr_context->tile_inputs[i] = sr_context->input;
+        result = (sr_context->tile_models[i]->set_input_output)(sr_context->tile_models[i]->model, &sr_context->tile_inputs[i],
+                                                                "x", &model_output_name, 1);
+        if (result != DNN_SUCCESS){
+            av_log(context, AV_LOG_ERROR, "could not set input and output for the model\n");
+            return AVERROR(EIO);
+        }
+    }
+    av_log(context, AV_LOG_VERBOSE, "%d tiles of %dx%d pixels run on %dx%d inputs by %d model instance(s)\n",
+           layout->nb_tiles, layout->tile_w, layout->tile_h, layout->in_w, layout->in_h, sr_context->nb_tile_models);
+
+    // the frame level sizes used by the rest of config_props()
+    sr_context->input.width = layout->width;
+    sr_context->input.height = layout->height;
+    sr_context->output.width = layout->width * sr_context->model_scale;
+    sr_context->output.height = layout->height * sr_context->model_scale;
+
+    if (sr_context->scale_factor) {
+        sr_context->upscaled_linesize = FFALIGN(layout->width * (sr_context->depth > 8 ? 2 : 1), 32);
+        sr_context->upscaled = av_malloc_array(sr_context->upscaled_linesize, layout->height);
+        if (!sr_context->upscaled)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
 static int config_props(AVFilterLink *inlink)
 {
     AVFilterContext *context = inlink->dst;
     SRContext *sr_context = context->priv;
     AVFilterLink *outlink = context->outputs[0];
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     DNNReturnType result;
     int sws_src_h, sws_src_w, sws_dst_h, sws_dst_w;
     const char *model_output_name = "y";
 
+    sr_context->depth = desc->comp[0].depth;
+
+    if (sr_context->tile_size) {
+        int ret = config_tiles(context, inlink);
+        if (ret < 0)
+            return ret;
+        goto sws_setup;
+    }
+
     sr_context->input.width = inlink->w * sr_context->scale_factor;
     sr_context->input.height = inlink->h * sr_context->scale_factor;
     sr_context->input.channels = 1;
@@ -151,69 +268,33 @@ static int config_props(AVFilterLink *inlink)
         }
         sr_context->scale_factor = 0;
     }
+
+sws_setup:
     outlink->h = sr_context->output.height;
     outlink->w = sr_context->output.width;
-    sr_context->sws_contexts[1] = sws_getContext(sr_context->input.width, sr_context->input.height, AV_PIX_FMT_GRAY8,
-                                                 sr_context->input.width, sr_context->input.height, AV_PIX_FMT_GRAYF32,
-                                                 0, NULL, NULL, NULL);
-    sr_context->sws_input_linesize = sr_context->input.width << 2;
-    sr_context->sws_contexts[2] = sws_getContext(sr_context->output.width, sr_context->output.height, AV_PIX_FMT_GRAYF32,
-                                                 sr_context->output.width, sr_context->output.height, AV_PIX_FMT_GRAY8,
-                                                 0, NULL, NULL, NULL);
-    sr_context->sws_output_linesize = sr_context->output.width << 2;
-    if (!sr_context->sws_contexts[1] || !sr_context->sws_contexts[2]){
-        av_log(context, AV_LOG_ERROR, "could not create SwsContext for conversions\n");
-        return AVERROR(ENOMEM);
-    }
     if (sr_context->scale_factor){
-        sr_context->sws_contexts[0] = sws_getContext(inlink->w, inlink->h, inlink->format,
-                                                     outlink->w, outlink->h, outlink->format,
-                                                     SWS_BICUBIC, NULL, NULL, NULL);
-        if (!sr_context->sws_contexts[0]){
+        sr_context->sws_context = sws_getContext(inlink->w, inlink->h, inlink->format,
+                                                 outlink->w, outlink->h, outlink->format,
+                                                 SWS_BICUBIC, NULL, NULL, NULL);
+        if (!sr_context->sws_context){
             av_log(context, AV_LOG_ERROR, "could not create SwsContext for scaling\n");
             return AVERROR(ENOMEM);
         }
         sr_context->sws_slice_h = inlink->h;
     } else {
-        if (inlink->format != AV_PIX_FMT_GRAY8){
-            sws_src_h = sr_context->input.height;
-            sws_src_w = sr_context->input.width;
-            sws_dst_h = sr_context->output.height;
-            sws_dst_w = sr_context->output.width;
-
-            switch (inlink->format){
-            case AV_PIX_FMT_YUV420P:
-                sws_src_h = AV_CEIL_RSHIFT(sws_src_h, 1);
-                sws_src_w = AV_CEIL_RSHIFT(sws_src_w, 1);
-                sws_dst_h = AV_CEIL_RSHIFT(sws_dst_h, 1);
-                sws_dst_w = AV_CEIL_RSHIFT(sws_dst_w, 1);
-                break;
-            case AV_PIX_FMT_YUV422P:
-                sws_src_w = AV_CEIL_RSHIFT(sws_src_w, 1);
-                sws_dst_w = AV_CEIL_RSHIFT(sws_dst_w, 1);
-                break;
-            case AV_PIX_FMT_YUV444P:
-                break;
-            case AV_PIX_FMT_YUV410P:
-                sws_src_h = AV_CEIL_RSHIFT(sws_src_h, 2);
-                sws_src_w = AV_CEIL_RSHIFT(sws_src_w, 2);
-                sws_dst_h = AV_CEIL_RSHIFT(sws_dst_h, 2);
-                sws_dst_w = AV_CEIL_RSHIFT(sws_dst_w, 2);
-                break;
-            case AV_PIX_FMT_YUV411P:
-                sws_src_w = AV_CEIL_RSHIFT(sws_src_w, 2);
-                sws_dst_w = AV_CEIL_RSHIFT(sws_dst_w, 2);
-                break;
-            default:
-                av_log(context, AV_LOG_ERROR,
-                       "could not create SwsContext for scaling for given input pixel format: %s\n",
-                       av_get_pix_fmt_name(inlink->format));
-                return AVERROR(EIO);
-            }
-            sr_context->sws_contexts[0] = sws_getContext(sws_src_w, sws_src_h, AV_PIX_FMT_GRAY8,
-                                                         sws_dst_w, sws_dst_h, AV_PIX_FMT_GRAY8,
-                                                         SWS_BICUBIC, NULL, NULL, NULL);
-            if (!sr_context->sws_contexts[0]){
+        if (desc->nb_components > 1){
+            // the chroma planes are scaled one at a time, or both at once when interleaved
+            enum AVPixelFormat chroma_format = inlink->format == AV_PIX_FMT_NV12 ? AV_PIX_FMT_YA8 :
+                                               sr_context->depth > 8 ? AV_PIX_FMT_GRAY10 : AV_PIX_FMT_GRAY8;
+            sws_src_h = AV_CEIL_RSHIFT(sr_context->input.height, desc->log2_chroma_h);
+            sws_src_w = AV_CEIL_RSHIFT(sr_context->input.width, desc->log2_chroma_w);
+            sws_dst_h = AV_CEIL_RSHIFT(sr_context->output.height, desc->log2_chroma_h);
+            sws_dst_w = AV_CEIL_RSHIFT(sr_context->output.width, desc->log2_chroma_w);
+
+            sr_context->sws_context = sws_getContext(sws_src_w, sws_src_h, chroma_format,
+                                                     sws_dst_w, sws_dst_h, chroma_format,
+                                                     SWS_BICUBIC, NULL, NULL, NULL);
+            if (!sr_context->sws_context){
                 av_log(context, AV_LOG_ERROR, "could not create SwsContext for scaling\n");
                 return AVERROR(ENOMEM);
             }
@@ -224,6 +305,56 @@ static int config_props(AVFilterLink *inlink)
     return 0;
 }
 
+static void frame_to_input(SRContext *sr_context, float *input, ptrdiff_t input_stride,
+                           const uint8_t *src, int src_linesize, int width, int height)
+{
+    ff_dnn_samples_to_tensor(input, DNN_FLOAT, input_stride, src, src_linesize,
+                             sr_context->depth, width, height, 0.0f, 1.0f);
+}
+
+static void output_to_frame(SRContext *sr_context, uint8_t *dst, int dst_linesize,
+                            const float *output, ptrdiff_t output_stride, int width, int height)
+{
+    ff_dnn_tensor_to_samples(dst, dst_linesize, sr_context->depth, output, DNN_FLOAT,
+                             output_stride, width, height, 0.0f, 1.0f);
+}
+
+typedef struct ThreadData {
+    const uint8_t *src;
+    int src_linesize;
+    AVFrame *out;
+} ThreadData;
+
+static int run_tiles(AVFilterContext *context, void *arg, int jobnr, int nb_jobs)
+{
+    SRContext *sr_context = context->priv;
+    const DNNTileLayout *layout = &sr_context->tile_layout;
+    const ThreadData *td = arg;
+    const int scale = sr_context->model_scale;
+    const int bps = sr_context->depth > 8 ? 2 : 1;
+    DNNData output;
+
+    for (int i = jobnr; i < layout->nb_tiles; i += nb_jobs) {
+        const float *output_data;
+        DNNTile tile;
+
+        ff_dnn_get_tile(layout, i, &tile);
+        frame_to_input(sr_context, sr_context->tile_inputs[jobnr].data, layout->in_w,
+                       td->src + tile.in_y * td->src_linesize + tile.in_x * bps, td->src_linesize,
+                       layout->in_w, layout->in_h);
+
+        if ((sr_context->dnn_module->execute_model)(sr_context->tile_models[jobnr], &output, 1) != DNN_SUCCESS)
+            return AVERROR(EIO);
+
+        output_data = (const float *)output.data + (tile.y - tile.in_y) * scale * output.width
+                                                 + (tile.x - tile.in_x) * scale;
+        output_to_frame(sr_context, td->out->data[0] + tile.y * scale * td->out->linesize[0] + tile.x * scale * bps,
+                        td->out->linesize[0], output_data, output.width, tile.w * scale, tile.h * scale);
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *context = inlink->dst;
@@ -240,24 +371,49 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     av_frame_copy_props(out, in);
     out->height = sr_context->output.height;
     out->width = sr_context->output.width;
-    if (sr_context->scale_factor){
-        sws_scale(sr_context->sws_contexts[0], (const uint8_t **)in->data, in->linesize,
+    if (sr_context->scale_factor && sr_context->tile_size){
+        // the tiles overwrite out->data[0] while others still read the upscaled luma
+        sws_scale(sr_context->sws_context, (const uint8_t **)in->data, in->linesize,
+                  0, sr_context->sws_slice_h,
+                  (uint8_t * const[4]){sr_context->upscaled, out->data[1], out->data[2], out->data[3]},
+                  (const int[4]){sr_context->upscaled_linesize, out->linesize[1], out->linesize[2], out->linesize[3]});
+    } else if (sr_context->scale_factor){
+        sws_scale(sr_context->sws_context, (const uint8_t **)in->data, in->linesize,
                   0, sr_context->sws_slice_h, out->data, out->linesize);
 
-        sws_scale(sr_context->sws_contexts[1], (const uint8_t **)out->data, out->linesize,
-                  0, out->height, (uint8_t * const*)(&sr_context->input.data),
-                  (const int [4]){sr_context->sws_input_linesize, 0, 0, 0});
+        frame_to_input(sr_context, sr_context->input.data, sr_context->input.width, out->data[0], out->linesize[0],
+                       sr_context->input.width, sr_context->input.height);
     } else {
-        if (sr_context->sws_contexts[0]){
-            sws_scale(sr_context->sws_contexts[0], (const uint8_t **)(in->data + 1), in->linesize + 1,
-                      0, sr_context->sws_slice_h, out->data + 1, out->linesize + 1);
-            sws_scale(sr_context->sws_contexts[0], (const uint8_t **)(in->data + 2), in->linesize + 2,
-                      0, sr_context->sws_slice_h, out->data + 2, out->linesize + 2);
+        if (sr_context->sws_context){
+            for (int p = 1; p < 3 && in->data[p]; p++)
+                sws_scale(sr_context->sws_context, (const uint8_t **)(in->data + p), in->linesize + p,
+                          0, sr_context->sws_slice_h, out->data + p, out->linesize + p);
         }
 
-        sws_scale(sr_context->sws_contexts[1], (const uint8_t **)in->data, in->linesize,
-                  0, in->height, (uint8_t * const*)(&sr_context->input.data),
-                  (const int [4]){sr_context->sws_input_linesize, 0, 0, 0});
+        if (!sr_context->tile_size)
+            frame_to_input(sr_context, sr_context->input.data, sr_context->input.width, in->data[0], in->linesize[0],
+                           sr_context->input.width, sr_context->input.height);
+    }
+
+    if (sr_context->tile_size){
+        ThreadData td = { .out = out };
+        if (sr_context->scale_factor){
+            td.src = sr_context->upscaled;
+            td.src_linesize = sr_context->upscaled_linesize;
+        } else {
+            td.src = in->data[0];
+            td.src_linesize = in->linesize[0];
+        }
+        context->internal->execute(context, run_tiles, &td, sr_context->tile_ret, sr_context->nb_tile_models);
+        av_frame_free(&in);
+        for (int i = 0; i < sr_context->nb_tile_models; i++){
+            if (sr_context->tile_ret[i] < 0){
+                av_log(context, AV_LOG_ERROR, "failed to execute loaded model\n");
+                av_frame_free(&out);
+                return sr_context->tile_ret[i];
+            }
+        }
+        return ff_filter_frame(outlink, out);
     }
     av_frame_free(&in);
 
@@ -267,9 +423,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         return AVERROR(EIO);
     }
 
-    sws_scale(sr_context->sws_contexts[2], (const uint8_t *[4]){(const uint8_t *)sr_context->output.data, 0, 0, 0},
-              (const int[4]){sr_context->sws_output_linesize, 0, 0, 0},
-              0, out->height, (uint8_t * const*)out->data, out->linesize);
+    output_to_frame(sr_context, out->data[0], out->linesize[0], sr_context->output.data, sr_context->output.width,
+                    sr_context->output.width, sr_context->output.height);
 
     return ff_filter_frame(outlink, out);
 }
@@ -280,13 +435,20 @@ static av_cold void uninit(AVFilterContext *context)
     SRContext *sr_context = context->priv;
 
     if (sr_context->dnn_module){
+        for (i = 1; i < sr_context->nb_tile_models; ++i){
+            if (sr_context->tile_models[i])
+                (sr_context->dnn_module->free_model)(&sr_context->tile_models[i]);
+        }
         (sr_context->dnn_module->free_model)(&sr_context->model);
         av_freep(&sr_context->dnn_module);
     }
 
-    for (i = 0; i < 3; ++i){
-        sws_freeContext(sr_context->sws_contexts[i]);
-    }
+    av_freep(&sr_context->tile_models);
+    av_freep(&sr_context->tile_inputs);
+    av_freep(&sr_context->tile_ret);
+    av_freep(&sr_context->upscaled);
+
+    sws_freeContext(sr_context->sws_context);
 }
 
 static const AVFilterPad sr_inputs[] = {
@@ -317,4 +479,5 @@ AVFilter ff_vf_sr = {
     .inputs        = sr_inputs,
     .outputs       = sr_outputs,
     .priv_class    = &sr_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -59,13 +59,13 @@ typedef struct SSIMContext {
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    uint8_t *temp;
+    int temp_size;
+    float *score[4];
     int is_rgb;
-    float (*ssim_plane)(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max);
+    int nb_threads;
+    int (*ssim_plane)(AVFilterContext *ctx, void *arg,
+                      int jobnr, int nb_jobs);
     SSIMDSPContext dsp;
 } SSIMContext;
 
@@ -219,62 +219,97 @@ static float ssim_endn_8bit(const int (*sum0)[4], const int (*sum1)[4], int widt
     return ssim;
 }
 
+void ff_ssim_init(SSIMDSPContext *dsp)
+{
+    dsp->ssim_4x4_line = ssim_4x4xn_8bit;
+    dsp->ssim_end_line = ssim_endn_8bit;
+    if (ARCH_X86)
+        ff_ssim_init_x86(dsp);
+}
+
 #define SUM_LEN(w) (((w) >> 2) + 3)
 
-static float ssim_plane_16bit(SSIMDSPContext *dsp,
-                              uint8_t *main, int main_stride,
-                              uint8_t *ref, int ref_stride,
-                              int width, int height, void *temp,
-                              int max)
+typedef struct ThreadData {
+    const uint8_t *main_data[4];
+    const uint8_t *ref_data[4];
+    int main_linesize[4];
+    int ref_linesize[4];
+} ThreadData;
+
+/*
+ * Each job computes the scores of a range of rows of 4x4 blocks, the rows
+ * being summed up in order afterwards so that the result does not depend
+ * on the number of jobs.
+ */
+static int ssim_plane_16bit(AVFilterContext *ctx, void *arg,
+                            int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    float ssim = 0.0;
-    int64_t (*sum0)[4] = temp;
-    int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
-
-    width >>= 2;
-    height >>= 2;
-
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
-            FFSWAP(void*, sum0, sum1);
-            ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
-                             &ref[4 * z * ref_stride], ref_stride,
-                             sum0, width);
-        }
+    SSIMContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int c;
+
+    for (c = 0; c < s->nb_components; c++) {
+        const int main_stride = td->main_linesize[c];
+        const int ref_stride = td->ref_linesize[c];
+        const uint8_t *main = td->main_data[c];
+        const uint8_t *ref = td->ref_data[c];
+        const int width = s->planewidth[c] >> 2;
+        const int height = s->planeheight[c] >> 2;
+        const int slice_start = 1 + ((height - 1) * jobnr) / nb_jobs;
+        const int slice_end = 1 + ((height - 1) * (jobnr+1)) / nb_jobs;
+        int64_t (*sum0)[4] = (void *)(s->temp + jobnr * s->temp_size);
+        int64_t (*sum1)[4] = sum0 + s->temp_size / (2 * sizeof(*sum0));
+        int z = slice_start - 1, y;
+
+        for (y = slice_start; y < slice_end; y++) {
+            for (; z <= y; z++) {
+                FFSWAP(void*, sum0, sum1);
+                ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
+                                 &ref[4 * z * ref_stride], ref_stride,
+                                 sum0, width);
+            }
 
-        ssim += ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
+            s->score[c][y] = ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, s->max);
+        }
     }
 
-    return ssim / ((height - 1) * (width - 1));
+    return 0;
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max)
+static int ssim_plane(AVFilterContext *ctx, void *arg,
+                      int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    float ssim = 0.0;
-    int (*sum0)[4] = temp;
-    int (*sum1)[4] = sum0 + SUM_LEN(width);
-
-    width >>= 2;
-    height >>= 2;
-
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
-            FFSWAP(void*, sum0, sum1);
-            dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
-                               &ref[4 * z * ref_stride], ref_stride,
-                               sum0, width);
-        }
+    SSIMContext *s = ctx->priv;
+    SSIMDSPContext *dsp = &s->dsp;
+    ThreadData *td = arg;
+    int c;
+
+    for (c = 0; c < s->nb_components; c++) {
+        const int main_stride = td->main_linesize[c];
+        const int ref_stride = td->ref_linesize[c];
+        const uint8_t *main = td->main_data[c];
+        const uint8_t *ref = td->ref_data[c];
+        const int width = s->planewidth[c] >> 2;
+        const int height = s->planeheight[c] >> 2;
+        const int slice_start = 1 + ((height - 1) * jobnr) / nb_jobs;
+        const int slice_end = 1 + ((height - 1) * (jobnr+1)) / nb_jobs;
+        int (*sum0)[4] = (void *)(s->temp + jobnr * s->temp_size);
+        int (*sum1)[4] = sum0 + s->temp_size / (2 * sizeof(*sum0));
+        int z = slice_start - 1, y;
+
+        for (y = slice_start; y < slice_end; y++) {
+            for (; z <= y; z++) {
+                FFSWAP(void*, sum0, sum1);
+                dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
+                                   &ref[4 * z * ref_stride], ref_stride,
+                                   sum0, width);
+            }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+            s->score[c][y] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        }
     }
 
-    return ssim / ((height - 1) * (width - 1));
+    return 0;
 }
 
 static double ssim_db(double ssim, double weight)
@@ -289,7 +324,8 @@ static int do_ssim(FFFrameSync *fs)
     AVFrame *master, *ref;
     AVDictionary **metadata;
     float c[4], ssimv = 0.0;
-    int ret, i;
+    ThreadData td;
+    int ret, i, y;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
     if (ret < 0)
@@ -301,10 +337,23 @@ static int do_ssim(FFFrameSync *fs)
     s->nb_frames++;
 
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = s->ssim_plane(&s->dsp, master->data[i], master->linesize[i],
-                             ref->data[i], ref->linesize[i],
-                             s->planewidth[i], s->planeheight[i], s->temp,
-                             s->max);
+        td.main_data[i] = master->data[i];
+        td.ref_data[i] = ref->data[i];
+        td.main_linesize[i] = master->linesize[i];
+        td.ref_linesize[i] = ref->linesize[i];
+    }
+
+    ctx->internal->execute(ctx, s->ssim_plane, &td, NULL,
+                           av_clip((s->planeheight[1] >> 2) - 1, 1, s->nb_threads));
+
+    for (i = 0; i < s->nb_components; i++) {
+        const int width = s->planewidth[i] >> 2;
+        const int height = s->planeheight[i] >> 2;
+        float ssim = 0.0;
+
+        for (y = 1; y < height; y++)
+            ssim += s->score[i][y];
+        c[i] = ssim / ((height - 1) * (width - 1));
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -410,16 +459,22 @@ static int config_input_ref(AVFilterLink *inlink)
     for (i = 0; i < s->nb_components; i++)
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
 
-    s->temp = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp_size = 2 * SUM_LEN(inlink->w) * ((desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    av_freep(&s->temp);
+    s->temp = av_mallocz_array(s->nb_threads, s->temp_size);
     if (!s->temp)
         return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_components; i++) {
+        av_freep(&s->score[i]);
+        s->score[i] = av_calloc(s->planeheight[i] >> 2, sizeof(*s->score[i]));
+        if (!s->score[i])
+            return AVERROR(ENOMEM);
+    }
     s->max = (1 << desc->comp[0].depth) - 1;
 
     s->ssim_plane = desc->comp[0].depth > 8 ? ssim_plane_16bit : ssim_plane;
-    s->dsp.ssim_4x4_line = ssim_4x4xn_8bit;
-    s->dsp.ssim_end_line = ssim_endn_8bit;
-    if (ARCH_X86)
-        ff_ssim_init_x86(&s->dsp);
+    ff_ssim_init(&s->dsp);
 
     return 0;
 }
@@ -483,6 +538,8 @@ static av_cold void uninit(AVFilterContext *ctx)
         fclose(s->stats_file);
 
     av_freep(&s->temp);
+    for (int i = 0; i < 4; i++)
+        av_freep(&s->score[i]);
 }
 
 static const AVFilterPad ssim_inputs[] = {
@@ -518,4 +575,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -28,6 +28,7 @@
 #include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -36,18 +37,15 @@
 #define BUFFER_ALIGN 32
 
 
-AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
-{
-    return ff_get_video_buffer(link->dst->outputs[0], w, h);
-}
-
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     AVFrame *frame = NULL;
     int pool_width = 0;
     int pool_height = 0;
     int pool_align = 0;
     enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
+    int left = 0, top = 0, full_w = w, full_h = h;
 
     if (link->hw_frames_ctx &&
         ((AVHWFramesContext*)link->hw_frames_ctx->data)->format == link->format) {
@@ -64,9 +62,18 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
         return frame;
     }
 
+    /* allocate the picture with its border and return a view of it */
+    if (desc && !(desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+        left    = link->border[0];
+        top     = link->border[1];
+        full_w += left + link->border[2];
+        full_h += top  + link->border[3];
+    }
+
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                    link->format, BUFFER_ALIGN);
+        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, full_w, full_h,
+                                                    link->format, BUFFER_ALIGN,
+                                                    link->dst->graph->frame_pool_flags);
         if (!link->frame_pool)
             return NULL;
     } else {
@@ -76,12 +83,13 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
             return NULL;
         }
 
-        if (pool_width != w || pool_height != h ||
+        if (pool_width != full_w || pool_height != full_h ||
             pool_format != link->format || pool_align != BUFFER_ALIGN) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                        link->format, BUFFER_ALIGN);
+            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, full_w, full_h,
+                                                        link->format, BUFFER_ALIGN,
+                                                        link->dst->graph->frame_pool_flags);
             if (!link->frame_pool)
                 return NULL;
         }
@@ -91,12 +99,25 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     if (!frame)
         return NULL;
 
+    if (left || top) {
+        int max_step[4], planes = av_pix_fmt_count_planes(link->format);
+
+        av_image_fill_max_pixsteps(max_step, NULL, desc);
+        for (int i = 0; i < planes; i++) {
+            int hsub = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+            int vsub = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+            frame->data[i] += (left >> hsub) * max_step[i] +
+                              (top  >> vsub) * frame->linesize[i];
+        }
+    }
+    frame->width  = w;
+    frame->height = h;
     frame->sample_aspect_ratio = link->sample_aspect_ratio;
 
     return frame;
 }
 
-AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
+static AVFrame *get_video_buffer(AVFilterLink *link, int w, int h)
 {
     AVFrame *ret = NULL;
 
@@ -110,3 +131,18 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 
     return ret;
 }
+
+AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
+{
+    /* accounted to the filter asking for the frame, not to this one */
+    return get_video_buffer(link->dst->outputs[0], w, h);
+}
+
+AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
+{
+    AVFrame *ret = get_video_buffer(link, w, h);
+
+    ff_filter_profile_alloc(link->src, ret);
+
+    return ret;
+}
@@ -16,9 +16,20 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_SYS_MBIND
+#include <sys/syscall.h>
+#endif
 
 #include "avassert.h"
 #include "buffer_internal.h"
@@ -225,6 +236,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    atomic_init(&pool->head, POOL_EMPTY);
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -243,6 +255,7 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    atomic_init(&pool->head, POOL_EMPTY);
 
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
@@ -252,19 +265,26 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     return pool;
 }
 
+static BufferPoolEntry *pool_entry(AVBufferPool *pool, unsigned index)
+{
+    int chunk = av_log2(index + 1);
+    return &pool->chunks[chunk][index + 1 - (1U << chunk)];
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    unsigned i;
 
+    for (i = 0; i < pool->nb_entries; i++) {
+        BufferPoolEntry *buf = pool_entry(pool, i);
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
     }
+    for (i = 0; i < POOL_MAX_CHUNKS; i++)
+        av_freep(&pool->chunks[i]);
     ff_mutex_destroy(&pool->mutex);
 
     if (pool->pool_free)
@@ -286,6 +306,69 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+#if POOL_LOCKFREE
+#define HEAD_INDEX(head)        ((unsigned)((head) & UINT32_MAX))
+#define HEAD(index, prev_head)  ((((prev_head) >> 32) + 1) << 32 | (index))
+
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    uintptr_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    uintptr_t next;
+    BufferPoolEntry *buf;
+
+    /* The entry can be popped and pushed back by other threads while its
+     * next index is read, the counter then makes the exchange fail. */
+    do {
+        if (HEAD_INDEX(head) == POOL_EMPTY)
+            return NULL;
+        buf  = pool_entry(pool, HEAD_INDEX(head));
+        next = HEAD(atomic_load_explicit(&buf->next, memory_order_relaxed), head);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, next,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+    return buf;
+}
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    uintptr_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+
+    do {
+        atomic_store_explicit(&buf->next, HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head,
+                                                    HEAD(buf->index, head),
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+#else
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf = NULL;
+    unsigned head;
+
+    ff_mutex_lock(&pool->mutex);
+    head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    if (head != POOL_EMPTY) {
+        buf = pool_entry(pool, head);
+        atomic_store_explicit(&pool->head,
+                              atomic_load_explicit(&buf->next, memory_order_relaxed),
+                              memory_order_relaxed);
+    }
+    ff_mutex_unlock(&pool->mutex);
+    return buf;
+}
+
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    ff_mutex_lock(&pool->mutex);
+    atomic_store_explicit(&buf->next,
+                          atomic_load_explicit(&pool->head, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&pool->head, buf->index, memory_order_relaxed);
+    ff_mutex_unlock(&pool->mutex);
+}
+#endif
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
@@ -294,42 +377,146 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
 }
 
+void av_buffer_pool_set_flags(AVBufferPool *pool, int flags)
+{
+    ff_mutex_lock(&pool->mutex);
+    pool->flags = flags;
+    ff_mutex_unlock(&pool->mutex);
+}
+
+#if HAVE_MMAP && HAVE_MAP_ANONYMOUS
+/* the size of the huge pages on most architectures, mappings of explicit
+ * huge pages of another size fail and fall back to transparent ones */
+#define HUGE_PAGE_SIZE (2 << 20)
+
+#if HAVE_SYS_MBIND
+static void bind_local_node(void *data, size_t size)
+{
+    /* MPOL_PREFERRED from linux/mempolicy.h */
+    const int mode = 1;
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+    unsigned cpu, node;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) < 0 || node >= 8 * sizeof(mask))
+        return;
+    mask[node / (8 * sizeof(*mask))] = 1UL << (node % (8 * sizeof(*mask)));
+    syscall(SYS_mbind, data, size, mode, mask, 8 * sizeof(mask), 0);
+}
+#else
+static void bind_local_node(void *data, size_t size)
+{
+}
+#endif
+
+static void pool_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+static AVBufferRef *pool_map_buffer(int size, int flags)
+{
+    size_t page_size = 4096, len;
+    uint8_t *data = MAP_FAILED;
+    AVBufferRef *ret;
+
+#if HAVE_SYSCONF && defined(_SC_PAGESIZE)
+    page_size = FFMAX(sysconf(_SC_PAGESIZE), 1);
+#endif
+    len = FFALIGN((size_t)size, page_size);
+
+    if (flags & AV_BUFFER_POOL_FLAG_HUGE_PAGES && size >= HUGE_PAGE_SIZE) {
+#if HAVE_MAP_HUGETLB
+        data = mmap(NULL, FFALIGN(len, HUGE_PAGE_SIZE), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED)
+            len = FFALIGN(len, HUGE_PAGE_SIZE);
+#endif
+        if (data == MAP_FAILED) {
+            /* map more to align the start on a huge page, so that the
+             * kernel can back the buffer with transparent ones */
+            uint8_t *map = mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map != MAP_FAILED) {
+                size_t head = FFALIGN((uintptr_t)map, HUGE_PAGE_SIZE) - (uintptr_t)map;
+                data = map + head;
+                if (head)
+                    munmap(map, head);
+                munmap(data + len, HUGE_PAGE_SIZE - head);
+#if HAVE_MADV_HUGEPAGE
+                madvise(data, len, MADV_HUGEPAGE);
+#endif
+            }
+        }
+    }
+    if (data == MAP_FAILED)
+        data = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    /* before anything touches the pages */
+    if (flags & AV_BUFFER_POOL_FLAG_NUMA_LOCAL)
+        bind_local_node(data, len);
+
+    ret = av_buffer_create(data, size, pool_unmap, (void *)(uintptr_t)len, 0);
+    if (!ret)
+        munmap(data, len);
+    return ret;
+}
+#else
+static AVBufferRef *pool_map_buffer(int size, int flags)
+{
+    return NULL;
+}
+#endif
+
 /* allocate a new buffer and override its free() callback so that
  * it is returned to the pool on free */
 static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
+    int chunk;
 
-    ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
-                         pool->alloc(pool->size);
-    if (!ret)
-        return NULL;
+    ff_mutex_lock(&pool->mutex);
 
-    buf = av_mallocz(sizeof(*buf));
-    if (!buf) {
-        av_buffer_unref(&ret);
-        return NULL;
+    if (pool->nb_entries == POOL_EMPTY)
+        goto fail;
+    chunk = av_log2(pool->nb_entries + 1);
+    if (!pool->chunks[chunk]) {
+        pool->chunks[chunk] = av_calloc(1U << chunk, sizeof(*pool->chunks[chunk]));
+        if (!pool->chunks[chunk])
+            goto fail;
     }
 
+    ret = pool->flags ? pool_map_buffer(pool->size, pool->flags) : NULL;
+    if (!ret)
+        ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
+                             pool->alloc(pool->size);
+    if (!ret)
+        goto fail;
+
+    buf = pool_entry(pool, pool->nb_entries);
     buf->data   = ret->buffer->data;
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
+    buf->index  = pool->nb_entries++;
 
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
 
+    ff_mutex_unlock(&pool->mutex);
     return ret;
+fail:
+    ff_mutex_unlock(&pool->mutex);
+    return NULL;
 }
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
@@ -337,19 +524,15 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
-        }
+        if (!ret)
+            pool_push(pool, buf);
     } else {
         ret = pool_alloc_buffer(pool);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -266,6 +266,38 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, int size),
                                    void (*pool_free)(void *opaque));
 
+/**
+ * @defgroup lavu_bufferpool_flags Buffer pool allocation flags
+ * Flags for av_buffer_pool_set_flags().
+ * @{
+ */
+/**
+ * Back the buffers with huge pages: explicit ones (hugetlbfs) for buffers
+ * of at least one huge page if some are reserved, transparent ones
+ * otherwise.
+ */
+#define AV_BUFFER_POOL_FLAG_HUGE_PAGES (1 << 0)
+/**
+ * Allocate the buffers on the NUMA node the allocating thread runs on,
+ * if it has free memory. Buffers are allocated by the first thread which
+ * finds the pool empty, usually the one producing the frames.
+ */
+#define AV_BUFFER_POOL_FLAG_NUMA_LOCAL (1 << 1)
+/**
+ * @}
+ */
+
+/**
+ * Make the pool map the memory of the buffers it allocates from now on
+ * itself, according to flags, rather than calling its allocation function.
+ * The buffers in the pool are not affected. The allocation function is still
+ * used where mapping memory is not supported or fails.
+ *
+ * @param flags a combination of AV_BUFFER_POOL_FLAG_*, 0 to only use the
+ *              allocation function again
+ */
+void av_buffer_pool_set_flags(AVBufferPool *pool, int flags);
+
 /**
  * Mark the pool as being available for freeing. It will actually be freed only
  * once all the allocated buffers associated with the pool are released. Thus it
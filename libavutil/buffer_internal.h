@@ -70,12 +70,42 @@ typedef struct BufferPoolEntry {
     void (*free)(void *opaque, uint8_t *data);
 
     AVBufferPool *pool;
-    struct BufferPoolEntry *next;
+
+    /* index of this entry and of the next one in the free list */
+    unsigned index;
+    atomic_uint next;
 } BufferPoolEntry;
 
+/*
+ * Pools with pointer sized atomics large enough to pack an entry index with
+ * a counter protecting against ABA get and release their buffers without
+ * taking the mutex.
+ */
+#define POOL_LOCKFREE (UINTPTR_MAX > UINT32_MAX)
+
+#define POOL_MAX_CHUNKS 32
+
+/* index of the top of an empty free list */
+#define POOL_EMPTY UINT32_MAX
+
 struct AVBufferPool {
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /*
+     * Free list of the entries, as a stack. The low 32 bits of the head
+     * are the index of the top entry, the high bits a counter bumped by
+     * every update of the head (only with POOL_LOCKFREE).
+     */
+    atomic_uintptr_t head;
+
+    /*
+     * The entries are allocated in chunks which are never moved, so that
+     * an index read from the free list maps to an entry without locking.
+     * chunks[i] holds entries (1 << i) - 1 to (2 << i) - 2.
+     * Only grown with the mutex held.
+     */
+    BufferPoolEntry *chunks[POOL_MAX_CHUNKS];
+    unsigned nb_entries;
 
     /*
      * This is used to track when the pool is to be freed.
@@ -89,6 +119,7 @@ struct AVBufferPool {
     atomic_uint refcount;
 
     int size;
+    int flags;                  ///< AV_BUFFER_POOL_FLAG_*, under the mutex
     void *opaque;
     AVBufferRef* (*alloc)(int size);
     AVBufferRef* (*alloc2)(void *opaque, int size);
@@ -0,0 +1,189 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program hammers one AVBufferPool from several threads, checking
+ * that no buffer is handed out twice and that the buffers are reused.
+ * With -f the pool maps its buffers with the given AV_BUFFER_POOL_FLAG_*.
+ * With -b it reports the get/unref throughput.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/buffer_internal.h"
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define MAX_THREADS 64
+#define MAX_HELD     4
+#define BUF_SIZE    64
+
+typedef struct ThreadData {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadData;
+
+static void *thread_main(void *arg)
+{
+    ThreadData *td = arg;
+    AVBufferRef *held[MAX_HELD];
+    unsigned seed = td->id;
+    int i, j;
+
+    for (i = 0; i < td->iterations; i++) {
+        int nb_held = 1 + (seed = seed * 1664525 + 1013904223) % MAX_HELD;
+
+        for (j = 0; j < nb_held; j++) {
+            held[j] = av_buffer_pool_get(td->pool);
+            if (!held[j]) {
+                td->errors++;
+                nb_held = j;
+                break;
+            }
+            memset(held[j]->data, td->id, BUF_SIZE);
+            AV_WN32(held[j]->data, i);
+        }
+        /* a buffer handed out to another thread too would be overwritten */
+        for (j = 0; j < nb_held; j++) {
+            if (AV_RN32(held[j]->data) != i ||
+                held[j]->data[BUF_SIZE - 1] != (uint8_t)td->id)
+                td->errors++;
+            av_buffer_unref(&held[j]);
+        }
+    }
+    return NULL;
+}
+
+/* buffers larger than a huge page, which take the huge page paths */
+static int test_large_buffers(int flags)
+{
+    static const int sizes[] = { 3 << 20, (4 << 20) + 1 };
+    int i, round, errors = 0;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        AVBufferPool *pool = av_buffer_pool_init(sizes[i], NULL);
+        if (!pool)
+            return 1;
+        av_buffer_pool_set_flags(pool, flags);
+
+        /* the second round reuses the buffers of the first one */
+        for (round = 0; round < 2; round++) {
+            AVBufferRef *a = av_buffer_pool_get(pool);
+            AVBufferRef *b = av_buffer_pool_get(pool);
+
+            if (a && b && a->size == sizes[i] && b->size == sizes[i]) {
+                memset(a->data, 2 * round,     sizes[i]);
+                memset(b->data, 2 * round + 1, sizes[i]);
+                if (a->data[sizes[i] - 1] != 2 * round || b->data[0] != 2 * round + 1)
+                    errors++;
+            } else {
+                errors++;
+            }
+            av_buffer_unref(&a);
+            av_buffer_unref(&b);
+        }
+        av_buffer_pool_uninit(&pool);
+    }
+    if (errors)
+        fprintf(stderr, "%d large buffers were corrupted or not allocated\n", errors);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    ThreadData td[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    AVBufferPool *pool;
+    AVBufferRef *last;
+    int nb_threads = 4, iterations = 100000, bench = 0, flags = 0;
+    int i, ret, errors = 0;
+    int64_t t;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-b"))
+            bench = 1;
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            nb_threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+            flags = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [-b] [-t threads] [-n iterations] [-f flags]\n", argv[0]);
+            return 1;
+        }
+    }
+    nb_threads = av_clip(nb_threads, 1, MAX_THREADS);
+    iterations = FFMAX(iterations, 1);
+
+    if (flags && test_large_buffers(flags))
+        return 2;
+
+    pool = av_buffer_pool_init(BUF_SIZE, NULL);
+    if (!pool)
+        return 1;
+    av_buffer_pool_set_flags(pool, flags);
+
+    t = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        td[i].pool       = pool;
+        td[i].id         = i + 1;
+        td[i].iterations = iterations;
+        td[i].errors     = 0;
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &td[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += td[i].errors;
+    }
+    t = av_gettime_relative() - t;
+
+    if (errors) {
+        fprintf(stderr, "%d buffers were corrupted or not allocated\n", errors);
+        return 2;
+    }
+    /* every thread holds at most MAX_HELD buffers at a time */
+    if (pool->nb_entries > nb_threads * MAX_HELD) {
+        fprintf(stderr, "%u buffers allocated, at most %d expected\n",
+                pool->nb_entries, nb_threads * MAX_HELD);
+        return 3;
+    }
+    if (bench)
+        printf("%d threads: %.1f ns per get/unref in each thread (%s)\n",
+               nb_threads, t * 1000.0 / (iterations * (MAX_HELD + 1) / 2.0),
+               POOL_LOCKFREE ? "lock-free" : "mutex");
+
+    /* the pool outlives its uninit until the last buffer is returned */
+    last = av_buffer_pool_get(pool);
+    av_buffer_pool_uninit(&pool);
+    if (!last)
+        return 1;
+    av_buffer_unref(&last);
+
+    return 0;
+}
@@ -234,14 +234,20 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
+/* When dstSliceY/dstSliceH do not cover the whole destination, the whole
+ * source must be given and only the lines of that band are output, dst
+ * pointing to the first line of the band. */
 static int swscale(SwsContext *c, const uint8_t *src[],
                    int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+                   int srcSliceH, uint8_t *dst[], int dstStride[],
+                   int dstSliceY, int dstSliceH)
 {
+    const int scale_dst = dstSliceY > 0 || dstSliceH < c->dstH;
+
     /* load a few things into local vars to make the code more readable?
      * and faster */
     const int dstW                   = c->dstW;
-    const int dstH                   = c->dstH;
+    int dstH                         = c->dstH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -286,6 +292,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
 
     int hasLumHoles = 1;
     int hasChrHoles = 1;
+    uint8_t *band_dst[4] = { NULL };
 
     if (isPacked(c->srcFormat)) {
         src[1] =
@@ -342,6 +349,10 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
+    if (scale_dst) {
+        dstY = dstSliceY;
+        dstH = dstSliceY + dstSliceH;
+    }
 
     if (!should_dither) {
         c->chrDither8 = c->lumDither8 = sws_pb_64;
@@ -354,9 +365,14 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     ff_init_slice_from_src(src_slice, (uint8_t**)src, srcStride, c->srcW,
             srcSliceY, srcSliceH, chrSrcSliceY, chrSrcSliceH, 1);
 
-    ff_init_slice_from_src(vout_slice, (uint8_t**)dst, dstStride, c->dstW,
-            dstY, dstH, dstY >> c->chrDstVSubSample,
-            AV_CEIL_RSHIFT(dstH, c->chrDstVSubSample), 0);
+    if (scale_dst)
+        ff_init_slice_from_src(vout_slice, (uint8_t**)dst, dstStride, c->dstW,
+                dstY, dstSliceH, dstY >> c->chrDstVSubSample,
+                AV_CEIL_RSHIFT(dstSliceH, c->chrDstVSubSample), 1);
+    else
+        ff_init_slice_from_src(vout_slice, (uint8_t**)dst, dstStride, c->dstW,
+                dstY, dstH, dstY >> c->chrDstVSubSample,
+                AV_CEIL_RSHIFT(dstH, c->chrDstVSubSample), 0);
     if (srcSliceY == 0) {
         hout_slice->plane[0].sliceY = lastInLumBuf + 1;
         hout_slice->plane[1].sliceY = lastInChrBuf + 1;
@@ -488,7 +504,21 @@ static int swscale(SwsContext *c, const uint8_t *src[],
             c->chrDither8 = ff_dither_8x8_128[chrDstY & 7];
             c->lumDither8 = ff_dither_8x8_128[dstY    & 7];
         }
-        if (dstY >= dstH - 2) {
+        if (dstY >= dstH - 2 && dstH < c->dstH) {
+            /* the output functions may write past the end of the lines,
+             * into the first lines of the next band, which is scaled
+             * concurrently, so output these lines in a temporary buffer */
+            for (i = 0; i < 4; i++) {
+                SwsPlane *plane = &vout_slice->plane[i];
+                const int y = (i == 1 || i == 2) ? chrDstY : dstY;
+
+                if (!c->dst_slice_tmp[i])
+                    continue;
+                band_dst[i] = plane->line[y - plane->sliceY];
+                memcpy(c->dst_slice_tmp[i], band_dst[i], c->dst_slice_tmp_size[i]);
+                plane->line[y - plane->sliceY] = c->dst_slice_tmp[i];
+            }
+        } else if (dstY >= dstH - 2) {
             /* hmm looks like we can't use MMX here without overwriting
              * this array's tail */
             ff_sws_init_output_funcs(c, &yuv2plane1, &yuv2planeX, &yuv2nv12cX,
@@ -502,18 +532,30 @@ static int swscale(SwsContext *c, const uint8_t *src[],
             for (i = vStart; i < vEnd; ++i)
                 desc[i].process(c, &desc[i], dstY, 1);
         }
+
+        for (i = 0; i < 4; i++) {
+            SwsPlane *plane = &vout_slice->plane[i];
+            const int y = (i == 1 || i == 2) ? chrDstY : dstY;
+
+            if (!band_dst[i])
+                continue;
+            memcpy(band_dst[i], c->dst_slice_tmp[i], c->dst_slice_tmp_size[i]);
+            plane->line[y - plane->sliceY] = band_dst[i];
+            band_dst[i] = NULL;
+        }
     }
     if (isPlanar(dstFormat) && isALPHA(dstFormat) && !needAlpha) {
         int length = dstW;
         int height = dstY - lastDstY;
+        int offset = scale_dst ? lastDstY - dstSliceY : lastDstY;
 
         if (is16BPS(dstFormat) || isNBPS(dstFormat)) {
             const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dstFormat);
-            fillPlane16(dst[3], dstStride[3], length, height, lastDstY,
+            fillPlane16(dst[3], dstStride[3], length, height, offset,
                     1, desc->comp[3].depth,
                     isBE(dstFormat));
         } else
-            fillPlane(dst[3], dstStride[3], length, height, lastDstY, 255);
+            fillPlane(dst[3], dstStride[3], length, height, offset, 255);
     }
 
 #if HAVE_MMXEXT_INLINE
@@ -532,6 +574,14 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale_slice(SwsContext *c, const uint8_t *src[],
+                         int srcStride[], int srcSliceY,
+                         int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return swscale(c, src, srcStride, srcSliceY, srcSliceH,
+                   dst, dstStride, 0, c->dstH);
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -602,7 +652,7 @@ SwsFunc ff_getSwsFunc(SwsContext *c)
     if (ARCH_ARM)
         ff_sws_init_swscale_arm(c);
 
-    return swscale;
+    return swscale_slice;
 }
 
 static void reset_ptr(const uint8_t *src[], enum AVPixelFormat format)
@@ -747,15 +797,18 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
 }
 
 /**
- * swscale wrapper, so we don't need to export the SwsContext.
- * Assumes planar YUV to be in YUV order instead of YVU.
+ * Scale a source slice, or the whole source into a band of destination
+ * lines starting at dstSliceY, in which case dst points to the first line
+ * of the band.
  */
-int attribute_align_arg sws_scale(struct SwsContext *c,
-                                  const uint8_t * const srcSlice[],
-                                  const int srcStride[], int srcSliceY,
-                                  int srcSliceH, uint8_t *const dst[],
-                                  const int dstStride[])
+static int scale_internal(SwsContext *c,
+                          const uint8_t * const srcSlice[],
+                          const int srcStride[], int srcSliceY,
+                          int srcSliceH, uint8_t *const dst[],
+                          const int dstStride[], int dstSliceY,
+                          int dstSliceH)
 {
+    const int scale_dst = dstSliceY > 0 || dstSliceH < c->dstH;
     int i, ret;
     const uint8_t *src2[4];
     uint8_t *dst2[4];
@@ -835,12 +888,16 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         return 0;
     }
 
-    if (c->sliceDir == 0 && srcSliceY != 0 && srcSliceY + srcSliceH != c->srcH) {
-        av_log(c, AV_LOG_ERROR, "Slices start in the middle!\n");
-        return 0;
-    }
-    if (c->sliceDir == 0) {
-        if (srcSliceY == 0) c->sliceDir = 1; else c->sliceDir = -1;
+    if (scale_dst) {
+        av_assert0(srcSliceY == 0 && srcSliceH == c->srcH);
+    } else {
+        if (c->sliceDir == 0 && srcSliceY != 0 && srcSliceY + srcSliceH != c->srcH) {
+            av_log(c, AV_LOG_ERROR, "Slices start in the middle!\n");
+            return 0;
+        }
+        if (c->sliceDir == 0) {
+            if (srcSliceY == 0) c->sliceDir = 1; else c->sliceDir = -1;
+        }
     }
 
     if (usePal(c->srcFormat)) {
@@ -950,7 +1007,7 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         for (i = 0; i < 4; i++)
             memset(c->dither_error[i], 0, sizeof(c->dither_error[0][0]) * (c->dstW+2));
 
-    if (c->sliceDir != 1) {
+    if (!scale_dst && c->sliceDir != 1) {
         // slices go from bottom to top => we flip the image internally
         for (i=0; i<4; i++) {
             srcStride2[i] *= -1;
@@ -972,10 +1029,25 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     reset_ptr(src2, c->srcFormat);
     reset_ptr((void*)dst2, c->dstFormat);
 
-    /* reset slice direction at end of frame */
-    if (srcSliceY_internal + srcSliceH == c->srcH)
-        c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (scale_dst && c->swscale == swscale_slice) {
+        ret = swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH,
+                      dst2, dstStride2, dstSliceY, dstSliceH);
+    } else if (scale_dst) {
+        /* unscaled converters output the lines of the source slice they are
+         * given, so give them the band as a source slice */
+        for (i = 0; i < 4; i++) {
+            if (src2[i] && !(i == 1 && usePal(c->srcFormat)))
+                src2[i] += (dstSliceY >> ((i == 1 || i == 2) ? c->chrSrcVSubSample : 0)) * srcStride2[i];
+            if (dst2[i])
+                dst2[i] -= (dstSliceY >> ((i == 1 || i == 2) ? c->chrDstVSubSample : 0)) * dstStride2[i];
+        }
+        ret = c->swscale(c, src2, srcStride2, dstSliceY, dstSliceH, dst2, dstStride2);
+    } else {
+        /* reset slice direction at end of frame */
+        if (srcSliceY_internal + srcSliceH == c->srcH)
+            c->sliceDir = 0;
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    }
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
         int dstY = c->dstY ? c->dstY : srcSliceY + srcSliceH;
@@ -991,3 +1063,82 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     av_free(rgb0_tmp);
     return ret;
 }
+
+static void scale_slice_worker(void *priv, int jobnr, int threadnr,
+                               int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext      *c = parent->slice_ctx[threadnr];
+    const int nb_planes    = av_pix_fmt_count_planes(c->dstFormat);
+    const int slice_height = FFALIGN((c->dstH + nb_jobs - 1) / nb_jobs,
+                                     parent->dst_slice_align);
+    const int slice_start  = jobnr * slice_height;
+    const int slice_end    = FFMIN(slice_start + slice_height, c->dstH);
+    uint8_t *dst[4];
+    int i;
+
+    parent->slice_err[jobnr] = 0;
+    if (slice_end <= slice_start)
+        return;
+
+    for (i = 0; i < 4; i++) {
+        const int vshift = (i == 1 || i == 2) ? c->chrDstVSubSample : 0;
+        dst[i] = parent->frame_dst[i];
+        if (i < nb_planes && dst[i])
+            dst[i] += (ptrdiff_t)parent->frame_dstStride[i] * (slice_start >> vshift);
+    }
+
+    parent->slice_err[jobnr] = scale_internal(c, parent->frame_src, parent->frame_srcStride,
+                                              0, c->srcH, dst, parent->frame_dstStride,
+                                              slice_start, slice_end - slice_start);
+}
+
+int ff_sws_init_slice_threads(SwsContext *c)
+{
+    int ret = avpriv_slicethread_create(&c->slicethread, c, scale_slice_worker,
+                                        NULL, c->nb_threads);
+    if (ret == AVERROR(ENOSYS))
+        return 1;
+    return ret;
+}
+
+/**
+ * swscale wrapper, so we don't need to export the SwsContext.
+ * Assumes planar YUV to be in YUV order instead of YVU.
+ */
+int attribute_align_arg sws_scale(struct SwsContext *c,
+                                  const uint8_t * const srcSlice[],
+                                  const int srcStride[], int srcSliceY,
+                                  int srcSliceH, uint8_t *const dst[],
+                                  const int dstStride[])
+{
+    if (c->nb_slice_ctx) {
+        const SwsContext *s = c->slice_ctx[0];
+        /* only whole pictures are split across the threads, the bands all
+         * need the whole source; unscaled converters resampling chroma
+         * vertically read across the band edges */
+        if (c->slicethread && srcSlice && srcStride && dst && dstStride &&
+            srcSliceY == 0 && srcSliceH == c->srcH &&
+            (s->swscale == swscale_slice ||
+             s->chrSrcVSubSample == s->chrDstVSubSample)) {
+            int i, ret = 0;
+
+            c->frame_src       = srcSlice;
+            c->frame_srcStride = srcStride;
+            c->frame_dst       = dst;
+            c->frame_dstStride = dstStride;
+            avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx, 0);
+
+            for (i = 0; i < c->nb_slice_ctx; i++) {
+                if (c->slice_err[i] < 0)
+                    return c->slice_err[i];
+                ret += c->slice_err[i];
+            }
+            return ret;
+        }
+        c = c->slice_ctx[0];
+    }
+
+    return scale_internal(c, srcSlice, srcStride, srcSliceY, srcSliceH,
+                          dst, dstStride, 0, c->dstH);
+}
@@ -162,6 +162,14 @@ int sws_init_context(struct SwsContext *sws_context, SwsFilter *srcFilter, SwsFi
  */
 void sws_freeContext(struct SwsContext *swsContext);
 
+/**
+ * Release the scaling filters kept by libswscale for reuse by later
+ * contexts. Only the filter coefficients are cached, never the other
+ * state of a context. The contexts still using a filter keep it until
+ * they are freed. This may be called at any time, e.g. before exiting.
+ */
+void sws_flush_filter_cache(void);
+
 /**
  * Allocate and return an SwsContext. You need it to perform
  * scaling/conversion operations using sws_scale().
@@ -26,11 +26,13 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/ppc/util_altivec.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
@@ -321,6 +323,22 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* The slice_* fields allow splitting the destination picture into bands
+     * of lines which are scaled in parallel, each one by its own context.
+     */
+    int nb_threads;               ///< Number of threads requested by the user, 0 for auto.
+    AVSliceThread *slicethread;
+    struct SwsContext **slice_ctx;
+    int *slice_err;
+    int nb_slice_ctx;
+    int dst_slice_align;          ///< Required alignment of the first line of a band.
+    uint8_t *dst_slice_tmp[4];    ///< Lines for the end of a band, which may be written past their end.
+    int dst_slice_tmp_size[4];    ///< Size in bytes of a line of each destination plane.
+    const uint8_t *const *frame_src;
+    const int *frame_srcStride;
+    uint8_t *const *frame_dst;
+    const int *frame_dstStride;
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -385,6 +403,13 @@ typedef struct SwsContext {
     int vChrFilterSize;           ///< Vertical   filter size for chroma     pixels.
     //@}
 
+    /**
+     * Filter cache entries backing hLum, hChr, vLum and vChr filters above,
+     * in that order. The filters are shared and must not be written to
+     * when set; NULL if the context owns its filters.
+     */
+    AVBufferRef *filter_buf[4];
+
     int lumMmxextFilterCodeSize;  ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code size for luma/alpha planes.
     int chrMmxextFilterCodeSize;  ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code size for chroma planes.
     uint8_t *lumMmxextFilterCode; ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code for luma/alpha planes.
@@ -858,6 +883,13 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Create the slice thread pool of c, with c->nb_threads threads.
+ *
+ * @return the number of threads on success, a negative error code otherwise
+ */
+int ff_sws_init_slice_threads(SwsContext *c);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
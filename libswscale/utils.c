@@ -49,6 +49,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libavutil/aarch64/cpu.h"
 #include "libavutil/ppc/cpu.h"
 #include "libavutil/x86/asm.h"
@@ -725,6 +726,169 @@ fail:
     return ret;
 }
 
+/* The computed filters are shared between all the contexts set up with the
+ * same parameters, as computing them dominates the context initialization
+ * and scalers tend to be created over and over for a few geometries.
+ * Only the filter coefficients and positions are cached, the rest of a
+ * context is set up each time. sws_flush_filter_cache() empties the cache. */
+#define FILTER_CACHE_SIZE 32
+
+typedef struct CachedFilter {
+    int16_t *filter;
+    int32_t *filterPos;
+    int filterSize;
+} CachedFilter;
+
+typedef struct FilterCacheEntry {
+    int xInc, srcW, dstW, filterAlign, one, flags, cpu_flags;
+    double param[2];
+    int srcPos, dstPos;
+    AVBufferRef *buf;           ///< CachedFilter, NULL for an empty slot
+    unsigned last_use;
+} FilterCacheEntry;
+
+static AVMutex filter_cache_mutex = AV_MUTEX_INITIALIZER;
+static FilterCacheEntry filter_cache[FILTER_CACHE_SIZE];
+static unsigned filter_cache_clock;
+
+static void free_cached_filter(void *opaque, uint8_t *data)
+{
+    CachedFilter *f = (CachedFilter *)data;
+
+    av_free(f->filter);
+    av_free(f->filterPos);
+    av_free(f);
+}
+
+static int same_filter_params(const FilterCacheEntry *a, const FilterCacheEntry *b)
+{
+    return a->xInc        == b->xInc        && a->srcW     == b->srcW     &&
+           a->dstW        == b->dstW        && a->one      == b->one      &&
+           a->filterAlign == b->filterAlign && a->flags    == b->flags    &&
+           a->cpu_flags   == b->cpu_flags   && a->srcPos   == b->srcPos   &&
+           a->dstPos      == b->dstPos      &&
+           a->param[0]    == b->param[0]    && a->param[1] == b->param[1];
+}
+
+/**
+ * initFilter() through the process-wide filter cache. On success *buf is
+ * set to the cache entry the returned filter belongs to, or left NULL if
+ * the filter could not be cached and is owned by the caller.
+ */
+static av_cold int init_filter_cached(AVBufferRef **buf,
+                                      int16_t **outFilter, int32_t **filterPos,
+                                      int *outFilterSize, int xInc, int srcW,
+                                      int dstW, int filterAlign, int one,
+                                      int flags, int cpu_flags,
+                                      SwsVector *srcFilter, SwsVector *dstFilter,
+                                      double param[2], int srcPos, int dstPos)
+{
+    FilterCacheEntry key = {
+        .xInc        = xInc,
+        .srcW        = srcW,
+        .dstW        = dstW,
+        .filterAlign = filterAlign,
+        .one         = one,
+        .flags       = flags,
+        .cpu_flags   = cpu_flags,
+        .param       = { param[0], param[1] },
+        .srcPos      = srcPos,
+        .dstPos      = dstPos,
+    };
+    FilterCacheEntry *victim = &filter_cache[0];
+    CachedFilter *f;
+    int i, ret;
+
+    *buf = NULL;
+
+    /* user supplied filter vectors are not part of the key */
+    if (srcFilter || dstFilter)
+        return initFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                          dstW, filterAlign, one, flags, cpu_flags,
+                          srcFilter, dstFilter, param, srcPos, dstPos);
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (i = 0; i < FILTER_CACHE_SIZE; i++) {
+        FilterCacheEntry *e = &filter_cache[i];
+        if (e->buf && same_filter_params(e, &key)) {
+            *buf = av_buffer_ref(e->buf);
+            e->last_use = ++filter_cache_clock;
+            break;
+        }
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    if (*buf) {
+        f              = (CachedFilter *)(*buf)->data;
+        *outFilter     = f->filter;
+        *filterPos     = f->filterPos;
+        *outFilterSize = f->filterSize;
+        return 0;
+    }
+
+    ret = initFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                     dstW, filterAlign, one, flags, cpu_flags,
+                     srcFilter, dstFilter, param, srcPos, dstPos);
+    if (ret < 0)
+        return ret;
+
+    /* failing to cache the filter is not an error, the context keeps it */
+    f = av_mallocz(sizeof(*f));
+    if (!f)
+        return 0;
+    *buf = av_buffer_create((uint8_t *)f, sizeof(*f), free_cached_filter,
+                            NULL, AV_BUFFER_FLAG_READONLY);
+    if (!*buf) {
+        av_free(f);
+        return 0;
+    }
+    f->filter     = *outFilter;
+    f->filterPos  = *filterPos;
+    f->filterSize = *outFilterSize;
+
+    key.buf = av_buffer_ref(*buf);
+    if (!key.buf)
+        return 0;
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (i = 0; i < FILTER_CACHE_SIZE; i++) {
+        FilterCacheEntry *e = &filter_cache[i];
+        if (!e->buf) {
+            victim = e;
+            break;
+        }
+        if (e->last_use < victim->last_use)
+            victim = e;
+    }
+    av_buffer_unref(&victim->buf);
+    key.last_use = ++filter_cache_clock;
+    *victim      = key;
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    return 0;
+}
+
+void sws_flush_filter_cache(void)
+{
+    int i;
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (i = 0; i < FILTER_CACHE_SIZE; i++)
+        av_buffer_unref(&filter_cache[i].buf);
+    ff_mutex_unlock(&filter_cache_mutex);
+}
+
+static void free_filter(AVBufferRef **buf, int16_t **filter, int32_t **filterPos)
+{
+    if (*buf) {
+        *filter    = NULL;
+        *filterPos = NULL;
+        av_buffer_unref(buf);
+    }
+    av_freep(filter);
+    av_freep(filterPos);
+}
+
 static void fill_rgb2yuv_table(SwsContext *c, const int table[4], int dstRange)
 {
     int64_t W, V, Z, Cy, Cu, Cv;
@@ -863,6 +1027,21 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
 
+    if (c->nb_slice_ctx) {
+        int i, ret = 0;
+        for (i = 0; i < c->nb_slice_ctx; i++) {
+            int err = sws_setColorspaceDetails(c->slice_ctx[i], inv_table,
+                                               srcRange, table, dstRange,
+                                               brightness, contrast, saturation);
+            if (err < 0)
+                ret = err;
+        }
+        /* scaling through cascaded contexts cannot be split in bands */
+        if (c->slice_ctx[0]->cascaded_context[0])
+            avpriv_slicethread_free(&c->slicethread);
+        return ret;
+    }
+
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
     desc_src = av_pix_fmt_desc_get(c->srcFormat);
@@ -997,6 +1176,11 @@ int sws_getColorspaceDetails(struct SwsContext *c, int **inv_table,
     if (!c )
         return -1;
 
+    if (c->nb_slice_ctx)
+        return sws_getColorspaceDetails(c->slice_ctx[0], inv_table, srcRange,
+                                        table, dstRange, brightness,
+                                        contrast, saturation);
+
     *inv_table  = c->srcColorspaceTable;
     *table      = c->dstColorspaceTable;
     *srcRange   = c->srcRange;
@@ -1162,6 +1346,91 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
+static int alloc_dst_slice_tmp(SwsContext *c)
+{
+    int i, ret = av_image_fill_linesizes(c->dst_slice_tmp_size, c->dstFormat, c->dstW);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < 4 && c->dst_slice_tmp_size[i]; i++) {
+        /* room for the largest SIMD stores past the end of the line */
+        c->dst_slice_tmp[i] = av_malloc(c->dst_slice_tmp_size[i] + 64);
+        if (!c->dst_slice_tmp[i])
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void free_slice_contexts(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    av_freep(&c->slice_err);
+    c->nb_slice_ctx = 0;
+}
+
+/**
+ * Set up one context per thread, each scaling a band of destination lines.
+ * c->slicethread is left NULL if the scaler cannot be split in bands.
+ */
+static av_cold int context_init_threaded(SwsContext *c,
+                                         SwsFilter *srcFilter,
+                                         SwsFilter *dstFilter)
+{
+    SwsContext *s;
+    int i, ret, nb_threads;
+
+    ret = ff_sws_init_slice_threads(c);
+    if (ret < 0)
+        return ret;
+    nb_threads = ret;
+    if (nb_threads == 1) {
+        avpriv_slicethread_free(&c->slicethread);
+        return 0;
+    }
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    c->slice_err = av_mallocz_array(nb_threads, sizeof(*c->slice_err));
+    if (!c->slice_ctx || !c->slice_err)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads; i++) {
+        c->slice_ctx[i] = sws_alloc_context();
+        if (!c->slice_ctx[i])
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+
+        ret = av_opt_copy(c->slice_ctx[i], c);
+        if (ret < 0)
+            return ret;
+        c->slice_ctx[i]->nb_threads = 1;
+
+        ret = sws_init_context(c->slice_ctx[i], srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+        ret = alloc_dst_slice_tmp(c->slice_ctx[i]);
+        if (ret < 0)
+            return ret;
+
+        s = c->slice_ctx[0];
+        /* the bands of these are not independent */
+        if (s->cascaded_context[0] || s->srcXYZ || s->dstXYZ ||
+            s->dither == SWS_DITHER_ED || isBayer(s->srcFormat)) {
+            avpriv_slicethread_free(&c->slicethread);
+            return 0;
+        }
+    }
+
+    s = c->slice_ctx[0];
+    c->dst_slice_align = 1 << FFMAX(s->chrSrcVSubSample, s->chrDstVSubSample);
+
+    return 0;
+}
+
 av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                              SwsFilter *dstFilter)
 {
@@ -1183,6 +1452,13 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     enum AVPixelFormat tmpFmt;
     static const float float_mult = 1.0f / 255.0f;
 
+    if (c->nb_threads != 1) {
+        ret = context_init_threaded(c, srcFilter, dstFilter);
+        if (ret < 0 || c->slicethread)
+            return ret;
+        free_slice_contexts(c);
+    }
+
     cpu_flags = av_get_cpu_flags();
     flags     = c->flags;
     emms_c();
@@ -1673,7 +1949,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                                     PPC_ALTIVEC(cpu_flags) ? 8 :
                                     have_neon(cpu_flags)   ? 8 : 1;
 
-            if ((ret = initFilter(&c->hLumFilter, &c->hLumFilterPos,
+            if ((ret = init_filter_cached(&c->filter_buf[0], &c->hLumFilter, &c->hLumFilterPos,
                            &c->hLumFilterSize, c->lumXInc,
                            srcW, dstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
@@ -1682,7 +1958,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                            get_local_pos(c, 0, 0, 0),
                            get_local_pos(c, 0, 0, 0))) < 0)
                 goto fail;
-            if ((ret = initFilter(&c->hChrFilter, &c->hChrFilterPos,
+            if ((ret = init_filter_cached(&c->filter_buf[1], &c->hChrFilter, &c->hChrFilterPos,
                            &c->hChrFilterSize, c->chrXInc,
                            c->chrSrcW, c->chrDstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -1700,7 +1976,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                                 PPC_ALTIVEC(cpu_flags) ? 8 :
                                 have_neon(cpu_flags)   ? 2 : 1;
 
-        if ((ret = initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
+        if ((ret = init_filter_cached(&c->filter_buf[2], &c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
                        c->lumYInc, srcH, dstH, filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                        cpu_flags, srcFilter->lumV, dstFilter->lumV,
@@ -1708,7 +1984,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                        get_local_pos(c, 0, 0, 1),
                        get_local_pos(c, 0, 0, 1))) < 0)
             goto fail;
-        if ((ret = initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
+        if ((ret = init_filter_cached(&c->filter_buf[3], &c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
                        c->chrYInc, c->chrSrcH, c->chrDstH,
                        filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -2314,23 +2590,22 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
-    for (i = 0; i < 4; i++)
+    free_slice_contexts(c);
+
+    for (i = 0; i < 4; i++) {
         av_freep(&c->dither_error[i]);
+        av_freep(&c->dst_slice_tmp[i]);
+    }
 
-    av_freep(&c->vLumFilter);
-    av_freep(&c->vChrFilter);
-    av_freep(&c->hLumFilter);
-    av_freep(&c->hChrFilter);
+    free_filter(&c->filter_buf[0], &c->hLumFilter, &c->hLumFilterPos);
+    free_filter(&c->filter_buf[1], &c->hChrFilter, &c->hChrFilterPos);
+    free_filter(&c->filter_buf[2], &c->vLumFilter, &c->vLumFilterPos);
+    free_filter(&c->filter_buf[3], &c->vChrFilter, &c->vChrFilterPos);
 #if HAVE_ALTIVEC
     av_freep(&c->vYCoeffsBank);
     av_freep(&c->vCCoeffsBank);
 #endif
 
-    av_freep(&c->vLumFilterPos);
-    av_freep(&c->vChrFilterPos);
-    av_freep(&c->hLumFilterPos);
-    av_freep(&c->hChrFilterPos);
-
 #if HAVE_MMX_INLINE
 #if USE_MMAP
     if (c->lumMmxextFilterCode)
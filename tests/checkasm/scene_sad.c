@@ -0,0 +1,64 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavfilter/scene_sad.h"
+#include "libavutil/mem.h"
+
+#define WIDTH  256
+#define HEIGHT 16
+#define STRIDE (WIDTH * 2 + 32)
+
+static void check_scene_sad(int depth)
+{
+    const int bytes = depth > 8 ? 2 : 1;
+    static const int widths[] = { 1, 15, 33, 64, 127, WIDTH };
+    LOCAL_ALIGNED_32(uint8_t, src1, [STRIDE * HEIGHT]);
+    LOCAL_ALIGNED_32(uint8_t, src2, [STRIDE * HEIGHT]);
+    ff_scene_sad_fn sad = ff_scene_sad_get_fn(depth);
+
+    declare_func(void, SCENE_SAD_PARAMS);
+
+    for (int i = 0; i < STRIDE * HEIGHT; i++) {
+        src1[i] = rnd();
+        src2[i] = rnd();
+    }
+    /* the largest differences */
+    memset(src1, 0xFF, WIDTH * bytes);
+    memset(src2, 0x00, WIDTH * bytes);
+
+    if (check_func(sad, "scene_sad%s", depth > 8 ? "16" : "")) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            uint64_t sum_ref, sum_new;
+            call_ref(src1, STRIDE, src2, STRIDE, widths[i], HEIGHT, &sum_ref);
+            call_new(src1, STRIDE, src2, STRIDE, widths[i], HEIGHT, &sum_new);
+            if (sum_ref != sum_new)
+                fail();
+        }
+        bench_new(src1, STRIDE, src2, STRIDE, WIDTH, HEIGHT, &(uint64_t){ 0 });
+    }
+}
+
+void checkasm_check_scene_sad(void)
+{
+    check_scene_sad(8);
+    check_scene_sad(16);
+    report("scene_sad");
+}
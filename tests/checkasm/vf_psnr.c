@@ -0,0 +1,79 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavfilter/psnr.h"
+#include "libavutil/mem.h"
+
+#define MAX_WIDTH 1920
+
+static void check_sse_line(int bpp)
+{
+    const int bytes = bpp > 8 ? 2 : 1;
+    const int mask = (1 << bpp) - 1;
+    static const int widths[] = { 1, 7, 31, 64, 97, 256, 1001, MAX_WIDTH };
+    LOCAL_ALIGNED_32(uint16_t, buf, [MAX_WIDTH]);
+    LOCAL_ALIGNED_32(uint16_t, ref, [MAX_WIDTH]);
+    PSNRDSPContext dsp;
+
+    declare_func(uint64_t, const uint8_t *buf, const uint8_t *ref, int w);
+
+    for (int i = 0; i < MAX_WIDTH; i++) {
+        if (bytes == 1) {
+            ((uint8_t *)buf)[2 * i]     = rnd();
+            ((uint8_t *)buf)[2 * i + 1] = rnd();
+            ((uint8_t *)ref)[2 * i]     = rnd();
+            ((uint8_t *)ref)[2 * i + 1] = rnd();
+        } else {
+            buf[i] = rnd() & mask;
+            ref[i] = rnd() & mask;
+        }
+    }
+    /* the largest differences */
+    if (bytes == 1) {
+        memset(buf, 0xFF, 64);
+        memset(ref, 0x00, 64);
+    } else {
+        for (int i = 0; i < 64; i++) {
+            buf[i] = mask;
+            ref[i] = 0;
+        }
+    }
+
+    ff_psnr_init(&dsp, bpp);
+
+    if (check_func(dsp.sse_line, "sse_line_%d", bpp)) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            uint64_t res_ref = call_ref((const uint8_t *)buf, (const uint8_t *)ref, widths[i]);
+            uint64_t res_new = call_new((const uint8_t *)buf, (const uint8_t *)ref, widths[i]);
+            if (res_ref != res_new)
+                fail();
+        }
+        bench_new((const uint8_t *)buf, (const uint8_t *)ref, MAX_WIDTH);
+    }
+}
+
+void checkasm_check_vf_psnr(void)
+{
+    check_sse_line(8);
+    check_sse_line(10);
+    check_sse_line(14);
+    report("sse_line");
+}
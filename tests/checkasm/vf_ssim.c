@@ -0,0 +1,98 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavfilter/ssim.h"
+#include "libavutil/mem.h"
+
+#define MAX_BLOCKS 64
+#define STRIDE     (4 * MAX_BLOCKS + 32)
+
+static void check_ssim_4x4_line(const SSIMDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [4 * STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, ref, [4 * STRIDE]);
+    LOCAL_ALIGNED_32(int, sums_ref, [MAX_BLOCKS + 3], [4]);
+    LOCAL_ALIGNED_32(int, sums_new, [MAX_BLOCKS + 3], [4]);
+
+    declare_func(void, const uint8_t *buf, ptrdiff_t buf_stride,
+                 const uint8_t *ref, ptrdiff_t ref_stride,
+                 int (*sums)[4], int w);
+
+    for (int i = 0; i < 4 * STRIDE; i++) {
+        buf[i] = rnd();
+        ref[i] = rnd();
+    }
+
+    if (check_func(dsp->ssim_4x4_line, "ssim_4x4_line")) {
+        for (int w = 1; w <= MAX_BLOCKS; w += 7) {
+            memset(sums_ref, 0, (MAX_BLOCKS + 3) * sizeof(*sums_ref));
+            memset(sums_new, 0, (MAX_BLOCKS + 3) * sizeof(*sums_new));
+            call_ref(buf, STRIDE, ref, STRIDE, sums_ref, w);
+            call_new(buf, STRIDE, ref, STRIDE, sums_new, w);
+            if (memcmp(sums_ref, sums_new, w * sizeof(*sums_ref)))
+                fail();
+        }
+        bench_new(buf, STRIDE, ref, STRIDE, sums_new, MAX_BLOCKS);
+    }
+}
+
+static void check_ssim_end_line(const SSIMDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(uint8_t, buf, [8 * STRIDE]);
+    LOCAL_ALIGNED_32(uint8_t, ref, [8 * STRIDE]);
+    LOCAL_ALIGNED_32(int, sum0, [MAX_BLOCKS + 3], [4]);
+    LOCAL_ALIGNED_32(int, sum1, [MAX_BLOCKS + 3], [4]);
+
+    declare_func_float(float, const int (*sum0)[4], const int (*sum1)[4], int w);
+
+    /* similar images, the sums of blocks of unrelated noise being unrealistic */
+    for (int i = 0; i < 8 * STRIDE; i++) {
+        buf[i] = rnd();
+        ref[i] = av_clip_uint8(buf[i] + (int)(rnd() % 17) - 8);
+    }
+    memset(sum0, 0, (MAX_BLOCKS + 3) * sizeof(*sum0));
+    memset(sum1, 0, (MAX_BLOCKS + 3) * sizeof(*sum1));
+    dsp->ssim_4x4_line(buf, STRIDE, ref, STRIDE, sum0, MAX_BLOCKS);
+    dsp->ssim_4x4_line(buf + 4 * STRIDE, STRIDE, ref + 4 * STRIDE, STRIDE, sum1, MAX_BLOCKS);
+
+    if (check_func(dsp->ssim_end_line, "ssim_end_line")) {
+        for (int w = 1; w < MAX_BLOCKS; w += 5) {
+            float res_ref = call_ref((const int (*)[4])sum0, (const int (*)[4])sum1, w);
+            float res_new = call_new((const int (*)[4])sum0, (const int (*)[4])sum1, w);
+            if (!float_near_abs_eps(res_ref, res_new, 1e-5 * w))
+                fail();
+        }
+        bench_new((const int (*)[4])sum0, (const int (*)[4])sum1, MAX_BLOCKS - 1);
+    }
+}
+
+void checkasm_check_vf_ssim(void)
+{
+    SSIMDSPContext dsp;
+
+    ff_ssim_init(&dsp);
+
+    check_ssim_4x4_line(&dsp);
+    report("ssim_4x4_line");
+
+    check_ssim_end_line(&dsp);
+    report("ssim_end_line");
+}
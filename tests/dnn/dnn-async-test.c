@@ -0,0 +1,299 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include "libavfilter/dnn/dnn_async.h"
+#include "libavutil/common.h"
+
+#define WIDTH  5
+#define HEIGHT 3
+#define MAX_BATCHES 64
+
+/**
+ * model of the test, its output is its input plus one, and the requests
+ * whose input starts with fail_value fail with their whole batch
+ */
+typedef struct TestModel {
+    int batch_sizes[MAX_BATCHES];
+    int nb_batches;
+    float fail_value;
+} TestModel;
+
+static DNNReturnType execute_batch(void *model, DNNAsyncRequest **requests, int nb_requests)
+{
+    TestModel *test_model = model;
+    float output_data[WIDTH * HEIGHT];
+    DNNData output = {
+        .data = output_data, .dt = DNN_FLOAT,
+        .width = WIDTH, .height = HEIGHT, .channels = 1,
+    };
+
+    if (test_model->nb_batches < MAX_BATCHES)
+        test_model->batch_sizes[test_model->nb_batches++] = nb_requests;
+
+    for (int i = 0; i < nb_requests; i++) {
+        const float *input = requests[i]->input.data;
+        if (input[0] == test_model->fail_value)
+            return DNN_ERROR;
+        for (int j = 0; j < WIDTH * HEIGHT; j++)
+            output_data[j] = input[j] + 1;
+        if (ff_dnn_async_set_output(requests[i], 0, &output) != DNN_SUCCESS)
+            return DNN_ERROR;
+    }
+    return DNN_SUCCESS;
+}
+
+static int submit(DNNAsyncQueue *queue, int value)
+{
+    DNNData input;
+
+    if (ff_dnn_async_start_request(queue, &input) != DNN_SUCCESS)
+        return -1;
+    if (input.width != WIDTH || input.height != HEIGHT || input.channels != 1 || input.dt != DNN_FLOAT)
+        return -1;
+    for (int j = 0; j < WIDTH * HEIGHT; j++)
+        ((float *)input.data)[j] = value + j;
+    return ff_dnn_async_execute(queue, (void *)(intptr_t)value) == DNN_SUCCESS ? 0 : -1;
+}
+
+/**
+ * collect the oldest request, which must be the one submitted with value
+ */
+static int collect(DNNAsyncQueue *queue, int value)
+{
+    DNNData output;
+    void *user_data;
+    DNNAsyncStatusType status = ff_dnn_async_get_result(queue, &output, 1, &user_data, 1);
+
+    if (status != DAST_SUCCESS) {
+        printf("request %d: status %d\n", value, status);
+        return -1;
+    }
+    if ((intptr_t)user_data != value) {
+        printf("request %d: got the user data of request %d\n", value, (int)(intptr_t)user_data);
+        return -1;
+    }
+    if (output.width != WIDTH || output.height != HEIGHT || output.channels != 1) {
+        printf("request %d: output size %dx%dx%d\n", value, output.width, output.height, output.channels);
+        return -1;
+    }
+    for (int j = 0; j < WIDTH * HEIGHT; j++) {
+        if (((float *)output.data)[j] != value + j + 1) {
+            printf("request %d: wrong output %f at %d\n", value, ((float *)output.data)[j], j);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static DNNAsyncQueue *alloc_queue(TestModel *model, int nb_requests, int batch_size)
+{
+    DNNData input = { .dt = DNN_FLOAT, .width = WIDTH, .height = HEIGHT, .channels = 1 };
+
+    memset(model, 0, sizeof(*model));
+    model->fail_value = -1;
+    return ff_dnn_async_queue_alloc(model, execute_batch, &input, 1, nb_requests, batch_size, NULL, NULL);
+}
+
+/**
+ * keep the queue full like vf_dnn_processing does, collecting the oldest
+ * request only when no request is free
+ */
+static int test_stream(int nb_requests, int batch_size, int nb_frames)
+{
+    TestModel model;
+    DNNAsyncQueue *queue = alloc_queue(&model, nb_requests, batch_size);
+    int next = 0, ret = -1;
+
+    if (!queue)
+        return -1;
+
+    for (int i = 0; i < nb_frames; i++) {
+        if (submit(queue, i) < 0) {
+            if (i - next < nb_requests) {
+                printf("nireq %d batch %d: request %d refused with %d in flight\n",
+                       nb_requests, batch_size, i, i - next);
+                goto end;
+            }
+            if (collect(queue, next++) < 0 || submit(queue, i) < 0)
+                goto end;
+        }
+    }
+    ff_dnn_async_flush(queue);
+    while (next < nb_frames)
+        if (collect(queue, next++) < 0)
+            goto end;
+
+    if (ff_dnn_async_is_busy(queue)) {
+        printf("nireq %d batch %d: busy after the last request\n", nb_requests, batch_size);
+        goto end;
+    }
+    for (int i = 0; i < model.nb_batches; i++) {
+        if (model.batch_sizes[i] > batch_size) {
+            printf("nireq %d batch %d: batch of %d requests\n", nb_requests, batch_size, model.batch_sizes[i]);
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    ff_dnn_async_queue_free(&queue);
+    return ret;
+}
+
+/**
+ * requests only run in full batches unless flushed or waited for
+ */
+static int test_batching(void)
+{
+    TestModel model;
+    DNNAsyncQueue *queue = alloc_queue(&model, 8, 4);
+    DNNData output;
+    void *user_data;
+    int ret = -1;
+
+    if (!queue)
+        return -1;
+
+    if (ff_dnn_async_get_result(queue, &output, 1, &user_data, 0) != DAST_EMPTY_QUEUE) {
+        printf("batching: empty queue not reported\n");
+        goto end;
+    }
+    for (int i = 0; i < 3; i++)
+        if (submit(queue, i) < 0)
+            goto end;
+    if (ff_dnn_async_get_result(queue, &output, 1, &user_data, 0) != DAST_NOT_READY ||
+        !ff_dnn_async_is_busy(queue)) {
+        printf("batching: an incomplete batch was executed\n");
+        goto end;
+    }
+    for (int i = 3; i < 8; i++)
+        if (submit(queue, i) < 0)
+            goto end;
+    // all the requests are in flight
+    if (submit(queue, 8) == 0) {
+        printf("batching: more requests than nireq accepted\n");
+        goto end;
+    }
+    // the first batch is full, the second one runs when waited for
+    for (int i = 0; i < 8; i++)
+        if (collect(queue, i) < 0)
+            goto end;
+    if (ff_dnn_async_is_busy(queue) ||
+        ff_dnn_async_get_result(queue, &output, 1, &user_data, 1) != DAST_EMPTY_QUEUE) {
+        printf("batching: requests left after collecting them all\n");
+        goto end;
+    }
+    if (model.nb_batches != 2 || model.batch_sizes[0] != 4 || model.batch_sizes[1] != 4) {
+        printf("batching: %d batches of %d and %d requests\n", model.nb_batches,
+               model.batch_sizes[0], model.batch_sizes[1]);
+        goto end;
+    }
+
+    // a flush sends the incomplete batch
+    if (submit(queue, 8) < 0)
+        goto end;
+    ff_dnn_async_flush(queue);
+    if (collect(queue, 8) < 0)
+        goto end;
+    if (model.nb_batches != 3 || model.batch_sizes[2] != 1) {
+        printf("batching: flushed batch of %d requests\n", model.batch_sizes[2]);
+        goto end;
+    }
+    ret = 0;
+
+end:
+    ff_dnn_async_queue_free(&queue);
+    return ret;
+}
+
+/**
+ * a failing batch fails all its requests, and only them
+ */
+static int test_failure(void)
+{
+    TestModel model;
+    DNNAsyncQueue *queue = alloc_queue(&model, 4, 2);
+    DNNData output;
+    void *user_data;
+    int ret = -1;
+
+    if (!queue)
+        return -1;
+
+    model.fail_value = 3;
+    for (int i = 0; i < 4; i++)
+        if (submit(queue, i) < 0)
+            goto end;
+    if (collect(queue, 0) < 0 || collect(queue, 1) < 0)
+        goto end;
+    for (int i = 2; i < 4; i++) {
+        if (ff_dnn_async_get_result(queue, &output, 1, &user_data, 1) != DAST_FAIL ||
+            (intptr_t)user_data != i) {
+            printf("failure: request %d did not fail\n", i);
+            goto end;
+        }
+    }
+    if (submit(queue, 4) < 0)
+        goto end;
+    ff_dnn_async_flush(queue);
+    if (collect(queue, 4) < 0)
+        goto end;
+    ret = 0;
+
+end:
+    ff_dnn_async_queue_free(&queue);
+    return ret;
+}
+
+/**
+ * freeing the queue with requests in flight must not wait for them to be
+ * collected
+ */
+static int test_free_in_flight(void)
+{
+    TestModel model;
+    DNNAsyncQueue *queue = alloc_queue(&model, 4, 3);
+
+    if (!queue)
+        return -1;
+    for (int i = 0; i < 4; i++)
+        if (submit(queue, i) < 0)
+            break;
+    ff_dnn_async_queue_free(&queue);
+    return queue ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int configs[][2] = {
+        { 1, 1 }, { 2, 1 }, { 5, 1 }, { 4, 2 }, { 6, 3 }, { 3, 4 },
+    };
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(configs); i++)
+        if (test_stream(configs[i][0], configs[i][1], 50) < 0)
+            return 1;
+    if (test_batching() < 0)
+        return 1;
+    if (test_failure() < 0)
+        return 1;
+    if (test_free_in_flight() < 0)
+        return 1;
+
+    return 0;
+}
@@ -59,8 +59,9 @@ static int test_with_same_dilate(void)
     print(list(output.flatten()))
     */
 
-    ConvolutionalParams params;
+    ConvolutionalParams params = { 0 };
     DnnOperand operands[2];
+    NativeContext ctx = { .nb_threads = 1 };
     int32_t input_indexes[1];
     float input[1*5*6*3] = {
         0.7012556460308194, 0.4233847954643357, 0.19515900664313612, 0.16343083004926495, 0.5758261611052848, 0.9510767434014871, 0.11014085055947687,
@@ -105,6 +106,8 @@ static int test_with_same_dilate(void)
     params.kernel_size = 3;
     params.output_num = 2;
     params.padding_method = SAME;
+    if (dnn_pack_layer_conv2d(&params) < 0)
+        return 1;
 
     operands[0].data = input;
     operands[0].dims[0] = 1;
@@ -112,20 +115,24 @@ static int test_with_same_dilate(void)
     operands[0].dims[2] = 6;
     operands[0].dims[3] = 3;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
-    dnn_execute_layer_conv2d(operands, input_indexes, 1, &params);
+    dnn_execute_layer_conv2d(operands, input_indexes, 1, &params, &ctx);
+    av_freep(&ctx.scratch);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(expected_output) / sizeof(float); i++) {
         if (fabs(output[i] - expected_output[i]) > EPSON) {
             printf("at index %d, output: %f, expected_output: %f\n", i, output[i], expected_output[i]);
             av_freep(&output);
+            av_freep(&params.packed_kernel);
             return 1;
         }
     }
 
     av_freep(&output);
+    av_freep(&params.packed_kernel);
     return 0;
 }
 
@@ -163,8 +170,9 @@ static int test_with_valid(void)
     print(list(output.flatten()))
     */
 
-    ConvolutionalParams params;
+    ConvolutionalParams params = { 0 };
     DnnOperand operands[2];
+    NativeContext ctx = { .nb_threads = 1 };
     int32_t input_indexes[1];
     float input[1*5*6*3] = {
         0.26126657468269665, 0.42762216215337556, 0.7466274030131497, 0.802550266787863, 0.3709323443076644, 0.5919817068197668, 0.49274512279324967,
@@ -205,6 +213,8 @@ static int test_with_valid(void)
     params.kernel_size = 3;
     params.output_num = 2;
     params.padding_method = VALID;
+    if (dnn_pack_layer_conv2d(&params) < 0)
+        return 1;
 
     operands[0].data = input;
     operands[0].dims[0] = 1;
@@ -212,20 +222,24 @@ static int test_with_valid(void)
     operands[0].dims[2] = 6;
     operands[0].dims[3] = 3;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
-    dnn_execute_layer_conv2d(operands, input_indexes, 1, &params);
+    dnn_execute_layer_conv2d(operands, input_indexes, 1, &params, &ctx);
+    av_freep(&ctx.scratch);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(expected_output) / sizeof(float); i++) {
         if (fabs(output[i] - expected_output[i]) > EPSON) {
             printf("at index %d, output: %f, expected_output: %f\n", i, output[i], expected_output[i]);
             av_freep(&output);
+            av_freep(&params.packed_kernel);
             return 1;
         }
     }
 
     av_freep(&output);
+    av_freep(&params.packed_kernel);
     return 0;
 }
 
@@ -78,10 +78,11 @@ static int test(void)
     operands[0].dims[2] = 3;
     operands[0].dims[3] = 4;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
     params.block_size = 2;
-    dnn_execute_layer_depth2space(operands, input_indexes, 1, &params);
+    dnn_execute_layer_depth2space(operands, input_indexes, 1, &params, NULL);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(expected_output) / sizeof(float); i++) {
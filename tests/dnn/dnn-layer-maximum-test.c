@@ -43,9 +43,10 @@ static int test(void)
     operands[0].dims[2] = 2;
     operands[0].dims[3] = 3;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
-    dnn_execute_layer_maximum(operands, input_indexes, 1, &params);
+    dnn_execute_layer_maximum(operands, input_indexes, 1, &params, NULL);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(input) / sizeof(float); i++) {
@@ -77,9 +77,10 @@ static int test_with_mode_symmetric(void)
     operands[0].dims[2] = 4;
     operands[0].dims[3] = 3;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
-    dnn_execute_layer_pad(operands, input_indexes, 1, &params);
+    dnn_execute_layer_pad(operands, input_indexes, 1, &params, NULL);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(expected_output) / sizeof(float); i++) {
@@ -142,9 +143,10 @@ static int test_with_mode_reflect(void)
     operands[0].dims[2] = 2;
     operands[0].dims[3] = 3;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
-    dnn_execute_layer_pad(operands, input_indexes, 1, &params);
+    dnn_execute_layer_pad(operands, input_indexes, 1, &params, NULL);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(expected_output) / sizeof(float); i++) {
@@ -208,9 +210,10 @@ static int test_with_mode_constant(void)
     operands[0].dims[2] = 2;
     operands[0].dims[3] = 3;
     operands[1].data = NULL;
+    operands[1].in_arena = 0;
 
     input_indexes[0] = 0;
-    dnn_execute_layer_pad(operands, input_indexes, 1, &params);
+    dnn_execute_layer_pad(operands, input_indexes, 1, &params, NULL);
 
     output = operands[1].data;
     for (int i = 0; i < sizeof(expected_output) / sizeof(float); i++) {
@@ -0,0 +1,338 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavfilter/dnn_interface.h"
+#include "libavfilter/dnn/dnn_backend_native.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_conv2d.h"
+#include "libavformat/avio.h"
+#include "libavutil/lfg.h"
+#include "libavutil/intfloat.h"
+
+#define WIDTH  100
+#define HEIGHT 75
+
+/**
+ * check that the tiles cover every pixel once, and that their input windows
+ * stay in the frame while extending the kept parts by the overlap on each
+ * side which is not on a frame border
+ */
+static int test_layout(int width, int height, int tile_size, int overlap)
+{
+    DNNTileLayout layout;
+    uint8_t *covered = av_mallocz(width * height);
+    int ret = 0;
+
+    if (!covered)
+        return 1;
+
+    ff_dnn_tile_layout_init(&layout, width, height, tile_size, overlap);
+    for (int i = 0; i < layout.nb_tiles; i++) {
+        DNNTile tile;
+        ff_dnn_get_tile(&layout, i, &tile);
+
+        if (tile.in_x < 0 || tile.in_y < 0 ||
+            tile.in_x + layout.in_w > width || tile.in_y + layout.in_h > height ||
+            tile.x < tile.in_x || tile.y < tile.in_y ||
+            tile.x + tile.w > tile.in_x + layout.in_w ||
+            tile.y + tile.h > tile.in_y + layout.in_h) {
+            printf("%dx%d tile %d overlap %d: tile %d does not fit its window\n",
+                   width, height, tile_size, overlap, i);
+            ret = 1;
+            break;
+        }
+        if ((tile.in_x > 0 && tile.x - tile.in_x < overlap) ||
+            (tile.in_y > 0 && tile.y - tile.in_y < overlap) ||
+            (tile.in_x + layout.in_w < width  && tile.in_x + layout.in_w - tile.x - tile.w < overlap) ||
+            (tile.in_y + layout.in_h < height && tile.in_y + layout.in_h - tile.y - tile.h < overlap)) {
+            printf("%dx%d tile %d overlap %d: tile %d misses its overlap\n",
+                   width, height, tile_size, overlap, i);
+            ret = 1;
+            break;
+        }
+        for (int y = tile.y; y < tile.y + tile.h; y++)
+            for (int x = tile.x; x < tile.x + tile.w; x++)
+                covered[y * width + x]++;
+    }
+
+    for (int i = 0; !ret && i < width * height; i++) {
+        if (covered[i] != 1) {
+            printf("%dx%d tile %d overlap %d: pixel %d covered %d times\n",
+                   width, height, tile_size, overlap, i, covered[i]);
+            ret = 1;
+        }
+    }
+
+    av_freep(&covered);
+    return ret;
+}
+
+typedef struct TestLayer {
+    DNNLayerType type;
+    int block_size;             ///< depth2space only
+    int dilation, activation;
+    int input_num, output_num, kernel_size;
+} TestLayer;
+
+/**
+ * write a version 1 native model file of layers applied one after the other,
+ * from the input operand "x" to the output operand "y"
+ */
+static int write_model(const char *filename, const TestLayer *layers, int nb_layers)
+{
+    AVIOContext *pb;
+    AVLFG lfg;
+
+    if (avio_open(&pb, filename, AVIO_FLAG_WRITE) < 0)
+        return -1;
+    av_lfg_init(&lfg, 0x7ec5);
+
+    avio_write(pb, "FFMPEGDNNNATIVE", 15);
+    avio_wl32(pb, 1);
+    avio_wl32(pb, 0);
+
+    for (int i = 0; i < nb_layers; i++) {
+        const TestLayer *l = &layers[i];
+
+        avio_wl32(pb, l->type);
+        if (l->type == DLT_DEPTH_TO_SPACE) {
+            avio_wl32(pb, l->block_size);
+        } else {
+            int kernel_len = l->output_num * l->kernel_size * l->kernel_size * l->input_num;
+
+            avio_wl32(pb, l->dilation);
+            avio_wl32(pb, SAME);
+            avio_wl32(pb, l->activation);
+            avio_wl32(pb, l->input_num);
+            avio_wl32(pb, l->output_num);
+            avio_wl32(pb, l->kernel_size);
+            avio_wl32(pb, 1);
+            for (int k = 0; k < kernel_len; k++)
+                avio_wl32(pb, av_float2int(av_lfg_get(&lfg) / (float)UINT32_MAX - 0.5f));
+            for (int k = 0; k < l->output_num; k++)
+                avio_wl32(pb, av_float2int(av_lfg_get(&lfg) / (float)UINT32_MAX * 0.1f));
+        }
+        avio_wl32(pb, i);
+        avio_wl32(pb, i + 1);
+    }
+
+    for (int i = 0, channels = 1; i <= nb_layers; i++) {
+        char name[8];
+
+        if (i && layers[i - 1].type == DLT_DEPTH_TO_SPACE)
+            channels /= layers[i - 1].block_size * layers[i - 1].block_size;
+        else if (i)
+            channels = layers[i - 1].output_num;
+        if (!i || i == nb_layers)
+            snprintf(name, sizeof(name), "%s", i ? "y" : "x");
+        else
+            snprintf(name, sizeof(name), "t%d", i);
+        avio_wl32(pb, i);
+        avio_wl32(pb, strlen(name) + 1);
+        avio_write(pb, name, strlen(name) + 1);
+        avio_wl32(pb, !i ? DOT_INPUT : i == nb_layers ? DOT_OUTPUT : DOT_INTERMEDIATE);
+        avio_wl32(pb, DNN_FLOAT);
+        avio_wl32(pb, 1);
+        avio_wl32(pb, -1);
+        avio_wl32(pb, -1);
+        avio_wl32(pb, channels);
+    }
+
+    avio_wl32(pb, nb_layers);
+    avio_wl32(pb, nb_layers + 1);
+    return avio_closep(&pb);
+}
+
+static int test_receptive_field(const char *filename, int expected)
+{
+    DNNModel *model = ff_dnn_load_model_native(filename, NULL);
+    int radius = -1;
+    int ret = 0;
+
+    if (!model) {
+        printf("%s: could not load the model\n", filename);
+        return 1;
+    }
+    if (model->get_receptive_field(model->model, &radius) != DNN_SUCCESS || radius != expected) {
+        printf("%s: receptive field %d, expected %d\n", filename, radius, expected);
+        ret = 1;
+    }
+    ff_dnn_free_model_native(&model);
+    return ret;
+}
+
+/**
+ * run the frame through dnn_processing with the given options and return
+ * the output frame
+ */
+static AVFrame *filter_frame(const AVFrame *in, const char *filename, const char *options, int nb_threads)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterContext *src, *dnn, *sink;
+    AVFrame *frame = av_frame_clone(in);
+    AVFrame *out = av_frame_alloc();
+    char args[1024];
+    int ret;
+
+    if (!graph || !frame || !out)
+        goto fail;
+    graph->nb_threads = nb_threads;
+
+    snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=1/25",
+             in->width, in->height, in->format);
+    if (avfilter_graph_create_filter(&src, avfilter_get_by_name("buffer"), "in", args, NULL, graph) < 0)
+        goto fail;
+    snprintf(args, sizeof(args), "dnn_backend=native:model=%s:input=x:output=y%s", filename, options);
+    if (avfilter_graph_create_filter(&dnn, avfilter_get_by_name("dnn_processing"), "dnn", args, NULL, graph) < 0)
+        goto fail;
+    if (avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"), "out", NULL, NULL, graph) < 0)
+        goto fail;
+    if (avfilter_link(src, 0, dnn, 0) < 0 || avfilter_link(dnn, 0, sink, 0) < 0 ||
+        avfilter_graph_config(graph, NULL) < 0)
+        goto fail;
+
+    if (av_buffersrc_add_frame(src, frame) < 0 || av_buffersrc_add_frame(src, NULL) < 0)
+        goto fail;
+    ret = av_buffersink_get_frame(sink, out);
+    if (ret < 0)
+        goto fail;
+
+    av_frame_free(&frame);
+    avfilter_graph_free(&graph);
+    return out;
+
+fail:
+    av_frame_free(&frame);
+    av_frame_free(&out);
+    avfilter_graph_free(&graph);
+    return NULL;
+}
+
+/**
+ * the tiled output of a float model must be the same as the whole frame one
+ * as long as the overlap covers the receptive field
+ */
+static int test_tiled_output(const char *filename, int nb_threads)
+{
+    static const char *const tile_options[] = {
+        ":tile_size=16", ":tile_size=32", ":tile_size=40:tile_overlap=5", ":tile_size=1000",
+    };
+    AVFrame *in = av_frame_alloc();
+    AVFrame *ref = NULL;
+    AVLFG lfg;
+    int ret = 1;
+
+    if (!in)
+        return 1;
+    in->format = AV_PIX_FMT_GRAYF32;
+    in->width  = WIDTH;
+    in->height = HEIGHT;
+    if (av_frame_get_buffer(in, 0) < 0)
+        goto end;
+    av_lfg_init(&lfg, 0xd17e);
+    for (int y = 0; y < HEIGHT; y++)
+        for (int x = 0; x < WIDTH; x++)
+            ((float *)(in->data[0] + y * in->linesize[0]))[x] = av_lfg_get(&lfg) / (float)UINT32_MAX;
+
+    ref = filter_frame(in, filename, "", 1);
+    if (!ref) {
+        printf("%s: whole frame execution failed\n", filename);
+        goto end;
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tile_options); i++) {
+        AVFrame *out = filter_frame(in, filename, tile_options[i], nb_threads);
+
+        if (!out) {
+            printf("%s%s: tiled execution failed\n", filename, tile_options[i]);
+            goto end;
+        }
+        if (out->width != ref->width || out->height != ref->height) {
+            printf("%s%s: output size %dx%d, expected %dx%d\n", filename, tile_options[i],
+                   out->width, out->height, ref->width, ref->height);
+            av_frame_free(&out);
+            goto end;
+        }
+        for (int y = 0; y < ref->height; y++) {
+            if (memcmp(out->data[0] + y * out->linesize[0], ref->data[0] + y * ref->linesize[0],
+                       ref->width * sizeof(float))) {
+                printf("%s%s with %d threads: line %d differs from the whole frame output\n",
+                       filename, tile_options[i], nb_threads, y);
+                av_frame_free(&out);
+                goto end;
+            }
+        }
+        av_frame_free(&out);
+    }
+    ret = 0;
+
+end:
+    av_frame_free(&in);
+    av_frame_free(&ref);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const TestLayer model_same[] = {
+        { DLT_CONV2D, 0, 1, RELU, 1, 8, 3 },
+        { DLT_CONV2D, 0, 2, NONE, 8, 1, 3 },
+    };
+    static const TestLayer model_scale[] = {
+        { DLT_CONV2D,         0, 1, TANH, 1, 4, 5 },
+        { DLT_DEPTH_TO_SPACE, 2 },
+        { DLT_CONV2D,         0, 1, NONE, 1, 1, 3 },
+    };
+    char filename[1024];
+    int ret = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <directory for the model files>\n", argv[0]);
+        return 1;
+    }
+
+    for (int tile_size = 1; tile_size <= 40; tile_size += 13)
+        for (int overlap = 0; overlap <= 9; overlap += 3)
+            ret |= test_layout(WIDTH, HEIGHT, tile_size, overlap);
+    ret |= test_layout(7, 300, 32, 4);
+    if (ret)
+        return 1;
+
+    // 1 pixel for the first 3x3 convolution, 2 for the dilated one
+    snprintf(filename, sizeof(filename), "%s/dnn-tile-same.model", argv[1]);
+    if (write_model(filename, model_same, FF_ARRAY_ELEMS(model_same)) < 0 ||
+        test_receptive_field(filename, 3) ||
+        test_tiled_output(filename, 1) ||
+        test_tiled_output(filename, 3))
+        return 1;
+
+    // 2 pixels for the 5x5 convolution, the 3x3 one after depth2space only
+    // reaches 1 pixel of the output, i.e. half a pixel of the input
+    snprintf(filename, sizeof(filename), "%s/dnn-tile-scale.model", argv[1]);
+    if (write_model(filename, model_scale, FF_ARRAY_ELEMS(model_scale)) < 0 ||
+        test_receptive_field(filename, 3) ||
+        test_tiled_output(filename, 1) ||
+        test_tiled_output(filename, 3))
+        return 1;
+
+    return 0;
+}
@@ -18,6 +18,18 @@ fate-dnn-layer-maximum: $(DNNTESTSDIR)/dnn-layer-maximum-test$(EXESUF)
 fate-dnn-layer-maximum: CMD = run $(DNNTESTSDIR)/dnn-layer-maximum-test$(EXESUF)
 fate-dnn-layer-maximum: CMP = null
 
+FATE_DNN += fate-dnn-async
+fate-dnn-async: $(DNNTESTSDIR)/dnn-async-test$(EXESUF)
+fate-dnn-async: CMD = run $(DNNTESTSDIR)/dnn-async-test$(EXESUF)
+fate-dnn-async: CMP = null
+
+FATE_DNN-$(call ALLYES, DNN_PROCESSING_FILTER) += fate-dnn-tile
+fate-dnn-tile: $(DNNTESTSDIR)/dnn-tile-test$(EXESUF)
+fate-dnn-tile: CMD = run $(DNNTESTSDIR)/dnn-tile-test$(EXESUF) $(TARGET_PATH)/tests/data/fate
+fate-dnn-tile: CMP = null
+
+FATE_DNN += $(FATE_DNN-yes)
+
 FATE-yes += $(FATE_DNN)
 
 fate-dnn: $(FATE_DNN)
@@ -486,6 +486,14 @@ FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scalechroma
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_v_chr_pos=33:out_h_chr_pos=151
 
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER FORMAT_FILTER SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER SCALE_FILTER NEGATE_FILTER AVGBLUR_FILTER CROP_FILTER OVERLAY_FILTER) += fate-filter-graph-threads
+fate-filter-graph-threads: libavfilter/tests/graphthreads$(EXESUF)
+fate-filter-graph-threads: CMD = run libavfilter/tests/graphthreads$(EXESUF)
+
+FATE_FILTER_VSYNTH-$(CONFIG_MULTISCALE_FILTER) += fate-filter-multiscale fate-filter-multiscale-cascade
+fate-filter-multiscale: CMD = framecrc -c:v pgmyuv -i $(SRC) -frames:v 5 -filter_complex "multiscale=sizes=176x144|240x160|88x72:flags=bicubic+bitexact+accurate_rnd[a][b][c]" -map "[a]" -map "[b]" -map "[c]"
+fate-filter-multiscale-cascade: CMD = framecrc -c:v pgmyuv -i $(SRC) -frames:v 5 -filter_complex "multiscale=sizes=176x144|240x160|88x72:cascade=1:flags=bicubic+bitexact+accurate_rnd[a][b][c]" -map "[a]" -map "[b]" -map "[c]"
+
 FATE_FILTER_VSYNTH-$(CONFIG_VFLIP_FILTER) += fate-filter-vflip
 fate-filter-vflip: CMD = video_filter "vflip"
 
@@ -531,6 +539,15 @@ fate-filter-idet: CMD = framecrc -flags bitexact -idct simple -i $(SRC) -vf idet
 FATE_FILTER_VSYNTH-$(CONFIG_PAD_FILTER) += fate-filter-pad
 fate-filter-pad: CMD = video_filter "pad=iw*1.5:ih*1.5:iw*0.3:ih*0.2"
 
+# the decoded frames are allocated with the padding around them and padded in
+# place, split makes pad copy them, the output must be the same
+FATE_FILTER_VSYNTH-$(CONFIG_PAD_FILTER) += fate-filter-pad-border
+fate-filter-pad-border: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf pad=iw+64:ih+32:48:16:color=red
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER NULLSINK_FILTER PAD_FILTER) += fate-filter-pad-border-copy
+fate-filter-pad-border-copy: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex "split[a][b];[b]nullsink;[a]pad=iw+64:ih+32:48:16:color=red"
+fate-filter-pad-border-copy: REF = $(SRC_PATH)/tests/ref/fate/filter-pad-border
+
 FATE_FILTER_PP = fate-filter-pp fate-filter-pp1 fate-filter-pp2 fate-filter-pp3 fate-filter-pp4 fate-filter-pp5 fate-filter-pp6
 FATE_FILTER_VSYNTH-$(CONFIG_PP_FILTER) += $(FATE_FILTER_PP)
 $(FATE_FILTER_PP): fate-vsynth1-mpeg4-qprd
@@ -799,12 +816,18 @@ fate-filter-refcmp-psnr-rgb: CMD = refcmp_metadata psnr rgb24 0.002
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) PSNR_FILTER) += fate-filter-refcmp-psnr-yuv
 fate-filter-refcmp-psnr-yuv: CMD = refcmp_metadata psnr yuv422p 0.0015
 
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) PSNR_FILTER) += fate-filter-refcmp-psnr-yuv10
+fate-filter-refcmp-psnr-yuv10: CMD = refcmp_metadata psnr yuv420p10le 0.0015
+
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-rgb
 fate-filter-refcmp-ssim-rgb: CMD = refcmp_metadata ssim rgb24 0.015
 
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv10
+fate-filter-refcmp-ssim-yuv10: CMD = refcmp_metadata ssim yuv420p10le 0.015
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
@@ -13,6 +13,21 @@ fate-aes_ctr: libavutil/tests/aes_ctr$(EXESUF)
 fate-aes_ctr: CMD = run libavutil/tests/aes_ctr$(EXESUF)
 fate-aes_ctr: CMP = null
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-buffer_pool
+fate-buffer_pool: libavutil/tests/buffer_pool$(EXESUF)
+fate-buffer_pool: CMD = run libavutil/tests/buffer_pool$(EXESUF)
+fate-buffer_pool: CMP = null
+
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-buffer_pool-hugepages
+fate-buffer_pool-hugepages: libavutil/tests/buffer_pool$(EXESUF)
+fate-buffer_pool-hugepages: CMD = run libavutil/tests/buffer_pool$(EXESUF) -f 1 -n 20000
+fate-buffer_pool-hugepages: CMP = null
+
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-buffer_pool-numa
+fate-buffer_pool-numa: libavutil/tests/buffer_pool$(EXESUF)
+fate-buffer_pool-numa: CMD = run libavutil/tests/buffer_pool$(EXESUF) -f 2 -n 20000
+fate-buffer_pool-numa: CMP = null
+
 FATE_LIBAVUTIL += fate-camellia
 fate-camellia: libavutil/tests/camellia$(EXESUF)
 fate-camellia: CMD = run libavutil/tests/camellia$(EXESUF)
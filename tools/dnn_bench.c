@@ -0,0 +1,266 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Benchmark of a DNN model executed by one of the backends of libavfilter
+ * on random input, without decoding or filtering around it.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#if HAVE_SYS_RESOURCE_H
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#endif
+#if HAVE_GETPROCESSMEMORYINFO
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/time.h"
+#include "libavfilter/dnn_interface.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+static int64_t getmaxrss(void)
+{
+#if HAVE_GETRUSAGE && HAVE_STRUCT_RUSAGE_RU_MAXRSS
+    struct rusage rusage;
+    getrusage(RUSAGE_SELF, &rusage);
+    return (int64_t)rusage.ru_maxrss * 1024;
+#elif HAVE_GETPROCESSMEMORYINFO
+    HANDLE proc;
+    PROCESS_MEMORY_COUNTERS memcounters;
+    proc = GetCurrentProcess();
+    memcounters.cb = sizeof(memcounters);
+    GetProcessMemoryInfo(proc, &memcounters, sizeof(memcounters));
+    return memcounters.PeakPagefileUsage;
+#else
+    return 0;
+#endif
+}
+
+static void usage(void)
+{
+    printf("Benchmark a DNN model on random input\n");
+    printf("usage: dnn_bench [OPTIONS] MODEL\n");
+    printf("\n"
+           "Options:\n"
+           "-a                use the asynchronous execution, keeping all the requests in flight\n"
+           "-b BACKEND        set the backend, native (default) or tensorflow\n"
+           "-c CONFIGS        set the backend configs, key=value pairs separated by '&',\n"
+           "                  e.g. profile=1 to get the time spent in each layer of a native model\n"
+           "-h                print this help\n"
+           "-i NAME           set the input name of the model, default is x\n"
+           "-n ITERATIONS     set the number of timed executions, default is 100\n"
+           "-o NAME           set the output name of the model, default is y\n"
+           "-s WIDTHxHEIGHT   set the input size for models accepting any size, default is 640x360\n"
+           "-v                increase the log level\n");
+}
+
+static void fill_input(DNNData *input, AVLFG *lfg)
+{
+    size_t nb = (size_t)input->width * input->height * input->channels;
+
+    for (size_t i = 0; i < nb; i++) {
+        unsigned int r = av_lfg_get(lfg) & 0xFF;
+        if (input->dt == DNN_FLOAT)
+            ((float *)input->data)[i] = r / 255.0f;
+        else
+            ((uint8_t *)input->data)[i] = r;
+    }
+}
+
+static int run_sync(DNNModule *module, DNNModel *model, int iterations)
+{
+    DNNData output;
+
+    for (int i = 0; i < iterations; i++) {
+        if (module->execute_model(model, &output, 1) != DNN_SUCCESS)
+            return -1;
+    }
+    return 0;
+}
+
+static int run_async(DNNModule *module, DNNModel *model, DNNData *input, AVLFG *lfg, int iterations)
+{
+    int submitted = 0, collected = 0;
+
+    while (collected < iterations) {
+        DNNAsyncStatusType status;
+        DNNData output;
+        void *user_data;
+
+        while (submitted < iterations && module->start_request(model, input) == DNN_SUCCESS) {
+            fill_input(input, lfg);
+            if (module->execute_model_async(model, NULL) != DNN_SUCCESS)
+                return -1;
+            submitted++;
+        }
+        if (submitted == iterations)
+            module->flush(model);
+
+        status = module->get_async_result(model, &output, 1, &user_data, 1);
+        if (status != DAST_SUCCESS)
+            return -1;
+        collected++;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *input_name = "x", *output_name = "y", *configs = NULL;
+    DNNBackendType backend = DNN_NATIVE;
+    int width = 640, height = 360, iterations = 100, async = 0, c;
+    DNNModule *module = NULL;
+    DNNModel *model = NULL;
+    DNNData input, output;
+    int64_t start, load_time, first_time, run_time;
+    AVLFG lfg;
+    int ret = 1;
+
+    while ((c = getopt(argc, argv, "ab:c:hi:n:o:s:v")) != -1) {
+        switch (c) {
+        case 'a':
+            async = 1;
+            break;
+        case 'b':
+            if (!strcmp(optarg, "native")) {
+                backend = DNN_NATIVE;
+            } else if (!strcmp(optarg, "tensorflow")) {
+                backend = DNN_TF;
+            } else {
+                fprintf(stderr, "Unknown backend '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            configs = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        case 'i':
+            input_name = optarg;
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'o':
+            output_name = optarg;
+            break;
+        case 's':
+            if (av_parse_video_size(&width, &height, optarg) < 0) {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'v':
+            av_log_set_level(av_log_get_level() + 8);
+            break;
+        case '?':
+            return 1;
+        }
+    }
+    if (optind >= argc || iterations <= 0) {
+        usage();
+        return 1;
+    }
+
+    module = ff_get_dnn_module(backend);
+    if (!module || !module->load_model) {
+        fprintf(stderr, "The backend is not available\n");
+        goto end;
+    }
+    if (async && !module->start_request) {
+        fprintf(stderr, "The backend does not support asynchronous execution\n");
+        goto end;
+    }
+
+    start = av_gettime_relative();
+    model = module->load_model(argv[optind], configs);
+    if (!model) {
+        fprintf(stderr, "Could not load the model %s\n", argv[optind]);
+        goto end;
+    }
+    if (model->get_input(model->model, &input, input_name) != DNN_SUCCESS) {
+        fprintf(stderr, "Could not get the input %s of the model\n", input_name);
+        goto end;
+    }
+    if (input.width != -1)
+        width = input.width;
+    if (input.height != -1)
+        height = input.height;
+    input.width = width;
+    input.height = height;
+    if (model->set_input_output(model->model, &input, input_name, &output_name, 1) != DNN_SUCCESS) {
+        fprintf(stderr, "Could not set the input and output of the model\n");
+        goto end;
+    }
+    load_time = av_gettime_relative() - start;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    fill_input(&input, &lfg);
+
+    // the first execution allocates the buffers and warms the caches
+    start = av_gettime_relative();
+    if (module->execute_model(model, &output, 1) != DNN_SUCCESS) {
+        fprintf(stderr, "Could not execute the model\n");
+        goto end;
+    }
+    first_time = av_gettime_relative() - start;
+
+    start = av_gettime_relative();
+    if (async ? run_async(module, model, &input, &lfg, iterations) :
+                run_sync(module, model, iterations)) {
+        fprintf(stderr, "Could not execute the model\n");
+        goto end;
+    }
+    run_time = FFMAX(av_gettime_relative() - start, 1);
+
+    printf("model: %s, backend: %s%s\n", argv[optind],
+           backend == DNN_NATIVE ? "native" : "tensorflow", async ? ", asynchronous" : "");
+    printf("input: %dx%dx%d %s, output: %dx%dx%d\n", input.width, input.height, input.channels,
+           input.dt == DNN_FLOAT ? "float" : "uint8", output.width, output.height, output.channels);
+    printf("load: %.3f ms, first execution: %.3f ms\n", load_time / 1e3, first_time / 1e3);
+    printf("%d iterations: %.3f ms/iteration, %.2f iterations/s, %.2f Mpixels/s\n",
+           iterations, run_time / 1e3 / iterations, iterations * 1e6 / run_time,
+           (double)iterations * width * height / run_time);
+    printf("peak memory: %"PRId64" kB\n", getmaxrss() / 1024);
+    ret = 0;
+
+end:
+    if (module && model)
+        module->free_model(&model);
+    av_freep(&module);
+    return ret;
+}
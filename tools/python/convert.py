@@ -20,12 +20,12 @@
 # verified with Python 3.5.2 on Ubuntu 16.04
 import argparse
 import os
-from convert_from_tensorflow import *
+import native_model
 
 def get_arguments():
     parser = argparse.ArgumentParser(description='generate native mode model with weights from deep learning model')
     parser.add_argument('--outdir', type=str, default='./', help='where to put generated files')
-    parser.add_argument('--infmt', type=str, default='tensorflow', help='format of the deep learning model')
+    parser.add_argument('--infmt', type=str, default='tensorflow', help='format of the deep learning model, native to upgrade a native model file to the current version')
     parser.add_argument('infile', help='path to the deep learning model with weights')
     parser.add_argument('--dump4tb', type=str, default='no', help='dump file for visualization in tensorboard')
 
@@ -50,7 +50,10 @@ def main():
         dump4tb = True
 
     if args.infmt == 'tensorflow':
+        from convert_from_tensorflow import convert_from_tensorflow
         convert_from_tensorflow(args.infile, outfile, dump4tb)
+    elif args.infmt == 'native':
+        native_model.write_model(outfile, native_model.read_model(args.infile))
 
 if __name__ == '__main__':
     main()
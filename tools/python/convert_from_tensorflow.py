@@ -118,6 +118,24 @@ class TFConverter:
         return knode, bnode, dnode, anode
 
 
+    @staticmethod
+    def dump_blob(f, array):
+        # weight blobs start at a multiple of header.blob_align in the file
+        f.write(bytes(-f.tell() % header.blob_align))
+        array.tofile(f)
+
+
+    @staticmethod
+    def pack_kernel(kernel):
+        # panels of header.conv2d_block output channels, each one stores the
+        # filter rows of its channels next to each other, see dnn_pack_layer_conv2d()
+        out_channels = kernel.shape[0]
+        kernel = np.reshape(kernel, (out_channels, -1))
+        kernel = np.pad(kernel, ((0, -out_channels % header.conv2d_block), (0, 0)), 'constant')
+        kernel = np.reshape(kernel, (-1, header.conv2d_block, kernel.shape[1]))
+        return np.ascontiguousarray(np.transpose(kernel, [0, 2, 1]), dtype=np.float32)
+
+
     def dump_complex_conv2d_to_file(self, node, f):
         assert(node.op == 'Conv2D')
         self.layer_number = self.layer_number + 1
@@ -155,14 +173,14 @@ class TFConverter:
 
         has_bias = 1
         np.array([self.op2code[node.op], dilation, padding, self.conv_activations[activation], in_channels, out_channels, filter_height, has_bias], dtype=np.uint32).tofile(f)
-        kernel.tofile(f)
+        TFConverter.dump_blob(f, TFConverter.pack_kernel(kernel))
 
         btensor = bnode.attr['value'].tensor
         if btensor.tensor_shape.dim[0].size == 1:
-            bias = struct.pack("f", btensor.float_val[0])
+            bias = np.array([btensor.float_val[0]], dtype=np.float32)
         else:
-            bias = btensor.tensor_content
-        f.write(bias)
+            bias = np.frombuffer(btensor.tensor_content, dtype=np.float32)
+        TFConverter.dump_blob(f, bias)
 
         input_name = self.conv2d_scopename_inputname_dict[scope_name]
         input_operand_index = self.add_operand(input_name, Operand.IOTYPE_INPUT)
@@ -205,7 +223,7 @@ class TFConverter:
         padding = node.attr['padding'].s.decode("utf-8")
         np.array([self.op2code[node.op], dilation, self.conv_paddings[padding], self.conv_activations['None'],
                   in_channels, out_channels, filter_height, has_bias], dtype=np.uint32).tofile(f)
-        kernel.tofile(f)
+        TFConverter.dump_blob(f, TFConverter.pack_kernel(kernel))
 
         input_operand_index = self.add_operand(input_name, Operand.IOTYPE_INPUT)
         output_operand_index = self.add_operand(node.name, Operand.IOTYPE_OUTPUT)
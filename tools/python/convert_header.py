@@ -20,7 +20,14 @@
 str = 'FFMPEGDNNNATIVE'
 
 # increase major and reset minor when we have to re-convert the model file
-major = 1
+major = 2
 
 # increase minor when we don't have to re-convert the model file
 minor = 0
+
+# since major 2, the conv2d weights are stored prepacked in panels of
+# conv2d_block output channels, and each weight blob starts at a multiple
+# of blob_align bytes so that the native backend can map the file and use
+# the weights in place, see libavfilter/dnn/dnn_backend_native_layer_conv2d.h
+blob_align = 64
+conv2d_block = 16
@@ -0,0 +1,180 @@
+# This file is part of FFmpeg.
+#
+# FFmpeg is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# FFmpeg is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with FFmpeg; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+# ==============================================================================
+
+# read native model files of any version and write them in the current version,
+# the conv2d kernels are kept in model order, [out][kernel_y][kernel_x][in]
+
+import struct
+import convert_header as header
+
+# the values of DNNLayerType in libavfilter/dnn/dnn_backend_native.h
+DLT_CONV2D = 1
+DLT_DEPTH_TO_SPACE = 2
+DLT_MIRROR_PAD = 3
+DLT_MAXIMUM = 4
+
+def align(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+class Conv2D(object):
+    def __init__(self):
+        self.params = []       # dilation, padding, activation, in, out, kernel_size, has_bias
+        self.kernel = []
+        self.biases = []
+        self.operands = []
+
+    def out_channels(self):
+        return self.params[4]
+
+    def filter_size(self):
+        return self.params[3] * self.params[5] * self.params[5]
+
+class RawLayer(object):
+    def __init__(self, type, data):
+        self.type = type
+        self.data = data
+
+class Model(object):
+    def __init__(self):
+        self.layers = []
+        self.tail = b''        # operands, layer and operand counts
+
+class Reader(object):
+    def __init__(self, data, major):
+        self.data = data
+        self.pos = 0
+        self.major = major
+
+    def read(self, fmt, count=1):
+        fmt = '<%d%s' % (count, fmt)
+        values = struct.unpack_from(fmt, self.data, self.pos)
+        self.pos += struct.calcsize(fmt)
+        return list(values)
+
+    def blob(self, fmt, count):
+        if self.major >= 2:
+            self.pos = align(self.pos, header.blob_align)
+        return self.read(fmt, count)
+
+def unpack_kernel(packed, out_channels, filter_size):
+    # inverse of the panel layout built by dnn_pack_layer_conv2d()
+    block = header.conv2d_block
+    kernel = []
+    for n in range(out_channels):
+        panel = (n // block) * filter_size * block
+        for k in range(filter_size):
+            kernel.append(packed[panel + k * block + n % block])
+    return kernel
+
+def pack_kernel(kernel, out_channels, filter_size):
+    block = header.conv2d_block
+    packed = [0.0] * (align(out_channels, block) * filter_size)
+    for n in range(out_channels):
+        panel = (n // block) * filter_size * block
+        for k in range(filter_size):
+            packed[panel + k * block + n % block] = kernel[n * filter_size + k]
+    return packed
+
+def read_conv2d(reader):
+    layer = Conv2D()
+    layer.params = reader.read('I', 7)
+    out_channels = layer.out_channels()
+    filter_size = layer.filter_size()
+    if reader.major >= 2:
+        packed = reader.blob('f', align(out_channels, header.conv2d_block) * filter_size)
+        layer.kernel = unpack_kernel(packed, out_channels, filter_size)
+    else:
+        layer.kernel = reader.read('f', out_channels * filter_size)
+    if layer.params[6]:
+        layer.biases = reader.blob('f', out_channels)
+    layer.operands = reader.read('I', 2)
+    return layer
+
+def read_model(infile):
+    with open(infile, 'rb') as f:
+        data = f.read()
+
+    magic = header.str.encode('utf-8')
+    if data[:len(magic)] != magic:
+        raise ValueError('%s is not a native model file' % infile)
+    major, minor = struct.unpack_from('<2I', data, len(magic))
+    if major < 1 or major > header.major:
+        raise ValueError('unsupported model version %d.%d' % (major, minor))
+
+    reader = Reader(data, major)
+    reader.pos = len(magic) + 8
+    layer_num = struct.unpack_from('<I', data, len(data) - 8)[0]
+
+    model = Model()
+    for i in range(layer_num):
+        start = reader.pos
+        layer_type = reader.read('I')[0]
+        if layer_type == DLT_CONV2D:
+            model.layers.append(read_conv2d(reader))
+            continue
+        elif layer_type == DLT_DEPTH_TO_SPACE:
+            reader.read('I', 1 + 2)
+        elif layer_type == DLT_MIRROR_PAD:
+            reader.read('I', 1 + 8 + 2)
+        elif layer_type == DLT_MAXIMUM:
+            reader.read('I', 1 + 2)
+        else:
+            raise ValueError('unsupported layer type %d' % layer_type)
+        model.layers.append(RawLayer(layer_type, data[start + 4:reader.pos]))
+
+    model.tail = data[reader.pos:]
+    return model
+
+class Writer(object):
+    def __init__(self, f):
+        self.f = f
+        self.pos = 0
+
+    def write(self, fmt, values):
+        data = struct.pack('<%d%s' % (len(values), fmt), *values)
+        self.f.write(data)
+        self.pos += len(data)
+
+    def blob(self, fmt, values):
+        padding = align(self.pos, header.blob_align) - self.pos
+        self.f.write(bytes(padding))
+        self.pos += padding
+        self.write(fmt, values)
+
+def write_conv2d(writer, layer):
+    out_channels = layer.out_channels()
+    filter_size = layer.filter_size()
+    writer.write('I', [DLT_CONV2D] + layer.params)
+    writer.blob('f', pack_kernel(layer.kernel, out_channels, filter_size))
+    if layer.params[6]:
+        writer.blob('f', layer.biases)
+    writer.write('I', layer.operands)
+
+def write_model(outfile, model):
+    with open(outfile, 'wb') as f:
+        writer = Writer(f)
+        f.write(header.str.encode('utf-8'))
+        writer.pos = len(header.str)
+        writer.write('I', [header.major, header.minor])
+        for layer in model.layers:
+            if isinstance(layer, Conv2D):
+                write_conv2d(writer, layer)
+            else:
+                writer.write('I', [layer.type])
+                f.write(layer.data)
+                writer.pos += len(layer.data)
+        f.write(model.tail)